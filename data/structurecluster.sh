@@ -12,35 +12,24 @@ exists() {
 	[ -f "$1" ]
 }
 
-abspath() {
-    if [ -d "$1" ]; then
-        (cd "$1"; pwd)
-    elif [ -f "$1" ]; then
-        if [ -z "${1##*/*}" ]; then
-            echo "$(cd "${1%/*}"; pwd)/${1##*/}"
-        else
-            echo "$(pwd)/$1"
-        fi
-    elif [ -d "$(dirname "$1")" ]; then
-        echo "$(cd "$(dirname "$1")"; pwd)/$(basename "$1")"
+# Build the prefilter index shared by the cascaded clustering steps
+# $1: input db
+buildStepIndex() {
+    if notExists "${1}_ss_h.dbtype"; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" lndb "${SOURCE}_h" "${1}_ss_h" ${VERBOSITY} \
+            || fail "lndb step index header died"
     fi
+    # shellcheck disable=SC2086
+    "$MMSEQS" indexdb "${1}_ss" "${1}_ss" ${INDEXDB_PAR} \
+        || fail "indexdb step index died"
+    # shellcheck disable=SC2086
+    "$MMSEQS" mvdb "${1}_ss.idx" "${TMP_PATH}/step_index.idx" ${VERBOSITY} \
+        || fail "mvdb step index died"
+    wc -l < "${1}_ss.index" > "${TMP_PATH}/step_index.size"
 }
 
-# Merge two databases using soft-linking
-# $1: input db1
-# $2: input db2
-# $3: output db
-buildMergedDb() {
-    # combine seq dbs
-    MAXOFFSET=$(awk '($2+$3) > max{max=$2+$3}END{print max}' "${2}.index")
-    awk -v OFFSET="${MAXOFFSET}" 'FNR==NR{print $0; next}{print $1"\t"$2+OFFSET"\t"$3}' "${2}.index" \
-         "${1}.index" > "${3}.index"
-    ln -s "$(abspath "${2}")" "${3}.0"
-    ln -s "$(abspath "${1}")" "${3}.1"
-    cp "${2}.dbtype" "${3}.dbtype"
-}
-
-
+INDEX_COMPACT_PERCENT=50
 
 # check number of input variables
 [ "$#" -ne 3 ] && echo "Please provide <sequenceDB> <outDB> <tmp>" && exit 1;
@@ -57,9 +46,15 @@ if [ "${RUN_LINCLUST}" = "1" ]; then
 
   # 1. Finding exact $k$-mer matches.
   if notExists "${TMP_PATH}/pref.dbtype"; then
-      # shellcheck disable=SC2086
-      $RUNNER "$MMSEQS" kmermatcher "${INPUT}_ss" "${TMP_PATH}/pref" ${KMERMATCHER_PAR} \
-          || fail "kmermatcher died"
+      if [ -n "${SKETCH_PREFILTER}" ]; then
+          # shellcheck disable=SC2086
+          $RUNNER "$MMSEQS" sketchmatcher "${INPUT}" "${TMP_PATH}/pref" ${SKETCHMATCHER_PAR} \
+              || fail "sketchmatcher died"
+      else
+          # shellcheck disable=SC2086
+          $RUNNER "$MMSEQS" kmermatcher "${INPUT}_ss" "${TMP_PATH}/pref" ${KMERMATCHER_PAR} \
+              || fail "kmermatcher died"
+      fi
   fi
 
   # 2. Hamming distance pre-clustering
@@ -148,9 +143,21 @@ if [ "${RUN_ITERATIVE}" = "1" ]; then
       PARAM=PREFILTER${STEP}_PAR
       eval TMP="\$$PARAM"
       if notExists "${TMP_PATH}/pref_step$STEP.dbtype"; then
-           # shellcheck disable=SC2086
-          $RUNNER "$MMSEQS" prefilter "${INPUT}_ss" "${INPUT}_ss" "${TMP_PATH}/pref_step$STEP" ${TMP} \
-              || fail "Prefilter step $STEP died"
+          if [ "$STEPS" -gt 1 ]; then
+              # build the shared index once and rebuild it only if less than INDEX_COMPACT_PERCENT of its entries are live
+              LIVE_ENTRIES=$(wc -l < "${INPUT}_ss.index")
+              if notExists "${TMP_PATH}/step_index.size" \
+                  || [ "$((LIVE_ENTRIES * 100))" -lt "$(($(cat "${TMP_PATH}/step_index.size") * INDEX_COMPACT_PERCENT))" ]; then
+                  buildStepIndex "${INPUT}"
+              fi
+              # shellcheck disable=SC2086
+              $RUNNER "$MMSEQS" prefilter "${INPUT}_ss" "${TMP_PATH}/step_index.idx" "${TMP_PATH}/pref_step$STEP" ${TMP} --live-target-db "${INPUT}_ss" \
+                  || fail "Prefilter step $STEP died"
+          else
+              # shellcheck disable=SC2086
+              $RUNNER "$MMSEQS" prefilter "${INPUT}_ss" "${INPUT}_ss" "${TMP_PATH}/pref_step$STEP" ${TMP} \
+                  || fail "Prefilter step $STEP died"
+          fi
       fi
       PARAM=ALIGNMENT${STEP}_PAR
       eval TMP="\$$PARAM"
@@ -215,81 +222,20 @@ if [ -n "$REASSIGN" ]; then
         $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${SOURCE}${ALN_EXTENTION}" "${SOURCE}${ALN_EXTENTION}" "${TMP_PATH}/clu" "${TMP_PATH}/aln" ${ALIGNMENT_PAR} \
                 || fail "Alignment step $STEP died"
     fi
-    # create file of cluster that do not align based on given criteria
-    if notExists "${TMP_PATH}/clu_not_accepted.dbtype"; then
-        # shellcheck disable=SC2086
-        "$MMSEQS" subtractdbs "${TMP_PATH}/clu" "${TMP_PATH}/aln" "${TMP_PATH}/clu_not_accepted" --e-profile 100000000 -e 100000000 ${THREADSANDCOMPRESS} \
-                 || fail "subtractdbs1 reassign died"
-    fi
-    if notExists "${TMP_PATH}/clu_not_accepted_swap.dbtype"; then
+    # split clusters into accepted members, wrongly assigned members and the seeds (representatives and wrongly assigned members)
+    if notExists "${TMP_PATH}/clu_accepted.dbtype"; then
         # shellcheck disable=SC2086
-        "$MMSEQS" swapdb "${TMP_PATH}/clu_not_accepted" "${TMP_PATH}/clu_not_accepted_swap" ${THREADSANDCOMPRESS} \
-                 || fail "swapdb1 reassign died"
+        "$MMSEQS" reassignsplit "${SOURCE}" "${TMP_PATH}/clu" "${TMP_PATH}/aln" "${TMP_PATH}/clu_accepted" \
+                  "${TMP_PATH}/seq_wrong_assigned" "${TMP_PATH}/seq_seeds.merged" ${THREADSANDCOMPRESS} \
+                || fail "reassignsplit died"
     fi
     # short circuit if nothing can be reassigned
-    if [ ! -s "${TMP_PATH}/clu_not_accepted_swap.index" ]; then
+    if [ ! -s "${TMP_PATH}/seq_wrong_assigned.index" ]; then
         # shellcheck disable=SC2086
         "$MMSEQS" mvdb "${TMP_PATH}/clu" "$2" ${VERBOSITY}
-        if [ -n "$REMOVE_TMP" ]; then
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/clu_not_accepted_swap" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/clu_not_accepted" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/aln" ${VERBOSITY}
-        fi
     else
-        # create file of cluster that do align based on given criteria
-        if notExists "${TMP_PATH}/clu_accepted.dbtype"; then
-            # shellcheck disable=SC2086
-            "$MMSEQS" subtractdbs "${TMP_PATH}/clu" "${TMP_PATH}/clu_not_accepted" "${TMP_PATH}/clu_accepted" --e-profile 100000000 -e 100000000 ${THREADSANDCOMPRESS} \
-                     || fail "subtractdbs2 reassign died"
-        fi
-        # create sequences database that were wrong assigned
-        if notExists "${TMP_PATH}/seq_wrong_assigned.dbtype"; then
-            if notExists "${TMP_PATH}/seq_wrong_assigned_ss.dbtype"; then
-                # shellcheck disable=SC2086
-                "$MMSEQS" createsubdb "${TMP_PATH}/clu_not_accepted_swap" "${SOURCE}_ss" "${TMP_PATH}/seq_wrong_assigned_ss" ${VERBOSITY} \
-                              || fail "createsubdb1 reassign died"
-            fi
-            if exists "${SOURCE}_ca.dbtype"; then
-                # shellcheck disable=SC2086
-               "$MMSEQS" createsubdb "${TMP_PATH}/clu_not_accepted_swap" "${SOURCE}_ca" "${TMP_PATH}/seq_wrong_assigned_ca" ${VERBOSITY} \
-                              || fail "createsubdb1 reassign died"
-            fi
-
-            # shellcheck disable=SC2086
-            "$MMSEQS" createsubdb "${TMP_PATH}/clu_not_accepted_swap" "$SOURCE" "${TMP_PATH}/seq_wrong_assigned" ${VERBOSITY} \
-                     || fail "createsubdb1 reassign died"
-        fi
-
-        # build seed sequences
-        if notExists "${TMP_PATH}/seq_seeds.dbtype"; then
-            if notExists "${TMP_PATH}/seq_seeds_ss.dbtype"; then
-                # shellcheck disable=SC2086
-                "$MMSEQS" createsubdb "${TMP_PATH}/clu" "${SOURCE}_ss" "${TMP_PATH}/seq_seeds_ss" ${VERBOSITY} \
-                              || fail "createsubdb2 reassign died"
-            fi
-            if exists "${SOURCE}_ca.dbtype"; then
-                # shellcheck disable=SC2086
-               "$MMSEQS" createsubdb "${TMP_PATH}/clu" "${SOURCE}_ca" "${TMP_PATH}/seq_seeds_ca" ${VERBOSITY}  \
-                              || fail "createsubdb2 reassign died"
-            fi
-
-            # shellcheck disable=SC2086
-            "$MMSEQS" createsubdb "${TMP_PATH}/clu" "$SOURCE" "${TMP_PATH}/seq_seeds" ${VERBOSITY}   \
-                     || fail "createsubdb2 reassign died"
-
-        fi
-        PARAM=PREFILTER${STEP}_PAR
-        eval PREFILTER_PAR="\$$PARAM"
         # try to find best matching centroid sequences for prev. wrong assigned sequences
         if notExists "${TMP_PATH}/seq_wrong_assigned_pref.dbtype"; then
-            if notExists "${TMP_PATH}/seq_seeds.merged.dbtype"; then
-                buildMergedDb "${TMP_PATH}/seq_wrong_assigned" "${TMP_PATH}/seq_seeds" "${TMP_PATH}/seq_seeds.merged"
-                buildMergedDb "${TMP_PATH}/seq_wrong_assigned_ss" "${TMP_PATH}/seq_seeds_ss" "${TMP_PATH}/seq_seeds.merged_ss"
-                buildMergedDb "${TMP_PATH}/seq_wrong_assigned_ca" "${TMP_PATH}/seq_seeds_ca" "${TMP_PATH}/seq_seeds.merged_ca"
-            fi
             # shellcheck disable=SC2086
             $RUNNER "$MMSEQS" prefilter "${TMP_PATH}/seq_wrong_assigned_ss" "${TMP_PATH}/seq_seeds.merged_ss" "${TMP_PATH}/seq_wrong_assigned_pref" ${PREFILTER_REASSIGN_PAR} \
                      || fail "Prefilter reassign died"
@@ -297,7 +243,7 @@ if [ -n "$REASSIGN" ]; then
         if notExists "${TMP_PATH}/seq_wrong_assigned_pref_swaped.dbtype"; then
             # shellcheck disable=SC2086
             "$MMSEQS" swapdb "${TMP_PATH}/seq_wrong_assigned_pref" "${TMP_PATH}/seq_wrong_assigned_pref_swaped" ${THREADSANDCOMPRESS} \
-                     || fail "swapdb2 reassign died"
+                     || fail "swapdb reassign died"
         fi
         if notExists "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln.dbtype"; then
             # shellcheck disable=SC2086
@@ -305,34 +251,12 @@ if [ -n "$REASSIGN" ]; then
                                               "${TMP_PATH}/seq_wrong_assigned_pref_swaped" "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln" ${ALIGNMENT_REASSIGN_PAR} \
                      || fail "align2 reassign died"
         fi
-
-        if notExists "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln_ocol.dbtype"; then
-            # shellcheck disable=SC2086
-            "$MMSEQS" filterdb "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln" "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln_ocol" --trim-to-one-column ${THREADSANDCOMPRESS} \
-                        || fail "filterdb2 reassign died"
-        fi
-
-        if notExists "${TMP_PATH}/clu_accepted_plus_wrong.dbtype"; then
-            # combine clusters
-            # shellcheck disable=SC2086
-            "$MMSEQS" mergedbs "${TMP_PATH}/seq_seeds.merged" "${TMP_PATH}/clu_accepted_plus_wrong" "${TMP_PATH}/clu_accepted" \
-                            "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln_ocol" ${MERGEDBS_PAR} \
-                                 || fail "mergedbs reassign died"
-        fi
-
-        if notExists "${TMP_PATH}/missing.single.seqs.db.dbtype"; then
-             awk 'FNR==NR{if($3 > 1){ f[$1]=1; }next} !($1 in f){print $1"\t"$1}' "${TMP_PATH}/clu_accepted_plus_wrong.index" "${SOURCE}.index" > "${TMP_PATH}/missing.single.seqs"
-            # shellcheck disable=SC2086
-            "$MMSEQS" tsv2db "${TMP_PATH}/missing.single.seqs" "${TMP_PATH}/missing.single.seqs.db" --output-dbtype 6 ${VERBCOMPRESS} \
-                                || fail "tsv2db reassign died"
-        fi
-
+        # combine accepted members and reassigned members, sequences without any become singletons
         if notExists "${TMP_PATH}/clu_accepted_plus_wrong_plus_single.dbtype"; then
-            # combine clusters
             # shellcheck disable=SC2086
-            "$MMSEQS" mergedbs "${SOURCE}" "${TMP_PATH}/clu_accepted_plus_wrong_plus_single" "${TMP_PATH}/clu_accepted_plus_wrong" \
-                            "${TMP_PATH}/missing.single.seqs.db" ${MERGEDBS_PAR} \
-                                 || fail "mergedbs2 reassign died"
+            "$MMSEQS" reassignmerge "${SOURCE}" "${TMP_PATH}/clu_accepted" "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln" \
+                      "${TMP_PATH}/clu_accepted_plus_wrong_plus_single" ${THREADSANDCOMPRESS} \
+                     || fail "reassignmerge died"
         fi
 
         PARAM=CLUSTER${STEP}_PAR
@@ -340,45 +264,41 @@ if [ -n "$REASSIGN" ]; then
         # shellcheck disable=SC2086
         "$MMSEQS" clust "${SOURCE}" "${TMP_PATH}/clu_accepted_plus_wrong_plus_single" "${2}" ${TMP} \
                 || fail "Clustering step $STEP died"
+    fi
 
-        if [ -n "$REMOVE_TMP" ]; then
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/aln" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/clu_not_accepted" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/clu_accepted" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/clu_not_accepted_swap" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/seq_seeds" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/seq_seeds.merged" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned_pref" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned_pref_swaped" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln" ${VERBOSITY}
-            # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln_ocol" ${VERBOSITY}
-            rm -f "${TMP_PATH}/missing.single.seqs"
-            rm -f "${TMP_PATH}/clu_accepted_plus_wrong.tsv"
+    if [ -n "$REMOVE_TMP" ]; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/clu" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/aln" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/clu_accepted" ${VERBOSITY}
+        for DB in seq_wrong_assigned seq_seeds.merged; do
             # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/missing.single.seqs.db" ${VERBOSITY}
+            "$MMSEQS" rmdb "${TMP_PATH}/${DB}" ${VERBOSITY}
             # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/clu_accepted_plus_wrong" ${VERBOSITY}
+            "$MMSEQS" rmdb "${TMP_PATH}/${DB}_ss" ${VERBOSITY}
             # shellcheck disable=SC2086
-            "$MMSEQS" rmdb "${TMP_PATH}/clu_accepted_plus_wrong_plus_single" ${VERBOSITY}
-        fi
+            "$MMSEQS" rmdb "${TMP_PATH}/${DB}_ca" ${VERBOSITY}
+        done
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned_pref" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned_pref_swaped" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/clu_accepted_plus_wrong_plus_single" ${VERBOSITY}
     fi
 fi
 
-
 if [ -n "$REMOVE_TMP" ]; then
     if [ "${RUN_ITERATIVE}" = "1" ]; then
+      if exists "${TMP_PATH}/step_index.size"; then
+          # shellcheck disable=SC2086
+          "$MMSEQS" rmdb "${TMP_PATH}/step_index.idx" ${VERBOSITY}
+          rm -f "${TMP_PATH}/step_index.size"
+      fi
       # shellcheck disable=SC2086
       "$MMSEQS" rmdb "${TMP_PATH}/clu_redundancy" ${VERBOSITY}
       # shellcheck disable=SC2086
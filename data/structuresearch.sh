@@ -37,6 +37,25 @@ fake_pref() {
     awk 'BEGIN { printf("%c%c%c%c",7,0,0,0); exit; }' > "${RES}.dbtype"
 }
 
+if [ -n "${RESULT_CACHE}" ]; then
+    # answer cached queries from the result cache and only search the remaining ones
+    if notExists "${TMP_PATH}/cache_hits.dbtype"; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" cachelookup "${QUERY_ALIGNMENT}" "${RESULT_CACHE}" "${TMP_PATH}/cache_hits" "${TMP_PATH}/cache_missing" ${CACHELOOKUP_PAR} \
+            || fail "Result cache lookup died"
+    fi
+    for SUFFIX in "" _ss _ca _feat; do
+        if [ -f "${QUERY_ALIGNMENT}${SUFFIX}.dbtype" ] && notExists "${TMP_PATH}/query_missing${SUFFIX}.dbtype"; then
+            # shellcheck disable=SC2086
+            "$MMSEQS" createsubdb "${TMP_PATH}/cache_missing" "${QUERY_ALIGNMENT}${SUFFIX}" "${TMP_PATH}/query_missing${SUFFIX}" ${CREATESUBDB_PAR} \
+                || fail "createsubdb died"
+        fi
+    done
+    CACHE_QUERY="${QUERY_ALIGNMENT}"
+    QUERY_ALIGNMENT="${TMP_PATH}/query_missing"
+    QUERY_PREFILTER="${TMP_PATH}/query_missing_ss"
+fi
+
 # 1. Finding exact $k$-mer matches.
 if notExists "${TMP_PATH}/pref.dbtype"; then
     if [ "$PREFMODE" = "EXHAUSTIVE" ]; then
@@ -86,12 +105,51 @@ else
 
    # 2. Alignment
     if notExists "${TMP_PATH}/strualn.dbtype"; then
+        TMP="${ALIGNMENT_PAR}"
+        if [ -n "${CLUSTER_LEVELS}" ]; then
+            PARAM="ALIGNMENT_LEVEL${CLUSTER_LEVELS}_PAR"
+            eval TMP="\$$PARAM"
+        fi
         # shellcheck disable=SC2086
-        $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/pref" "${TMP_PATH}/strualn" ${ALIGNMENT_PAR} \
+        $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/pref" "${TMP_PATH}/strualn" ${TMP} \
             || fail "Structure alignment step died"
     fi
 
-    if [ -n "${EXPAND}" ]; then
+    if [ -n "${CLUSTER_LEVELS}" ]; then
+        # descend the hierarchy: expand the hits of each level to their children and align those
+        LEVEL="${CLUSTER_LEVELS}"
+        INTERMEDIATE="${TMP_PATH}/strualn"
+        while [ "${LEVEL}" -gt 0 ]; do
+            if notExists "${TMP_PATH}/strualn_level${LEVEL}.dbtype"; then
+                if notExists "${TMP_PATH}/strualn_expanded${LEVEL}.dbtype"; then
+                    # shellcheck disable=SC2086
+                    "$MMSEQS" mergeresultsbyset "${INTERMEDIATE}" "${TARGET_ALIGNMENT}_clu_${LEVEL}" "${TMP_PATH}/strualn_expanded${LEVEL}" ${MERGERESULTBYSET_PAR} \
+                        || fail "Expand level ${LEVEL} died"
+                    "$MMSEQS" setextendeddbtype "${TMP_PATH}/strualn_expanded${LEVEL}" --extended-dbtype 2
+                fi
+                TMP="${ALIGNMENT_PAR}"
+                if [ "${LEVEL}" -gt 1 ]; then
+                    PARAM="ALIGNMENT_LEVEL$((LEVEL - 1))_PAR"
+                    eval TMP="\$$PARAM"
+                fi
+                # shellcheck disable=SC2086
+                $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/strualn_expanded${LEVEL}" "${TMP_PATH}/strualn_level${LEVEL}" ${TMP} \
+                    || fail "Alignment level ${LEVEL} died"
+            fi
+            if [ -n "$REMOVE_TMP" ]; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" rmdb "${TMP_PATH}/strualn_expanded${LEVEL}" ${VERBOSITY}
+                if [ "${INTERMEDIATE}" != "${TMP_PATH}/strualn" ]; then
+                    # shellcheck disable=SC2086
+                    "$MMSEQS" rmdb "${INTERMEDIATE}" ${VERBOSITY}
+                fi
+            fi
+            INTERMEDIATE="${TMP_PATH}/strualn_level${LEVEL}"
+            LEVEL=$((LEVEL - 1))
+        done
+        # shellcheck disable=SC2086
+        "$MMSEQS" mvdb "${INTERMEDIATE}" "${TMP_PATH}/aln" ${VERBOSITY}
+    elif [ -n "${EXPAND}" ]; then
         if notExists "${TMP_PATH}/strualn_expanded.dbtype"; then
             # shellcheck disable=SC2086
             "$MMSEQS" mergeresultsbyset "${TMP_PATH}/strualn" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/strualn_expanded" ${MERGERESULTBYSET_PAR} \
@@ -109,6 +167,21 @@ else
     fi
 fi
 
+if [ -n "${RESULT_CACHE}" ]; then
+    if notExists "${TMP_PATH}/aln_all.dbtype"; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" cachestore "${QUERY_ALIGNMENT}" "${TMP_PATH}/aln" "${RESULT_CACHE}" ${CACHESTORE_PAR} \
+            || fail "Result cache store died"
+        # shellcheck disable=SC2086
+        "$MMSEQS" mergedbs "${CACHE_QUERY}" "${TMP_PATH}/aln_all" "${TMP_PATH}/cache_hits" "${TMP_PATH}/aln" ${MERGEDBS_PAR} \
+            || fail "Merge died"
+    fi
+    # shellcheck disable=SC2086
+    "$MMSEQS" rmdb "${TMP_PATH}/aln" ${VERBOSITY}
+    # shellcheck disable=SC2086
+    "$MMSEQS" mvdb "${TMP_PATH}/aln_all" "${TMP_PATH}/aln" ${VERBOSITY}
+fi
+
 # shellcheck disable=SC2086
 "$MMSEQS" mvdb "${TMP_PATH}/aln" "${RESULTS}" ${VERBOSITY}
 
@@ -119,11 +192,26 @@ if [ -n "$REMOVE_TMP" ]; then
         "$MMSEQS" rmdb "${TMP_PATH}/strualn" ${VERBOSITY}
     fi
 
-    if [ -n "${EXPAND}" ]; then
+    if [ -n "${EXPAND}" ] && [ -z "${CLUSTER_LEVELS}" ]; then
         # shellcheck disable=SC2086
         "$MMSEQS" rmdb "${TMP_PATH}/strualn_expanded" ${VERBOSITY}
     fi
+    if [ -n "${CLUSTER_LEVELS}" ]; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/strualn" ${VERBOSITY}
+    fi
 
     # shellcheck disable=SC2086
     "$MMSEQS" rmdb "${TMP_PATH}/pref" ${VERBOSITY}
+    if [ -n "${RESULT_CACHE}" ]; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/cache_hits" ${VERBOSITY}
+        for SUFFIX in "" _ss _ca _feat; do
+            if [ -f "${TMP_PATH}/query_missing${SUFFIX}.dbtype" ]; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" rmdb "${TMP_PATH}/query_missing${SUFFIX}" ${VERBOSITY}
+            fi
+        done
+        rm -f "${TMP_PATH}/cache_missing"
+    fi
 fi
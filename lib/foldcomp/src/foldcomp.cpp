@@ -884,9 +884,10 @@ int Foldcomp::decompress(std::vector<AtomCoordinate>& atom) {
             currResidue = backBonePerResidue[i][0].residue;
         }
         fullResidue = nerf.reconstructAminoAcid(
-            backBonePerResidue[i], this->sideChainAnglesPerResidue[i], AAS.at(currResidue)
+            backBonePerResidue[i], this->sideChainAnglesPerResidue[i], AAS.at(currResidue),
+            this->backboneOnly ? 5 : -1
         );
-        if (this->useAltAtomOrder) {
+        if (this->useAltAtomOrder && !this->backboneOnly) {
             _reorderAtoms(fullResidue, AAS.at(currResidue));
         }
         backBonePerResidue[i] = fullResidue;
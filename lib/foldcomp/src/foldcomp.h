@@ -292,6 +292,8 @@ public:
     bool isCompressed = false;
     bool backwardReconstruction = true;
     bool useAltAtomOrder = false;
+    // only reconstruct N, CA, C, O and CB in decompress
+    bool backboneOnly = false;
     // Number of atoms & residues
     int nResidue = 0;
     int nAtom = 0;
@@ -106,7 +106,8 @@ float3d Nerf::place_atom(
 std::vector<AtomCoordinate> Nerf::reconstructAminoAcid(
     const std::vector<AtomCoordinate>& original_atoms,
     const std::vector<float>& torsion_angles,
-    const AminoAcid& aa
+    const AminoAcid& aa,
+    int maxAtoms
 ) {
     // save three first atoms
     std::vector<AtomCoordinate> reconstructed_atoms = {
@@ -120,6 +121,10 @@ std::vector<AtomCoordinate> Nerf::reconstructAminoAcid(
     );
 
     int total = aa.atoms.size();
+    // atoms are ordered N, CA, C, O, CB, ... so a limit stops after the first side chain atoms
+    if (maxAtoms >= 3 && maxAtoms < total) {
+        total = maxAtoms;
+    }
     for (int i = 0; i < (total - 3); i++) {
         // Get current atom's info
         curr_atom.atom_index = reconstructed_atoms[i + 2].atom_index + 1;
@@ -92,7 +92,8 @@ public:
     std::vector<AtomCoordinate> reconstructAminoAcid(
         const std::vector<AtomCoordinate>& original_atoms,
         const std::vector<float>& torsion_angles,
-        const AminoAcid& aa
+        const AminoAcid& aa,
+        int maxAtoms = -1
     );
 
     void writeInfoForChecking(
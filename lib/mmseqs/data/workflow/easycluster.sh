@@ -21,30 +21,10 @@ if notExists "${TMP_PATH}/clu.dbtype"; then
         || fail "Search died"
 fi
 
-if notExists "${TMP_PATH}/cluster.tsv"; then
+if notExists "${TMP_PATH}/cluster.tsv" || notExists "${TMP_PATH}/rep_seq.fasta" || notExists "${TMP_PATH}/all_seqs.fasta"; then
     # shellcheck disable=SC2086
-    "$MMSEQS" createtsv "${TMP_PATH}/input" "${TMP_PATH}/input" "${TMP_PATH}/clu" "${TMP_PATH}/cluster.tsv" ${THREADS_PAR} \
-        || fail "Convert Alignments died"
-fi
-
-if notExists "${TMP_PATH}/rep_seq.fasta"; then
-    # shellcheck disable=SC2086
-    "$MMSEQS" result2repseq "${TMP_PATH}/input" "${TMP_PATH}/clu" "${TMP_PATH}/clu_rep" ${RESULT2REPSEQ_PAR} \
-            || fail "Result2repseq  died"
-
-    # shellcheck disable=SC2086
-    "$MMSEQS" result2flat "${TMP_PATH}/input" "${TMP_PATH}/input" "${TMP_PATH}/clu_rep" "${TMP_PATH}/rep_seq.fasta" --use-fasta-header ${VERBOSITY_PAR} \
-            || fail "result2flat died"
-fi
-
-if notExists "${TMP_PATH}/all_seqs.fasta"; then
-    # shellcheck disable=SC2086
-    "$MMSEQS" createseqfiledb "${TMP_PATH}/input" "${TMP_PATH}/clu" "${TMP_PATH}/clu_seqs" ${THREADS_PAR} \
-            || fail "Result2repseq  died"
-
-    # shellcheck disable=SC2086
-    "$MMSEQS" result2flat "${TMP_PATH}/input" "${TMP_PATH}/input" "${TMP_PATH}/clu_seqs" "${TMP_PATH}/all_seqs.fasta" ${VERBOSITY_PAR} \
-            || fail "result2flat died"
+    "$MMSEQS" createclusterfiles "${TMP_PATH}/input" "${TMP_PATH}/clu" "${TMP_PATH}/cluster.tsv" "${TMP_PATH}/rep_seq.fasta" "${TMP_PATH}/all_seqs.fasta" ${CLUSTER_FILES_PAR} \
+        || fail "createclusterfiles died"
 fi
 
 mv "${TMP_PATH}/all_seqs.fasta"  "${RESULTS}_all_seqs.fasta"
@@ -57,10 +37,6 @@ if [ -n "${REMOVE_TMP}" ]; then
     # shellcheck disable=SC2086
     "$MMSEQS" rmdb "${TMP_PATH}/input_h" ${VERBOSITY_PAR}
     # shellcheck disable=SC2086
-    "$MMSEQS" rmdb "${TMP_PATH}/clu_seqs" ${VERBOSITY_PAR}
-    # shellcheck disable=SC2086
-    "$MMSEQS" rmdb "${TMP_PATH}/clu_rep" ${VERBOSITY_PAR}
-    # shellcheck disable=SC2086
     "$MMSEQS" rmdb "${TMP_PATH}/clu" ${VERBOSITY_PAR}
     rm -rf "${TMP_PATH}/clu_tmp"
     rm -f "${TMP_PATH}/easycluster.sh"
@@ -26,6 +26,7 @@ extern int createdb(int argc, const char **argv, const Command& command);
 extern int makepaddedseqdb(int argc, const char **argv, const Command& command);
 extern int createindex(int argc, const char **argv, const Command& command);
 extern int createlinindex(int argc, const char **argv, const Command& command);
+extern int createclusterfiles(int argc, const char **argv, const Command& command);
 extern int createseqfiledb(int argc, const char **argv, const Command& command);
 extern int createsubdb(int argc, const char **argv, const Command& command);
 extern int view(int argc, const char **argv, const Command& command);
@@ -390,6 +390,17 @@ std::vector<Command> baseCommands = {
 
 
 
+        {"createclusterfiles",   createclusterfiles,   &par.result2repseq,        COMMAND_FORMAT_CONVERSION | COMMAND_EXPERT,
+                "Write cluster TSV, representative and all member FASTA files in one pass",
+                "# Same output as easy-cluster for an existing clustering\n"
+                "mmseqs createclusterfiles sequenceDB clusterDB cluster.tsv rep_seq.fasta all_seqs.fasta\n",
+                "agent <agent@local>",
+                "<i:sequenceDB> <i:clusterDB> <o:tsvFile> <o:repFastaFile> <o:allFastaFile>",
+                CITATION_MMSEQS2, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA|DbType::NEED_HEADER, &DbValidator::sequenceDb },
+                                          {"clusterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
+                                          {"tsvFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                          {"repFastaFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                          {"allFastaFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile }}},
         {"createtaxdb",          createtaxdb,          &par.createtaxdb,          COMMAND_TAXONOMY,
                 "Add taxonomic labels to sequence DB",
                 NULL,
@@ -1269,9 +1280,9 @@ std::vector<Command> baseCommands = {
                 "Separates a sequence DB into a representative and a non-representative DB",
                 NULL,
                 "Martin Steinegger <martin.steinegger@snu.ac.kr>",
-                "<i:sequenceDB> <i:resultDB> <o:sequenceDB>",
+                "<i:sequenceDB> <i:resultDB1> ... <i:resultDBn> <o:sequenceDB>",
                 CITATION_MMSEQS2, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
-                                          {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::resultDb },
+                                          {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA | DbType::VARIADIC, &DbValidator::resultDb },
                                           {"sequenceDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::sequenceDb }}},
         {"dbtype",              dbtype,                &par.empty,                COMMAND_HIDDEN,
                 "",
@@ -56,10 +56,9 @@ Alignment::Alignment(const std::string &querySeqDB, const std::string &targetSeq
     }
 
     uint16_t extended = DBReader<unsigned int>::getExtendedDbtype(FileUtil::parseDbType(prefDB.c_str()));
-    bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
     tDbrIdx = new IndexReader(targetSeqDB, par.threads,
                               extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-                              (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+                              IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
     tdbr = tDbrIdx->sequenceReader;
     targetSeqType = tdbr->getDbtype();
     sameQTDB = (targetSeqDB.compare(querySeqDB) == 0);
@@ -71,7 +70,7 @@ Alignment::Alignment(const std::string &querySeqDB, const std::string &targetSeq
         // open the sequence, prefiltering and output databases
         qDbrIdx = new IndexReader(par.db1, par.threads,
                                   extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-                                  (touch) ? IndexReader::PRELOAD_INDEX : 0);
+                                  IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
         qdbr = qDbrIdx->sequenceReader;
         querySeqType = qdbr->getDbtype();
     }
@@ -251,7 +250,7 @@ void Alignment::run(const std::string &outDB, const std::string &outDBIndex, con
         dbtype = Parameters::DBTYPE_CLUSTER_RES;
     }
     dbtype = DBReader<unsigned int>::setExtendedDbtype(dbtype, DBReader<unsigned int>::getExtendedDbtype(prefdbr->getDbtype()));
-    DBWriter dbw(outDB.c_str(), outDBIndex.c_str(), threads, compressed, dbtype);
+    DBWriter dbw(outDB.c_str(), outDBIndex.c_str(), threads, compressed | Parameters::WRITER_DIRECT_MODE, dbtype);
     dbw.open();
 
     // handle no alignment case early, below would divide by 0 otherwise
@@ -51,8 +51,7 @@ int doRescorediagonal(Parameters &par,
     IndexReader * qDbrIdx = NULL;
     DBReader<unsigned int> * qdbr = NULL;
     DBReader<unsigned int> * tdbr = NULL;
-    bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
-    IndexReader * tDbrIdx = new IndexReader(par.db2, par.threads, IndexReader::SEQUENCES,   (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0 );
+    IndexReader * tDbrIdx = new IndexReader(par.db2, par.threads, IndexReader::SEQUENCES,   IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) );
     int querySeqType = 0;
     tdbr = tDbrIdx->sequenceReader;
     int targetSeqType = tDbrIdx->getDbtype();
@@ -63,7 +62,7 @@ int doRescorediagonal(Parameters &par,
         querySeqType = targetSeqType;
     } else {
         // open the sequence, prefiltering and output databases
-        qDbrIdx = new IndexReader(par.db1, par.threads,  IndexReader::SEQUENCES, (touch) ? IndexReader::PRELOAD_INDEX : 0);
+        qDbrIdx = new IndexReader(par.db1, par.threads,  IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
         qdbr = qDbrIdx->sequenceReader;
         querySeqType = qdbr->getDbtype();
     }
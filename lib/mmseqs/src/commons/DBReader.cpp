@@ -6,12 +6,16 @@
 #include <cstddef>
 #include <random>
 
+#include <sys/file.h>
+#include <dirent.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "MemoryMapped.h"
+#include "HugePages.h"
 #include "Debug.h"
 #include "Util.h"
 #include "FileUtil.h"
@@ -27,7 +31,7 @@ threads(threads), dataMode(dataMode), dataFileName(strdup(dataFileName_)),
         indexFileName(strdup(indexFileName_)), size(0), dataFiles(NULL), dataSizeOffset(NULL), dataFileCnt(0),
         totalDataSize(0), dataSize(0), lastKey(T()), closed(1), dbtype(Parameters::DBTYPE_GENERIC_DB),
         compressedBuffers(NULL), compressedBufferSizes(NULL), index(NULL), id2local(NULL), local2id(NULL),
-        dataMapped(false), accessType(0), externalData(false), didMlock(false)
+        keyToId(NULL), keyToIdSize(0), keyToIdMin(0), keyToIdBuilt(0), dataMapped(false), accessType(0), externalData(false), didMlock(false), dataInHugePages(false)
 {}
 
 template <typename T>
@@ -36,7 +40,8 @@ DBReader<T>::DBReader(DBReader<T>::Index *index, size_t size, size_t dataSize, T
         threads(threads), dataMode(USE_INDEX), dataFileName(NULL), indexFileName(NULL),
         size(size), dataFiles(NULL), dataSizeOffset(NULL), dataFileCnt(0), totalDataSize(0), dataSize(dataSize), lastKey(lastKey),
         maxSeqLen(maxSeqLen), closed(1), dbtype(dbType), compressedBuffers(NULL), compressedBufferSizes(NULL), index(index), sortedByOffset(true),
-        id2local(NULL), local2id(NULL), dataMapped(false), accessType(NOSORT), externalData(true), didMlock(false)
+        id2local(NULL), local2id(NULL), keyToId(NULL), keyToIdSize(0), keyToIdMin(0), keyToIdBuilt(0),
+        dataMapped(false), accessType(NOSORT), externalData(true), didMlock(false), dataInHugePages(false)
 {}
 
 template <typename T>
@@ -52,7 +57,30 @@ void DBReader<T>::setDataFile(const char* dataFileName_)  {
 
 template <typename T>
 void DBReader<T>::readMmapedDataInMemory(){
-    if ((dataMode & USE_DATA) && (dataMode & USE_FREAD) == 0) {
+    // shared memory is already resident, a private copy would defeat its purpose
+    if ((dataMode & USE_DATA) && (dataMode & USE_FREAD) == 0 && (dataMode & USE_SHM) == 0) {
+        // file backed pages cannot be huge pages, so the data is copied into anonymous memory
+        if (HugePages::enabled() && externalData == false && dataMapped == true && dataInHugePages == false) {
+            int pageMode = HugePages::EXPLICIT;
+            for (size_t fileIdx = 0; fileIdx < dataFileCnt; fileIdx++) {
+                size_t dataSize = dataSizeOffset[fileIdx+1]-dataSizeOffset[fileIdx];
+                if (dataSize == 0) {
+                    continue;
+                }
+                int fileMode;
+                char *copy = (char *) HugePages::allocate(dataSize, fileMode);
+                memcpy(copy, dataFiles[fileIdx], dataSize);
+                if (munmap(dataFiles[fileIdx], dataSize) < 0) {
+                    Debug(Debug::ERROR) << "Failed to munmap memory dataSize=" << dataSize << " File=" << dataFileName << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                dataFiles[fileIdx] = copy;
+                pageMode = std::min(pageMode, fileMode);
+            }
+            dataInHugePages = true;
+            Debug(Debug::INFO) << "Preloaded " << FileUtil::baseName(dataFileName) << " with " << HugePages::modeName(pageMode) << "\n";
+            return;
+        }
         //Debug(Debug::INFO) << "Touch data file " << dataFileName << "\n";
         for(size_t fileIdx = 0; fileIdx < dataFileCnt; fileIdx++){
             size_t dataSize = dataSizeOffset[fileIdx+1]-dataSizeOffset[fileIdx];
@@ -121,7 +149,7 @@ template <typename T> bool DBReader<T>::open(int accessType){
                 EXIT(EXIT_FAILURE);
             }
             size_t dataSize;
-            dataFiles[fileIdx] = mmapData(dataFile, &dataSize);
+            dataFiles[fileIdx] = mmapData(dataFile, dataFileNames[fileIdx], &dataSize);
             dataSizeOffset[fileIdx]=totalDataSize;
             totalDataSize += dataSize;
             if (fclose(dataFile) != 0) {
@@ -213,6 +241,39 @@ template <typename T> bool DBReader<T>::open(int accessType){
 template<typename T>
 void DBReader<T>::sortIndex(bool) {
 }
+
+template<typename T>
+void DBReader<T>::buildKeyToId() {
+}
+
+template<>
+void DBReader<unsigned int>::buildKeyToId() {
+    if (size == 0 || accessType == HARDNOSORT || accessType == SORT_BY_OFFSET) {
+        return;
+    }
+    // getId relies on the index being sorted by key, the direct table needs the same
+    for (size_t i = 1; i < size; i++) {
+        if (index[i - 1].id >= index[i].id) {
+            return;
+        }
+    }
+    // only worth it if the key space is dense enough to not waste more than the index itself
+    const size_t range = static_cast<size_t>(index[size - 1].id) - index[0].id + 1;
+    if (range > KEY_TO_ID_MAX_SPARSITY * size) {
+        return;
+    }
+    keyToId = new(std::nothrow) unsigned int[range];
+    if (keyToId == NULL) {
+        return;
+    }
+    incrementMemory(sizeof(unsigned int) * range);
+    keyToIdSize = range;
+    keyToIdMin = index[0].id;
+    std::fill(keyToId, keyToId + range, UINT_MAX);
+    for (size_t i = 0; i < size; i++) {
+        keyToId[index[i].id - keyToIdMin] = i;
+    }
+}
 template<typename T>
 void DBReader<T>::sortIndex(float*) {
 }
@@ -424,7 +485,11 @@ void DBReader<unsigned int>::sortIndex(bool isSortedById) {
     }
 }
 
-template <typename T> char* DBReader<T>::mmapData(FILE * file, size_t *dataSize) {
+template <typename T> char* DBReader<T>::mmapData(FILE * file, const std::string &fileName, size_t *dataSize) {
+    if ((dataMode & USE_SHM) && (dataMode & (USE_FREAD | USE_WRITABLE)) == 0) {
+        return shmData(file, fileName, dataSize);
+    }
+
     struct stat sb;
     if (fstat(fileno(file), &sb) < 0) {
         int errsv = errno;
@@ -467,6 +532,133 @@ template <typename T> char* DBReader<T>::mmapData(FILE * file, size_t *dataSize)
     }
 }
 
+static const char *SHM_DIRECTORY = "/dev/shm";
+
+// removes the segments and locks of other versions of a data file, segments that are still being written are kept
+static void removeStaleSegments(const std::string &prefix, const std::string &current) {
+    DIR *dir = opendir(SHM_DIRECTORY);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        std::string name(entry->d_name);
+        if (Util::startWith(prefix, name) == false || Util::startWith(current, name) || Util::endsWith(".tmp", name)) {
+            continue;
+        }
+        std::string path = std::string(SHM_DIRECTORY) + "/" + name;
+        if (unlink(path.c_str()) == 0 && Util::endsWith(".lock", name) == false) {
+            Debug(Debug::INFO) << "Removed stale shared memory " << path << "\n";
+        }
+    }
+    closedir(dir);
+}
+
+// The segment is named after the real path of the data file followed by its device, inode, size and modification
+// time, so a recreated file gets a new segment. The process creating a segment removes the segments of earlier
+// versions of the same file, processes still mapping them keep their copy until they unmap it.
+// The first process copies the file under a lock and publishes it with a rename, all others only map the complete segment.
+template <typename T> char* DBReader<T>::shmData(FILE * file, const std::string &fileName, size_t *dataSize) {
+#ifndef HAVE_POSIX_FALLOCATE
+    Debug(Debug::ERROR) << "Shared memory mode is not supported on this platform\n";
+    EXIT(EXIT_FAILURE);
+#endif
+    if (FileUtil::directoryExists(SHM_DIRECTORY) == false) {
+        Debug(Debug::ERROR) << "Shared memory mode requires " << SHM_DIRECTORY << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    struct stat sb;
+    if (fstat(fileno(file), &sb) < 0) {
+        int errsv = errno;
+        Debug(Debug::ERROR) << "Failed to fstat File=" << fileName << ". Error " << errsv << ".\n";
+        EXIT(EXIT_FAILURE);
+    }
+    *dataSize = sb.st_size;
+    if (*dataSize == 0) {
+        return NULL;
+    }
+
+    std::string realPath = FileUtil::getRealPathFromSymLink(fileName);
+    std::string prefix = "mmseqs_" + FileUtil::baseName(realPath) + "_" + SSTR(Util::hash(realPath.c_str(), realPath.size())) + "_";
+    std::string segment = prefix + SSTR((size_t) sb.st_dev) + "_" + SSTR((size_t) sb.st_ino) + "_" + SSTR(*dataSize)
+                          + "_" + SSTR((size_t) sb.st_mtime);
+    std::string shmName = std::string(SHM_DIRECTORY) + "/" + segment;
+    int fd = ::open(shmName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::string lockName = shmName + ".lock";
+        int lockFd = ::open(lockName.c_str(), O_RDONLY | O_CREAT, 0644);
+        if (lockFd < 0 || flock(lockFd, LOCK_EX) != 0) {
+            int errsv = errno;
+            Debug(Debug::ERROR) << "Cannot lock shared memory " << lockName << ". Error " << errsv << ".\n";
+            EXIT(EXIT_FAILURE);
+        }
+        // another process might have created the segment while we waited for the lock
+        fd = ::open(shmName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::string tmpName = shmName + ".tmp";
+            int outFd = ::open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (outFd < 0) {
+                int errsv = errno;
+                Debug(Debug::ERROR) << "Cannot create shared memory " << tmpName << ". Error " << errsv << ".\n";
+                EXIT(EXIT_FAILURE);
+            }
+#ifdef HAVE_POSIX_FALLOCATE
+            // tmpfs reports a full /dev/shm here instead of with SIGBUS on first access
+            if (posix_fallocate(outFd, 0, *dataSize) != 0) {
+                ::close(outFd);
+                unlink(tmpName.c_str());
+                Debug(Debug::ERROR) << "Not enough space in " << SHM_DIRECTORY << " for " << *dataSize << " bytes of " << fileName << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+#endif
+            const size_t bufferSize = 1024 * 1024;
+            char *buffer = (char *) malloc(bufferSize);
+            Util::checkAllocation(buffer, "Cannot allocate copy buffer");
+            size_t copied = 0;
+            while (copied < *dataSize) {
+                ssize_t readBytes = pread(fileno(file), buffer, std::min(bufferSize, *dataSize - copied), copied);
+                if (readBytes <= 0) {
+                    Debug(Debug::ERROR) << "Failed to read in datafile (" << fileName << "). Error " << errno << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                for (ssize_t written = 0; written < readBytes;) {
+                    ssize_t writeBytes = write(outFd, buffer + written, readBytes - written);
+                    if (writeBytes < 0) {
+                        Debug(Debug::ERROR) << "Failed to write shared memory " << tmpName << ". Error " << errno << "\n";
+                        EXIT(EXIT_FAILURE);
+                    }
+                    written += writeBytes;
+                }
+                copied += readBytes;
+            }
+            free(buffer);
+            if (::close(outFd) != 0 || rename(tmpName.c_str(), shmName.c_str()) != 0) {
+                Debug(Debug::ERROR) << "Cannot publish shared memory " << shmName << ". Error " << errno << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            Debug(Debug::INFO) << "Copied " << FileUtil::baseName(fileName) << " into shared memory " << shmName << "\n";
+            removeStaleSegments(prefix, segment);
+            fd = ::open(shmName.c_str(), O_RDONLY);
+        }
+        flock(lockFd, LOCK_UN);
+        ::close(lockFd);
+        if (fd < 0) {
+            int errsv = errno;
+            Debug(Debug::ERROR) << "Cannot open shared memory " << shmName << ". Error " << errsv << ".\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+
+    char *ret = static_cast<char*>(mmap(NULL, *dataSize, PROT_READ, MAP_SHARED, fd, 0));
+    if (ret == MAP_FAILED) {
+        int errsv = errno;
+        Debug(Debug::ERROR) << "Failed to mmap shared memory dataSize=" << *dataSize << " File=" << shmName << ". Error " << errsv << ".\n";
+        EXIT(EXIT_FAILURE);
+    }
+    ::close(fd);
+    return ret;
+}
+
 template <typename T> void DBReader<T>::remapData(){
     if ((dataMode & USE_DATA) && (dataMode & USE_FREAD) == 0) {
         unmapData();
@@ -477,7 +669,7 @@ template <typename T> void DBReader<T>::remapData(){
                 EXIT(EXIT_FAILURE);
             }
             size_t dataSize = 0;
-            dataFiles[fileIdx] = mmapData(dataFile, &dataSize);
+            dataFiles[fileIdx] = mmapData(dataFile, dataFileNames[fileIdx], &dataSize);
             if (fclose(dataFile) != 0) {
                 Debug(Debug::ERROR) << "Cannot close file " << dataFileNames[fileIdx] << "\n";
                 EXIT(EXIT_FAILURE);
@@ -504,6 +696,13 @@ template <typename T> void DBReader<T>::close(){
         delete[] local2id;
         decrementMemory(size*sizeof(unsigned int));
     }
+    if (keyToId != NULL) {
+        delete[] keyToId;
+        decrementMemory(keyToIdSize*sizeof(unsigned int));
+        keyToId = NULL;
+        keyToIdSize = 0;
+    }
+    keyToIdBuilt = 0;
 
     if(compressedBuffers){
         for(int i = 0; i < threads; i++){
@@ -615,7 +814,7 @@ template <typename T> char* DBReader<T>::getDataByOffset(size_t offset) {
 
 template <typename T>
 void DBReader<T>::touchData(size_t id) {
-    if((dataMode & USE_DATA) && (dataMode & USE_FREAD) == 0) {
+    if((dataMode & USE_DATA) && (dataMode & USE_FREAD) == 0 && (dataMode & USE_SHM) == 0) {
         char *data = getDataUncompressed(id);
         size_t currDataOffset = getOffset(id);
         size_t nextDataOffset = findNextOffsetid(id);
@@ -735,6 +934,33 @@ template <typename T> size_t DBReader<T>::getId (T dbKey){
     return (id < size && index[id].id == dbKey ) ? id : UINT_MAX;
 }
 
+template <> size_t DBReader<unsigned int>::getId (unsigned int dbKey){
+    // built on the first lookup, most readers never call getId
+    if (__atomic_load_n(&keyToIdBuilt, __ATOMIC_ACQUIRE) == 0) {
+#pragma omp critical(DBReaderKeyToId)
+        {
+            if (keyToIdBuilt == 0) {
+                buildKeyToId();
+                __atomic_store_n(&keyToIdBuilt, 1, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    size_t id;
+    if (keyToId != NULL) {
+        size_t slot = static_cast<size_t>(dbKey) - keyToIdMin;
+        if (dbKey < keyToIdMin || slot >= keyToIdSize || keyToId[slot] == UINT_MAX) {
+            return UINT_MAX;
+        }
+        id = keyToId[slot];
+        return (id2local != NULL) ? id2local[id] : id;
+    }
+    id = bsearch(index, size, dbKey);
+    if (id2local != NULL) {
+        return (id < size && index[id].id == dbKey) ? id2local[id] : UINT_MAX;
+    }
+    return (id < size && index[id].id == dbKey ) ? id : UINT_MAX;
+}
+
 template <typename T> size_t DBReader<T>::maxCount(char c) {
     checkClosed();
 
@@ -886,7 +1112,9 @@ template <typename T> void DBReader<T>::unmapData() {
                 if (didMlock == true) {
                     munlock(dataFiles[fileIdx], fileSize);
                 }
-                if ((dataMode & USE_FREAD) == 0) {
+                if (dataInHugePages == true) {
+                    HugePages::release(dataFiles[fileIdx], fileSize);
+                } else if ((dataMode & USE_FREAD) == 0) {
                     if (munmap(dataFiles[fileIdx], fileSize) < 0) {
                         Debug(Debug::ERROR) << "Failed to munmap memory dataSize=" << fileSize << " File=" << dataFileName
                                             << "\n";
@@ -902,6 +1130,7 @@ template <typename T> void DBReader<T>::unmapData() {
 
     didMlock = false;
     dataMapped = false;
+    dataInHugePages = false;
 }
 
 template <typename T>  size_t DBReader<T>::getDataOffset(T i) {
@@ -1085,6 +1314,9 @@ void DBReader<T>::moveDb(const std::string &srcDbName, const std::string &dstDbN
     if (FileUtil::fileExists((srcDbName + ".lookup").c_str())) {
         FileUtil::move((srcDbName + ".lookup").c_str(), (dstDbName + ".lookup").c_str());
     }
+    if (FileUtil::fileExists((srcDbName + ".lookup.bin").c_str())) {
+        FileUtil::move((srcDbName + ".lookup.bin").c_str(), (dstDbName + ".lookup.bin").c_str());
+    }
 }
 
 template<typename T>
@@ -1109,6 +1341,10 @@ void DBReader<T>::removeDb(const std::string &databaseName){
     if (FileUtil::fileExists(lookupFile.c_str())) {
         FileUtil::remove(lookupFile.c_str());
     }
+    std::string lookupBinFile = databaseName + ".lookup.bin";
+    if (FileUtil::fileExists(lookupBinFile.c_str())) {
+        FileUtil::remove(lookupBinFile.c_str());
+    }
 }
 
 typedef void (*DbAction)(const std::string &, const std::string &);
@@ -1145,6 +1381,7 @@ void copyLinkDb(const std::string &databaseName, const std::string &outDb, DBFil
         { DBFiles::HEADER_INDEX,  "_h.index"          },
         { DBFiles::HEADER_DBTYPE, "_h.dbtype"         },
         { DBFiles::LOOKUP,        ".lookup"           },
+        { DBFiles::LOOKUP,        ".lookup.bin"       },
         { DBFiles::SOURCE,        ".source"           },
         { DBFiles::TAX_MAPPING,   "_mapping"          },
         { DBFiles::TAX_NAMES,     "_names.dmp"        },
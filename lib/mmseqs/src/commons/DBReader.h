@@ -232,6 +232,10 @@ public:
 
     void remapData();
 
+    // key range may be at most this many times the number of entries to get a direct lookup table
+    static const size_t KEY_TO_ID_MAX_SPARSITY = 2;
+    void buildKeyToId();
+
     size_t bsearch(const Index * index, size_t size, T value);
 
     // does a binary search in the index and returns index of the entry with dbKey
@@ -266,6 +270,8 @@ public:
     static const unsigned int USE_FREAD      = 4;
     static const unsigned int USE_LOOKUP     = 8;
     static const unsigned int USE_LOOKUP_REV = 16;
+    // map the data files from a copy in /dev/shm that is shared by all processes on the node
+    static const unsigned int USE_SHM        = 32;
 
 
     // compressed
@@ -303,7 +309,8 @@ public:
     static void softlinkDb(const std::string &databaseName, const std::string &outDb, DBFiles::Files dbFilesFlags = DBFiles::ALL);
     static void copyDb(const std::string &databaseName, const std::string &outDb, DBFiles::Files dbFilesFlags = DBFiles::ALL);
 
-    char *mmapData(FILE *file, size_t *dataSize);
+    char *mmapData(FILE *file, const std::string &fileName, size_t *dataSize);
+    char *shmData(FILE *file, const std::string &fileName, size_t *dataSize);
 
     bool readIndex(char *data, size_t indexDataSize, Index *index, size_t & dataSize);
 
@@ -433,6 +440,10 @@ public:
 
     void setMode(const int mode);
 
+    int getMode() const {
+        return dataMode;
+    }
+
     size_t getOffset(size_t id);
 
     size_t findNextOffsetid(size_t id);
@@ -491,6 +502,13 @@ private:
     unsigned int * id2local;
     unsigned int * local2id;
 
+    // direct key to index position table for dense key spaces, NULL if getId falls back to binary search
+    unsigned int * keyToId;
+    size_t keyToIdSize;
+    unsigned int keyToIdMin;
+    // set once buildKeyToId ran, getId builds the table on its first call
+    int keyToIdBuilt;
+
     bool dataMapped;
     int accessType;
 
@@ -498,6 +516,9 @@ private:
 
     bool didMlock;
 
+    // data files were copied from their mmap into HugePages memory
+    bool dataInHugePages;
+
     // needed to prevent the compiler from optimizing away the loop
     char magicBytes;
 
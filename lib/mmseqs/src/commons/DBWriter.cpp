@@ -11,6 +11,8 @@
 #define SIMDE_ENABLE_NATIVE_ALIASES
 #include <simde/simde-common.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
 #include <cstdio>
 #include <sstream>
@@ -54,6 +56,20 @@ DBWriter::DBWriter(const char *dataFileName_, const char *indexFileName_, unsign
         datafileMode = "wb";
     }
 
+    directMode = (mode & Parameters::WRITER_DIRECT_MODE) != 0 && (mode & Parameters::WRITER_COMPRESSED_MODE) == 0;
+    directFile = NULL;
+    directFileOffset = 0;
+    directBuffers = NULL;
+    directBufferSizes = NULL;
+    directIndex = NULL;
+    directIndexFlushed = NULL;
+    if (directMode) {
+        directBuffers = new char*[threads];
+        directBufferSizes = new size_t[threads];
+        directIndex = new std::vector<DBReader<unsigned int>::Index>[threads];
+        directIndexFlushed = new size_t[threads];
+    }
+
     closed = true;
 }
 
@@ -93,6 +109,12 @@ DBWriter::~DBWriter() {
         delete [] cstream;
         delete [] state;
     }
+    if(directMode){
+        delete [] directBuffers;
+        delete [] directBufferSizes;
+        delete [] directIndex;
+        delete [] directIndexFlushed;
+    }
 }
 
 void DBWriter::sortDatafileByIdOrder(DBReader<unsigned int> &dbr) {
@@ -132,10 +154,34 @@ void DBWriter::open(size_t bufferSize) {
             bufferSize = 32ull * 1024 * 1024;
         }
     }
+    this->bufferSize = bufferSize;
+    if (directMode) {
+        directFile = FileUtil::openAndDelete(dataFileName, "wb");
+        int fd = fileno(directFile);
+        int flags;
+        if ((flags = fcntl(fd, F_GETFL, 0)) < 0 || fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1) {
+            Debug(Debug::ERROR) << "Can not set mode for " << dataFileName << "!\n";
+            EXIT(EXIT_FAILURE);
+        }
+        directFileOffset = 0;
+    }
     for (unsigned int i = 0; i < threads; i++) {
         dataFileNames[i] = makeResultFilename(dataFileName, i);
         indexFileNames[i] = makeResultFilename(indexFileName, i);
 
+        if (directMode) {
+            // entries are staged per thread and written with pwrite, no per-thread files needed
+            directBufferSizes[i] = bufferSize;
+            directBuffers[i] = (char*) malloc(bufferSize);
+            Util::checkAllocation(directBuffers[i], "Cannot allocate buffer for DBWriter");
+            incrementMemory(bufferSize);
+            directIndex[i].clear();
+            directIndexFlushed[i] = 0;
+            offsets[i] = 0;
+            starts[i] = 0;
+            continue;
+        }
+
         dataFiles[i] = FileUtil::openAndDelete(dataFileNames[i], datafileMode.c_str());
         int fd = fileno(dataFiles[i]);
         int flags;
@@ -147,7 +193,6 @@ void DBWriter::open(size_t bufferSize) {
         dataFilesBuffer[i] = new(std::nothrow) char[bufferSize];
         Util::checkAllocation(dataFilesBuffer[i], "Cannot allocate buffer for DBWriter");
         incrementMemory(bufferSize);
-        this->bufferSize = bufferSize;
 
         // set buffer to 64
         if (setvbuf(dataFiles[i], dataFilesBuffer[i], _IOFBF, bufferSize) != 0) {
@@ -214,6 +259,11 @@ void DBWriter::writeDbtypeFile(const char* path, int dbtype, bool isCompressed)
 
 
 void DBWriter::close(bool merge, bool needsSort) {
+    // direct mode writes all threads into one data file, there is nothing to merge
+    if (directMode) {
+        closeDirect(needsSort);
+        return;
+    }
     // close all datafiles
     for (unsigned int i = 0; i < threads; i++) {
         if (fclose(dataFiles[i]) != 0) {
@@ -257,6 +307,9 @@ void DBWriter::writeStart(unsigned int thrIdx) {
         Debug(Debug::ERROR) << "Thread index " << thrIdx << " > maximum thread number " << threads << "\n";
         EXIT(EXIT_FAILURE);
     }
+    if (directMode && offsets[thrIdx] >= bufferSize) {
+        flushDirectBuffer(thrIdx);
+    }
     starts[thrIdx] = offsets[thrIdx];
     if((mode & Parameters::WRITER_COMPRESSED_MODE) != 0){
         state[thrIdx] = INIT_STATE;
@@ -306,6 +359,8 @@ size_t DBWriter::writeAdd(const char* data, size_t dataSize, unsigned int thrIdx
         size_t written;
         if(isCompressedDB){
             written = addToThreadBuffer(data, sizeof(char), dataSize,  thrIdx);
+        }else if(directMode){
+            written = addToDirectBuffer(data, dataSize, thrIdx);
         }else{
             written = fwrite(data, sizeof(char), dataSize, dataFiles[thrIdx]);
         }
@@ -366,7 +421,8 @@ void DBWriter::writeEnd(unsigned int key, unsigned int thrIdx, bool addNullByte,
         if(isCompressedDB && state[thrIdx]==NOTCOMPRESSED){
             nullByte = static_cast<char>(0xFF);
         }
-        const size_t written = fwrite(&nullByte, sizeof(char), 1, dataFiles[thrIdx]);
+        const size_t written = directMode ? addToDirectBuffer(&nullByte, 1, thrIdx)
+                                          : fwrite(&nullByte, sizeof(char), 1, dataFiles[thrIdx]);
         if (written != 1) {
             Debug(Debug::ERROR) << "Can not write to data file " << dataFileNames[thrIdx] << "\n";
             EXIT(EXIT_FAILURE);
@@ -390,6 +446,15 @@ void DBWriter::writeEnd(unsigned int key, unsigned int thrIdx, bool addNullByte,
 }
 
 void DBWriter::writeIndexEntry(unsigned int key, size_t offset, size_t length, unsigned int thrIdx){
+    if (directMode) {
+        // offset is relative to the staging buffer until it is flushed
+        DBReader<unsigned int>::Index entry;
+        entry.id = key;
+        entry.offset = offset;
+        entry.length = static_cast<unsigned int>(length);
+        directIndex[thrIdx].push_back(entry);
+        return;
+    }
     char buffer[1024];
     size_t len = indexToBuffer(buffer, key, offset, length );
     size_t written = fwrite(buffer, sizeof(char), len, indexFiles[thrIdx]);
@@ -419,6 +484,10 @@ size_t DBWriter::indexToBuffer(char *buff1, unsigned int key, size_t offsetStart
 }
 
 void DBWriter::alignToPageSize(int thrIdx) {
+    if (directMode) {
+        Debug(Debug::ERROR) << "alignToPageSize is not supported in direct write mode. Datafile=" << dataFileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
     size_t currentOffset = offsets[thrIdx];
     size_t pageSize = Util::getPageSize();
     size_t newOffset = ((pageSize - 1) & currentOffset) ? ((currentOffset + pageSize) & ~(pageSize - 1)) : currentOffset;
@@ -433,7 +502,6 @@ void DBWriter::alignToPageSize(int thrIdx) {
     offsets[thrIdx] = newOffset;
 }
 
-
 void DBWriter::checkClosed() {
     if (closed == true) {
         Debug(Debug::ERROR) << "Trying to read a closed database. Datafile=" << dataFileName  << "\n";
@@ -737,3 +805,89 @@ void DBWriter::createRenumberedDB(const std::string& dataFile, const std::string
         delete lookupReader;
     }
 }
+
+size_t DBWriter::addToDirectBuffer(const void *data, size_t dataSize, unsigned int thrIdx) {
+    if (offsets[thrIdx] + dataSize > directBufferSizes[thrIdx]) {
+        // an entry has to stay contiguous, grow the buffer instead of flushing a partial entry
+        size_t newBufferSize = std::max(offsets[thrIdx] + dataSize, directBufferSizes[thrIdx] * 2);
+        directBuffers[thrIdx] = (char*) realloc(directBuffers[thrIdx], newBufferSize);
+        Util::checkAllocation(directBuffers[thrIdx], "Cannot reallocate buffer for DBWriter");
+        incrementMemory(newBufferSize - directBufferSizes[thrIdx]);
+        directBufferSizes[thrIdx] = newBufferSize;
+    }
+    // the caller advances offsets[thrIdx], like for the other write paths
+    memcpy(directBuffers[thrIdx] + offsets[thrIdx], data, dataSize);
+    return dataSize;
+}
+
+void DBWriter::flushDirectBuffer(unsigned int thrIdx) {
+    size_t dataSize = offsets[thrIdx];
+    size_t fileOffset = __sync_fetch_and_add(&directFileOffset, dataSize);
+    int fd = fileno(directFile);
+    size_t written = 0;
+    while (written < dataSize) {
+        ssize_t ret = pwrite(fd, directBuffers[thrIdx] + written, dataSize - written, fileOffset + written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Debug(Debug::ERROR) << "Can not write to data file " << dataFileName << ". Error " << errno << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        written += ret;
+    }
+    std::vector<DBReader<unsigned int>::Index> &index = directIndex[thrIdx];
+    for (size_t i = directIndexFlushed[thrIdx]; i < index.size(); i++) {
+        index[i].offset += fileOffset;
+    }
+    directIndexFlushed[thrIdx] = index.size();
+    offsets[thrIdx] = 0;
+    starts[thrIdx] = 0;
+}
+
+void DBWriter::closeDirect(bool needsSort) {
+    Timer timer;
+    size_t indexSize = 0;
+    for (unsigned int i = 0; i < threads; i++) {
+        flushDirectBuffer(i);
+        free(directBuffers[i]);
+        decrementMemory(directBufferSizes[i]);
+        indexSize += directIndex[i].size();
+    }
+    if (fclose(directFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close data file " << dataFileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    std::vector<DBReader<unsigned int>::Index> index;
+    index.reserve(indexSize);
+    for (unsigned int i = 0; i < threads; i++) {
+        index.insert(index.end(), directIndex[i].begin(), directIndex[i].end());
+        std::vector<DBReader<unsigned int>::Index>().swap(directIndex[i]);
+    }
+
+    const bool lexicographicOrder = (mode & Parameters::WRITER_LEXICOGRAPHIC_MODE) != 0;
+    if (needsSort && lexicographicOrder == false) {
+        std::sort(index.begin(), index.end(), DBReader<unsigned int>::Index::compareById);
+    }
+    const char *indexOut = (needsSort && lexicographicOrder) ? indexFileNames[0] : indexFileName;
+    FILE *indexFile = FileUtil::openAndDelete(indexOut, "w");
+    writeIndex(indexFile, index.size(), index.data());
+    if (fclose(indexFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close index file " << indexOut << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (needsSort && lexicographicOrder) {
+        sortIndex(indexFileNames[0], indexFileName, true);
+        FileUtil::remove(indexFileNames[0]);
+    }
+
+    writeDbtypeFile(dataFileName, dbtype, false);
+
+    for (unsigned int i = 0; i < threads; i++) {
+        free(dataFileNames[i]);
+        free(indexFileNames[i]);
+    }
+    closed = true;
+    Debug(Debug::INFO) << "Time for writing index of " << FileUtil::baseName(dataFileName) << ": " << timer.lap() << "\n";
+}
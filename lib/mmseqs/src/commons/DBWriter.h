@@ -2,6 +2,11 @@
 #define DBWRITER_H
 // For parallel write access, one each thread creates its own DB
 // After the parallel calculation are done, all DBs are merged into single DB
+// In WRITER_DIRECT_MODE threads stage entries in memory and pwrite them into one shared data file
+// at offsets reserved through an atomic counter, only the in-memory index is merged on close.
+// Only writeStart/writeAdd/writeEnd/writeData are supported in this mode.
+// Its output is always a single data file, which is what close(merge=true) produces and
+// a valid result for close(merge=false), which only allows split data files.
 
 #include <string>
 #include <vector>
@@ -72,6 +77,10 @@ private:
 
     void checkClosed();
 
+    size_t addToDirectBuffer(const void *data, size_t dataSize, unsigned int thrIdx);
+    void flushDirectBuffer(unsigned int thrIdx);
+    void closeDirect(bool needsSort);
+
     static void mergeResults(const char *outFileName, const char *outFileNameIndex,
                              const char **dataFileNames, const char **indexFileNames,
                              unsigned long fileCount, bool mergeDatafiles,
@@ -103,6 +112,14 @@ private:
     static const int COMPRESSED=2;
     ZSTD_CStream** cstream;
 
+    bool directMode;
+    FILE* directFile;
+    size_t directFileOffset;
+    char** directBuffers;
+    size_t* directBufferSizes;
+    std::vector<DBReader<unsigned int>::Index>* directIndex;
+    size_t* directIndexFlushed;
+
     const unsigned int threads;
     const size_t mode;
     int dbtype;
@@ -0,0 +1,74 @@
+#include "HugePages.h"
+#include "Debug.h"
+#include "Util.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t roundToHugePage(size_t size) {
+    return ((size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+}
+
+int HugePages::requestedMode() {
+    static int mode = -1;
+    if (mode == -1) {
+        const char *env = getenv("MMSEQS_HUGE_PAGES");
+        if (env == NULL || strcmp(env, "0") == 0) {
+            mode = NONE;
+        } else if (strcmp(env, "2") == 0 || strcmp(env, "explicit") == 0) {
+            mode = EXPLICIT;
+        } else {
+            mode = TRANSPARENT;
+        }
+    }
+    return mode;
+}
+
+void *HugePages::allocate(size_t size, int &mode) {
+    const size_t length = roundToHugePage(size == 0 ? 1 : size);
+    void *data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (requestedMode() == EXPLICIT) {
+        data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED) {
+            mode = EXPLICIT;
+            return data;
+        }
+    }
+#endif
+    data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        Util::checkAllocation(NULL, "Can not allocate " + SSTR(size) + " bytes in HugePages::allocate");
+    }
+    mode = NONE;
+#ifdef MADV_HUGEPAGE
+    if (madvise(data, length, MADV_HUGEPAGE) == 0) {
+        mode = TRANSPARENT;
+    }
+#endif
+    return data;
+}
+
+void HugePages::release(void *data, size_t size) {
+    if (data == NULL) {
+        return;
+    }
+    if (munmap(data, roundToHugePage(size == 0 ? 1 : size)) != 0) {
+        Debug(Debug::ERROR) << "Failed to munmap memory of size " << size << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+const char *HugePages::modeName(int mode) {
+    switch (mode) {
+        case EXPLICIT:
+            return "explicit huge pages";
+        case TRANSPARENT:
+            return "transparent huge pages";
+        default:
+            return "regular pages";
+    }
+}
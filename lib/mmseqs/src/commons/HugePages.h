@@ -0,0 +1,30 @@
+#ifndef MMSEQS_HUGEPAGES_H
+#define MMSEQS_HUGEPAGES_H
+
+#include <cstddef>
+
+// Anonymous memory for large, randomly accessed tables (index table, preloaded data)
+// backed by huge pages to reduce TLB misses.
+// The mode is requested through the MMSEQS_HUGE_PAGES environment variable, so it reaches
+// every module called from a workflow:
+//   0: off (default), 1: transparent huge pages (madvise),
+//   2: explicit huge pages (MAP_HUGETLB) with fallback to transparent huge pages
+class HugePages {
+public:
+    static const int NONE = 0;
+    static const int TRANSPARENT = 1;
+    static const int EXPLICIT = 2;
+
+    static int requestedMode();
+    static bool enabled() {
+        return requestedMode() != NONE;
+    }
+
+    // allocates at least size bytes, mode returns the page mode that was actually used
+    static void *allocate(size_t size, int &mode);
+    static void release(void *data, size_t size);
+
+    static const char *modeName(int mode);
+};
+
+#endif
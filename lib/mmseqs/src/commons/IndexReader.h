@@ -11,6 +11,16 @@ public:
     const static unsigned int PRELOAD_NO = 0;
     const static unsigned int PRELOAD_DATA = 1;
     const static unsigned int PRELOAD_INDEX = 2;
+    // map a precomputed index from a copy in /dev/shm shared by all processes on the node
+    const static unsigned int PRELOAD_SHM = 4;
+
+    // preload flags for a --db-load-mode, touchFlags are dropped for mmap
+    static unsigned int preloadFlags(int dbLoadMode, unsigned int touchFlags) {
+        if (dbLoadMode == Parameters::PRELOAD_MODE_MMAP) {
+            return 0;
+        }
+        return dbLoadMode == Parameters::PRELOAD_MODE_SHM ? (touchFlags | PRELOAD_SHM) : touchFlags;
+    }
 
     IndexReader(
             const std::string &dataName,
@@ -22,7 +32,11 @@ public:
     ) : sequenceReader(NULL), index(NULL) {
         int targetDbtype = FileUtil::parseDbType(dataName.c_str());
         if (Parameters::isEqualDbtype(targetDbtype, Parameters::DBTYPE_INDEX_DB)) {
-            index = new DBReader<unsigned int>(dataName.c_str(), (dataName + ".index").c_str(), 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+            int indexMode = DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX;
+            if (preloadMode & PRELOAD_SHM) {
+                indexMode |= DBReader<unsigned int>::USE_SHM;
+            }
+            index = new DBReader<unsigned int>(dataName.c_str(), (dataName + ".index").c_str(), 1, indexMode);
             index->open(DBReader<unsigned int>::NOSORT);
             if (PrefilteringIndexReader::checkIfIndexFile(index)) {
                 PrefilteringIndexReader::printSummary(index);
@@ -63,9 +63,13 @@ Parameters::Parameters():
         PARAM_SPACED_KMER_MODE(PARAM_SPACED_KMER_MODE_ID, "--spaced-kmer-mode", "Spaced k-mers", "0: use consecutive positions in k-mers; 1: use spaced k-mers", typeid(int), (void *) &spacedKmer, "^[0-1]{1}", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
         PARAM_REMOVE_TMP_FILES(PARAM_REMOVE_TMP_FILES_ID, "--remove-tmp-files", "Remove temporary files", "Delete temporary files", typeid(bool), (void *) &removeTmpFiles, "", MMseqsParameter::COMMAND_COMMON | MMseqsParameter::COMMAND_EXPERT),
         PARAM_INCLUDE_IDENTITY(PARAM_INCLUDE_IDENTITY_ID, "--add-self-matches", "Include identical seq. id.", "Artificially add entries of queries with themselves (for clustering)", typeid(bool), (void *) &includeIdentity, "", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_ALIGN | MMseqsParameter::COMMAND_EXPERT),
-        PARAM_PRELOAD_MODE(PARAM_PRELOAD_MODE_ID, "--db-load-mode", "Preload mode", "Database preload mode 0: auto, 1: fread, 2: mmap, 3: mmap+touch", typeid(int), (void *) &preloadMode, "[0-3]{1}", MMseqsParameter::COMMAND_COMMON | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PRELOAD_MODE(PARAM_PRELOAD_MODE_ID, "--db-load-mode", "Preload mode", "Database preload mode 0: auto, 1: fread, 2: mmap, 3: mmap+touch, 4: shared memory (/dev/shm)", typeid(int), (void *) &preloadMode, "[0-4]{1}", MMseqsParameter::COMMAND_COMMON | MMseqsParameter::COMMAND_EXPERT),
         PARAM_SPACED_KMER_PATTERN(PARAM_SPACED_KMER_PATTERN_ID, "--spaced-kmer-pattern", "Spaced k-mer pattern", "User-specified spaced k-mer pattern", typeid(std::string), (void *) &spacedKmerPattern, "^1[01]*1$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
         PARAM_LOCAL_TMP(PARAM_LOCAL_TMP_ID, "--local-tmp", "Local temporary path", "Path where some of the temporary files will be created", typeid(std::string), (void *) &localTmp, "", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_LIVE_TARGET_DB(PARAM_LIVE_TARGET_DB_ID, "--live-target-db", "Live target DB", "Only report hits to target index entries that are also contained in this DB", typeid(std::string), (void *) &liveTargetDb, "", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_KMER_CACHE_SIZE(PARAM_KMER_CACHE_SIZE_ID, "--kmer-cache-size", "k-mer list cache size", "Memory for caching similar k-mer lists shared by all threads. E.g. 800B, 5K, 10M, 1G. Default (0) disables the cache", typeid(ByteParser), (void *) &kmerCacheSize, "^(0|[1-9]{1}[0-9]*(B|K|M|G|T)?)$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_STREAM_TARGETS(PARAM_STREAM_TARGETS_ID, "--stream-targets", "Stream targets", "Index the queries instead of the targets and read the target DB once in order.\nFor query sets about as large as the target set", typeid(bool), (void *) &streamTargets, "", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_CHECKPOINT_INTERVAL(PARAM_CHECKPOINT_INTERVAL_ID, "--checkpoint-interval", "Checkpoint interval", "Commit results every N queries so that an interrupted run resumes with the missing queries (0: off)", typeid(int), (void *) &checkpointInterval, "^[0-9]{1}[0-9]*$", MMseqsParameter::COMMAND_MISC | MMseqsParameter::COMMAND_EXPERT),
         // alignment
         PARAM_ALIGNMENT_MODE(PARAM_ALIGNMENT_MODE_ID, "--alignment-mode", "Alignment mode", "How to compute the alignment:\n0: automatic\n1: only score and end_pos\n2: also start_pos and cov\n3: also seq.id\n4: only ungapped alignment", typeid(int), (void *) &alignmentMode, "^[0-5]{1}$", MMseqsParameter::COMMAND_ALIGN),
         PARAM_ALIGNMENT_OUTPUT_MODE(PARAM_ALIGNMENT_OUTPUT_MODE_ID, "--alignment-output-mode", "Alignment mode", "How to compute the alignment:\n0: automatic\n1: only score and end_pos\n2: also start_pos and cov\n3: also seq.id\n4: only ungapped alignment\n5: score only (output) cluster format", typeid(int), (void *) &alignmentOutputMode, "^[0-1]{1}$", MMseqsParameter::COMMAND_ALIGN),
@@ -431,6 +435,10 @@ Parameters::Parameters():
     prefilter.push_back(&PARAM_PCB);
     prefilter.push_back(&PARAM_SPACED_KMER_PATTERN);
     prefilter.push_back(&PARAM_LOCAL_TMP);
+    prefilter.push_back(&PARAM_LIVE_TARGET_DB);
+    prefilter.push_back(&PARAM_KMER_CACHE_SIZE);
+    prefilter.push_back(&PARAM_STREAM_TARGETS);
+    prefilter.push_back(&PARAM_CHECKPOINT_INTERVAL);
     prefilter.push_back(&PARAM_THREADS);
     prefilter.push_back(&PARAM_COMPRESSED);
     prefilter.push_back(&PARAM_V);
@@ -1889,6 +1897,12 @@ void Parameters::parseParameters(int argc, const char *pargv[], const Command &c
     threads = 1;
 #endif
 
+#ifndef HAVE_POSIX_FALLOCATE
+    if (preloadMode == PRELOAD_MODE_SHM) {
+        Debug(Debug::ERROR) << "--db-load-mode 4 is not supported on this platform\n";
+        EXIT(EXIT_FAILURE);
+    }
+#endif
 
     bool ignorePathCountChecks = command.databases.empty() == false && command.databases[0].specialType & DbType::ZERO_OR_ALL && filenames.size() == 0;
     const size_t MAX_DB_PARAMETER = 6;
@@ -2264,6 +2278,10 @@ void Parameters::setDefaults() {
     splitAA = false;
     spacedKmerPattern = "";
     localTmp = "";
+    liveTargetDb = "";
+    kmerCacheSize = 0;
+    streamTargets = false;
+    checkpointInterval = 0;
 
     // search workflow
     numIterations = 1;
@@ -2678,7 +2696,7 @@ size_t Parameters::hashParameter(const std::vector<DbType> &dbtypes, const std::
 }
 
 
-std::string Parameters::createParameterString(const std::vector<MMseqsParameter*> &par, bool wasSet) {
+std::string Parameters::createParameterString(const std::vector<MMseqsParameter*> &par, bool wasSet) const {
     std::ostringstream ss;
     for (size_t i = 0; i < par.size(); ++i) {
         // Never pass the MPI parameters along, they are passed by the environment
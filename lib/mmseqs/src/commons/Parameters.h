@@ -127,6 +127,8 @@ public:
     static const unsigned int WRITER_ASCII_MODE = 0;
     static const unsigned int WRITER_COMPRESSED_MODE = 1;
     static const unsigned int WRITER_LEXICOGRAPHIC_MODE = 2;
+    // all threads pwrite into one shared data file, no merge pass on close (ignored if compressed)
+    static const unsigned int WRITER_DIRECT_MODE = 4;
 
     // convertalis alignment
     static const int FORMAT_ALIGNMENT_BLAST_TAB = 0;
@@ -242,6 +244,7 @@ public:
     static const int PRELOAD_MODE_FREAD = 1;
     static const int PRELOAD_MODE_MMAP = 2;
     static const int PRELOAD_MODE_MMAP_TOUCH = 3;
+    static const int PRELOAD_MODE_SHM = 4;
 
     static std::string getSplitModeName(int splitMode) {
         switch (splitMode) {
@@ -419,6 +422,10 @@ public:
     int    realignMaxSeqs;               // Max alignments to realign
     std::string spacedKmerPattern;       // User-specified kmer pattern
     std::string localTmp;                // Local temporary path
+    std::string liveTargetDb;            // Restrict a precomputed target index to the entries of this DB
+    size_t kmerCacheSize;                // Memory for the shared similar k-mer list cache
+    bool streamTargets;                  // Index the queries and stream the targets once
+    int checkpointInterval;              // Queries per committed result chunk
 
 
     // ALIGNMENT
@@ -763,6 +770,10 @@ public:
     PARAMETER(PARAM_PRELOAD_MODE)
     PARAMETER(PARAM_SPACED_KMER_PATTERN)
     PARAMETER(PARAM_LOCAL_TMP)
+    PARAMETER(PARAM_LIVE_TARGET_DB)
+    PARAMETER(PARAM_KMER_CACHE_SIZE)
+    PARAMETER(PARAM_STREAM_TARGETS)
+    PARAMETER(PARAM_CHECKPOINT_INTERVAL)
     std::vector<MMseqsParameter*> prefilter;
     std::vector<MMseqsParameter*> ungappedprefilter;
     std::vector<MMseqsParameter*> gappedprefilter;
@@ -1184,7 +1195,7 @@ public:
 
     size_t hashParameter(const std::vector<DbType> &dbtypes, const std::vector<std::string> &filenames, const std::vector<MMseqsParameter*> &par);
 
-    std::string createParameterString(const std::vector<MMseqsParameter*> &vector, bool wasSet = false);
+    std::string createParameterString(const std::vector<MMseqsParameter*> &vector, bool wasSet = false) const;
 
     void overrideParameterDescription(MMseqsParameter& par, const char *description, const char *regex = NULL, int category = 0);
 
@@ -0,0 +1,172 @@
+// include xxhash early to avoid incompatibilites with SIMDe
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include "QueryCheckpoint.h"
+#include "DBWriter.h"
+#include "Parameters.h"
+#include "Debug.h"
+#include "FileUtil.h"
+#include "Util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include <fcntl.h>
+#include <unistd.h>
+
+static void syncFile(const std::string &file) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        Debug(Debug::ERROR) << "Cannot open " << file << " for syncing\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fsync(fd) != 0) {
+        Debug(Debug::ERROR) << "Cannot sync " << file << " to disk\n";
+        EXIT(EXIT_FAILURE);
+    }
+    close(fd);
+}
+
+uint64_t QueryCheckpoint::fingerprint(const Parameters &par, const std::vector<MMseqsParameter *> &parameters,
+                                      const std::vector<std::string> &indexFiles) {
+    std::vector<MMseqsParameter *> resultParameters;
+    for (size_t i = 0; i < parameters.size(); i++) {
+        const int id = parameters[i]->uniqid;
+        if (id == par.PARAM_THREADS.uniqid || id == par.PARAM_V.uniqid
+            || id == par.PARAM_PRELOAD_MODE.uniqid || id == par.PARAM_CHECKPOINT_INTERVAL.uniqid) {
+            continue;
+        }
+        resultParameters.push_back(parameters[i]);
+    }
+    std::string parameterString = par.createParameterString(resultParameters);
+
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    XXH64_update(&state, parameterString.c_str(), parameterString.size());
+    char buffer[64 * 1024];
+    for (size_t i = 0; i < indexFiles.size(); i++) {
+        FILE *file = FileUtil::openFileOrDie(indexFiles[i].c_str(), "r", true);
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            XXH64_update(&state, buffer, read);
+        }
+        fclose(file);
+    }
+    return XXH64_digest(&state);
+}
+
+QueryCheckpoint::QueryCheckpoint(const std::string &resultDb, const std::string &resultDbIndex,
+                                 size_t queryFrom, size_t querySize, size_t interval, uint64_t fingerprint)
+        : resultDb(resultDb), resultDbIndex(resultDbIndex), manifest(resultDb + ".checkpoint"),
+          queryFrom(queryFrom), querySize(querySize), interval(interval), fingerprintValue(fingerprint), enabled(interval > 0) {
+    if (enabled == false || interval >= querySize) {
+        this->interval = std::max(querySize, (size_t) 1);
+    }
+    chunkCount = std::max((querySize + this->interval - 1) / this->interval, (size_t) 1);
+    done.resize(chunkCount, false);
+    if (enabled) {
+        readManifest();
+    }
+}
+
+void QueryCheckpoint::readManifest() {
+    if (FileUtil::fileExists(manifest.c_str()) == false) {
+        FILE *file = FileUtil::openAndDelete(manifest.c_str(), "w");
+        fprintf(file, "%zu\t%zu\t%zu\t%016" PRIx64 "\n", queryFrom, querySize, interval, fingerprintValue);
+        if (fclose(file) != 0) {
+            Debug(Debug::ERROR) << "Cannot close checkpoint file " << manifest << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        syncFile(manifest);
+        return;
+    }
+
+    FILE *file = FileUtil::openFileOrDie(manifest.c_str(), "r", true);
+    size_t from, size, step;
+    uint64_t hash;
+    if (fscanf(file, "%zu\t%zu\t%zu\t%" SCNx64 "\n", &from, &size, &step, &hash) != 4
+        || from != queryFrom || size != querySize || step != interval || hash != fingerprintValue) {
+        fclose(file);
+        Debug(Debug::WARNING) << "Checkpoint " << manifest << " belongs to a different query range, interval, parameters or input. Starting from the beginning\n";
+        FileUtil::remove(manifest.c_str());
+        readManifest();
+        return;
+    }
+    // a chunk line is only written after its DB was synced, an incomplete last line is ignored
+    char line[64];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size_t length = strlen(line);
+        if (length == 0 || line[length - 1] != '\n') {
+            break;
+        }
+        size_t chunk = Util::fast_atoi<size_t>(line);
+        if (chunk >= chunkCount) {
+            continue;
+        }
+        std::pair<std::string, std::string> chunkDb = getChunkDb(chunk);
+        if (FileUtil::fileExists(chunkDb.first.c_str()) && FileUtil::fileExists(chunkDb.second.c_str())) {
+            done[chunk] = true;
+        }
+    }
+    fclose(file);
+
+    size_t remaining = getRemainingChunks();
+    Debug(Debug::INFO) << "Resume from checkpoint " << manifest << ": " << (chunkCount - remaining) << " of " << chunkCount << " query chunks are done\n";
+}
+
+size_t QueryCheckpoint::getRemainingChunks() const {
+    size_t remaining = 0;
+    for (size_t i = 0; i < chunkCount; i++) {
+        remaining += done[i] ? 0 : 1;
+    }
+    return remaining;
+}
+
+std::pair<std::string, std::string> QueryCheckpoint::getChunkDb(size_t chunk) const {
+    if (enabled == false) {
+        return std::make_pair(resultDb, resultDbIndex);
+    }
+    return Util::databaseNames(resultDb + "_chunk_" + SSTR(chunk));
+}
+
+void QueryCheckpoint::commit(size_t chunk) {
+    done[chunk] = true;
+    if (enabled == false) {
+        return;
+    }
+    std::pair<std::string, std::string> chunkDb = getChunkDb(chunk);
+    std::vector<std::string> dataFiles = FileUtil::findDatafiles(chunkDb.first.c_str());
+    for (size_t i = 0; i < dataFiles.size(); i++) {
+        syncFile(dataFiles[i]);
+    }
+    syncFile(chunkDb.second);
+    syncFile(chunkDb.first + ".dbtype");
+
+    FILE *file = FileUtil::openFileOrDie(manifest.c_str(), "a", true);
+    fprintf(file, "%zu\n", chunk);
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        Debug(Debug::ERROR) << "Cannot sync checkpoint file " << manifest << " to disk\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(file) != 0) {
+        Debug(Debug::ERROR) << "Cannot close checkpoint file " << manifest << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+void QueryCheckpoint::finish() {
+    if (enabled == false) {
+        return;
+    }
+    std::vector<std::pair<std::string, std::string>> chunkDbs;
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (done[i] == false) {
+            Debug(Debug::ERROR) << "Query chunk " << i << " of " << resultDb << " was not computed\n";
+            EXIT(EXIT_FAILURE);
+        }
+        chunkDbs.push_back(getChunkDb(i));
+    }
+    DBWriter::mergeResults(resultDb, resultDbIndex, chunkDbs);
+    FileUtil::remove(manifest.c_str());
+}
@@ -0,0 +1,71 @@
+#ifndef MMSEQS_QUERYCHECKPOINT_H
+#define MMSEQS_QUERYCHECKPOINT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Commits the results of a module in chunks of consecutive query ids.
+// Every completed chunk is written to its own DB and recorded in the manifest <resultDB>.checkpoint.
+// A run that is restarted after an interruption with the same query range, interval and fingerprint
+// only computes the chunks that are missing in the manifest. finish merges all chunks into the result DB.
+// Without an interval there is a single chunk that is written to the result DB directly.
+class Parameters;
+struct MMseqsParameter;
+
+class QueryCheckpoint {
+public:
+    QueryCheckpoint(const std::string &resultDb, const std::string &resultDbIndex,
+                    size_t queryFrom, size_t querySize, size_t interval, uint64_t fingerprint);
+
+    // hash of the parameters that change the results (all but threads, verbosity, load mode and interval)
+    // and of the index files of the input DBs
+    static uint64_t fingerprint(const Parameters &par, const std::vector<MMseqsParameter *> &parameters,
+                                const std::vector<std::string> &indexFiles);
+
+    size_t getChunkCount() const {
+        return chunkCount;
+    }
+
+    size_t getChunkStart(size_t chunk) const {
+        return queryFrom + chunk * interval;
+    }
+
+    size_t getChunkEnd(size_t chunk) const {
+        return std::min(queryFrom + (chunk + 1) * interval, queryFrom + querySize);
+    }
+
+    bool isDone(size_t chunk) const {
+        return done[chunk];
+    }
+
+    size_t getRemainingChunks() const;
+
+    // data and index file the results of a chunk are written to
+    std::pair<std::string, std::string> getChunkDb(size_t chunk) const;
+
+    // syncs the closed chunk DB to disk and records it in the manifest
+    void commit(size_t chunk);
+
+    // merges all chunk DBs into the result DB and removes the manifest
+    void finish();
+
+private:
+    std::string resultDb;
+    std::string resultDbIndex;
+    std::string manifest;
+    size_t queryFrom;
+    size_t querySize;
+    size_t interval;
+    uint64_t fingerprintValue;
+    bool enabled;
+    size_t chunkCount;
+    std::vector<bool> done;
+
+    void readManifest();
+};
+
+#endif
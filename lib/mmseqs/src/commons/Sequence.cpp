@@ -235,6 +235,18 @@ void Sequence::mapSequence(size_t id, unsigned int dbKey, std::pair<const unsign
     currItPos = -1;
 }
 
+unsigned char *Sequence::reserveNumSequence(size_t id, unsigned int dbKey, unsigned int seqLen) {
+    this->id = id;
+    this->dbKey = dbKey;
+    this->L = seqLen;
+    if (this->L >= static_cast<int>(maxLen)) {
+        numSequence = static_cast<unsigned char *>(realloc(numSequence, this->L + 1));
+        maxLen = this->L;
+    }
+    currItPos = -1;
+    return numSequence;
+}
+
 void Sequence::mapProfile(const char * profileData, unsigned int seqLen){
     char * data = (char *) profileData;
     size_t currPos = 0;
@@ -85,6 +85,9 @@ public:
     // map sequence from SequenceLookup
     void mapSequence(size_t id, unsigned int dbKey, std::pair<const unsigned char *, const unsigned int> data);
 
+    // prepare numSequence for seqLen residues that the caller writes directly
+    unsigned char *reserveNumSequence(size_t id, unsigned int dbKey, unsigned int seqLen);
+
     // map profile HMM, *data points to start position of Profile
     void mapProfile(const char *profileData, unsigned int seqLen);
 
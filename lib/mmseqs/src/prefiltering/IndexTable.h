@@ -17,6 +17,7 @@
 #include "KmerGenerator.h"
 #include "Parameters.h"
 #include "FastSort.h"
+#include "HugePages.h"
 #include <stdlib.h>
 #include <algorithm>
 
@@ -67,10 +68,15 @@ public:
     IndexTable(int alphabetSize, int kmerSize, bool externalData)
             : tableSize(MathUtil::ipow<size_t>(alphabetSize, kmerSize)), alphabetSize(alphabetSize),
               kmerSize(kmerSize), externalData(externalData), tableEntriesNum(0), size(0),
-              indexer(new Indexer(alphabetSize, kmerSize)), entries(NULL), offsets(NULL) {
+              indexer(new Indexer(alphabetSize, kmerSize)), entries(NULL), offsets(NULL),
+              hugePages(externalData == false && HugePages::enabled()), pageMode(HugePages::NONE) {
         if (externalData == false) {
-            offsets = new(std::nothrow) size_t[tableSize + 1];
-            Util::checkAllocation(offsets, "Can not allocate entries memory in IndexTable");
+            if (hugePages) {
+                offsets = (size_t *) HugePages::allocate((tableSize + 1) * sizeof(size_t), pageMode);
+            } else {
+                offsets = new(std::nothrow) size_t[tableSize + 1];
+                Util::checkAllocation(offsets, "Can not allocate entries memory in IndexTable");
+            }
             memset(offsets, 0, (tableSize + 1) * sizeof(size_t));
         }
     }
@@ -83,11 +89,19 @@ public:
     void deleteEntries() {
         if (externalData == false) {
             if (entries != NULL) {
-                delete[] entries;
+                if (hugePages) {
+                    HugePages::release(entries, tableEntriesNum * sizeof(IndexEntryLocal));
+                } else {
+                    delete[] entries;
+                }
                 entries = NULL;
             }
             if (offsets != NULL) {
-                delete[] offsets;
+                if (hugePages) {
+                    HugePages::release(offsets, (tableSize + 1) * sizeof(size_t));
+                } else {
+                    delete[] offsets;
+                }
                 offsets = NULL;
             }
         }
@@ -212,8 +226,7 @@ public:
         this->size = dbSize; // amount of sequences added
 
         // allocate memory for the sequence id lists
-        entries = new(std::nothrow) IndexEntryLocal[tableEntriesNum];
-        Util::checkAllocation(entries, "Can not allocate entries memory in IndexTable::initMemory");
+        allocateEntries(tableEntriesNum);
     }
 
     // allocates memory for index tables
@@ -241,8 +254,7 @@ public:
         this->tableEntriesNum = tableEntriesNum;
         this->size = sequenceCount;
 
-        this->entries = new(std::nothrow) IndexEntryLocal[tableEntriesNum];
-        Util::checkAllocation(entries, "Can not allocate " + SSTR(tableEntriesNum * sizeof(IndexEntryLocal)) + " bytes for entries in IndexTable::initMemory");
+        allocateEntries(tableEntriesNum);
         memcpy(this->entries, entries, tableEntriesNum * sizeof(IndexEntryLocal));
 
         memcpy(this->offsets, entryOffsets, (tableSize + 1) * sizeof(size_t));
@@ -427,6 +439,9 @@ public:
     // returns the size of the entry (int for global) (IndexEntryLocal for local)
     size_t getSizeOfEntry() { return sizeof(IndexEntryLocal); }
 
+    // HugePages mode of the table memory, regular pages for mmapped index tables
+    int getPageMode() const { return pageMode; }
+
     int getKmerSize() {
         return kmerSize;
     }
@@ -484,7 +499,23 @@ protected:
     IndexEntryLocal *entries;
     size_t *offsets;
 
+    // entries and offsets are allocated through HugePages
+    const bool hugePages;
+    int pageMode;
+
     // sequence lookup
     SequenceLookup *sequenceLookup;
+
+private:
+    void allocateEntries(size_t count) {
+        if (hugePages) {
+            int entriesMode;
+            entries = (IndexEntryLocal *) HugePages::allocate(count * sizeof(IndexEntryLocal), entriesMode);
+            pageMode = std::min(pageMode, entriesMode);
+        } else {
+            entries = new(std::nothrow) IndexEntryLocal[count];
+            Util::checkAllocation(entries, "Can not allocate " + SSTR(count * sizeof(IndexEntryLocal)) + " bytes for entries in IndexTable::initMemory");
+        }
+    }
 };
 #endif
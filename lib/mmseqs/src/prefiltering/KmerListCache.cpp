@@ -0,0 +1,74 @@
+#include "KmerListCache.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+KmerListCache::KmerListCache(size_t memoryBudget) : memoryBudget(memoryBudget), usedBytes(0), listCount(0) {
+    // the slots take about a fifth of the budget, so tables stay sparse for typical list lengths
+    size_t slotCount = 1024;
+    while (slotCount * 2 * sizeof(Slot) <= memoryBudget / 5) {
+        slotCount *= 2;
+    }
+    slots = (Slot *) calloc(slotCount, sizeof(Slot));
+    Util::checkAllocation(slots, "Can not allocate slots in KmerListCache");
+    slotMask = slotCount - 1;
+    usedBytes = slotCount * sizeof(Slot);
+}
+
+KmerListCache::~KmerListCache() {
+    for (size_t i = 0; i <= slotMask; i++) {
+        free(slots[i].list);
+    }
+    free(slots);
+}
+
+std::pair<size_t *, size_t> KmerListCache::get(size_t kmer, short threshold) const {
+    const uint64_t key = makeKey(kmer, threshold);
+    size_t pos = hash(key) & slotMask;
+    for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+        const Slot &slot = slots[(pos + probe) & slotMask];
+        const uint64_t slotKey = __atomic_load_n(&slot.key, __ATOMIC_ACQUIRE);
+        if (slotKey == 0) {
+            break;
+        }
+        if (slotKey == key) {
+            size_t *list = __atomic_load_n(&slot.list, __ATOMIC_ACQUIRE);
+            if (list == NULL) {
+                break;
+            }
+            return std::make_pair(list, slot.size);
+        }
+    }
+    return std::make_pair((size_t *) NULL, (size_t) 0);
+}
+
+void KmerListCache::add(size_t kmer, short threshold, const size_t *list, size_t listSize) {
+    const size_t bytes = std::max(listSize, (size_t) 1) * sizeof(size_t);
+    if (__sync_fetch_and_add(&usedBytes, bytes) + bytes > memoryBudget) {
+        __sync_fetch_and_sub(&usedBytes, bytes);
+        return;
+    }
+
+    const uint64_t key = makeKey(kmer, threshold);
+    size_t pos = hash(key) & slotMask;
+    for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+        Slot &slot = slots[(pos + probe) & slotMask];
+        uint64_t slotKey = __sync_val_compare_and_swap(&slot.key, (uint64_t) 0, key);
+        if (slotKey == 0) {
+            size_t *copy = (size_t *) malloc(bytes);
+            Util::checkAllocation(copy, "Can not allocate k-mer list in KmerListCache");
+            memcpy(copy, list, listSize * sizeof(size_t));
+            slot.size = listSize;
+            __atomic_store_n(&slot.list, copy, __ATOMIC_RELEASE);
+            __sync_fetch_and_add(&listCount, 1);
+            return;
+        }
+        if (slotKey == key) {
+            // another thread cached it already
+            break;
+        }
+    }
+    __sync_fetch_and_sub(&usedBytes, bytes);
+}
@@ -0,0 +1,59 @@
+#ifndef MMSEQS_KMERLISTCACHE_H
+#define MMSEQS_KMERLISTCACHE_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <utility>
+
+// Similar k-mer lists shared by all QueryMatcher threads of a prefilter run.
+// A list only depends on the exact k-mer and the (bias corrected) k-mer threshold,
+// as long as the k-mer generator uses the 2-mer/3-mer substitution matrices and not a profile.
+// Lock-free open addressing table, entries are never replaced or removed.
+// Lists are added until the memory budget is used up, later lists are just not cached.
+class KmerListCache {
+public:
+    explicit KmerListCache(size_t memoryBudget);
+    ~KmerListCache();
+
+    // returns (NULL, 0) if the list is not cached
+    std::pair<size_t *, size_t> get(size_t kmer, short threshold) const;
+    void add(size_t kmer, short threshold, const size_t *list, size_t listSize);
+
+    size_t getListCount() const {
+        return listCount;
+    }
+    size_t getUsedBytes() const {
+        return usedBytes;
+    }
+
+private:
+    struct Slot {
+        // 0 marks an empty slot
+        uint64_t key;
+        // published after size, NULL while the slot is being filled
+        size_t *list;
+        size_t size;
+    };
+
+    static const size_t MAX_PROBES = 16;
+
+    static uint64_t makeKey(size_t kmer, short threshold) {
+        return ((static_cast<uint64_t>(kmer) << 16) | static_cast<uint16_t>(threshold)) + 1;
+    }
+    static uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    Slot *slots;
+    size_t slotMask;
+    size_t memoryBudget;
+    size_t usedBytes;
+    size_t listCount;
+};
+
+#endif
@@ -5,11 +5,152 @@
 #include "DBReader.h"
 #include "Timer.h"
 #include "FileUtil.h"
+#include "DBWriter.h"
+#include "FastSort.h"
+#include "AlignmentSymmetry.h"
+
+#include <algorithm>
 
 #ifdef OPENMP
 #include <omp.h>
 #endif
 
+// Turns the results of the streamed targets (one entry per target, listing query keys) into the
+// usual prefilter result: one entry per query with the identical entry first, then the best hits by score.
+// Like swapdb, the query key range is split so that the hits of one split fit into memoryLimit and
+// each split is filled by its own pass over the streamed results.
+static void transposeStreamedResults(const std::string &streamedDb, const std::string &queryDb, const std::string &queryDbIndex,
+                                     const std::string &outDb, const std::string &outDbIndex, size_t maxResListLen,
+                                     bool identityFirst, size_t memoryLimit, int threads, int compressed) {
+    DBReader<unsigned int> streamedReader(streamedDb.c_str(), (streamedDb + ".index").c_str(), threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+    streamedReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+    DBReader<unsigned int> queryReader(queryDb.c_str(), queryDbIndex.c_str(), threads, DBReader<unsigned int>::USE_INDEX);
+    queryReader.open(DBReader<unsigned int>::NOSORT);
+    const unsigned int maxQueryKey = queryReader.getLastKey();
+
+    size_t *queryHitCount = new size_t[maxQueryKey + 2];
+    memset(queryHitCount, 0, sizeof(size_t) * (maxQueryKey + 2));
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+#pragma omp for schedule(dynamic, 100)
+        for (size_t i = 0; i < streamedReader.getSize(); i++) {
+            char *data = streamedReader.getData(i, thread_idx);
+            while (*data != '\0') {
+                hit_t hit = QueryMatcher::parsePrefilterHit(data);
+                if (hit.seqId <= maxQueryKey) {
+                    __sync_fetch_and_add(&(queryHitCount[hit.seqId]), 1);
+                }
+                data = Util::skipLine(data);
+            }
+        }
+    }
+
+    const size_t bytesForCounts = sizeof(size_t) * (maxQueryKey + 2);
+    memoryLimit = (memoryLimit > bytesForCounts) ? (memoryLimit - bytesForCounts) : 0;
+    // splits[i] is the last query key of split i
+    std::vector<unsigned int> splits;
+    size_t bytesInSplit = 0;
+    for (unsigned int key = 0; key <= maxQueryKey; key++) {
+        const size_t bytes = queryHitCount[key] * sizeof(hit_t);
+        if (bytesInSplit + bytes > memoryLimit && bytesInSplit > 0) {
+            splits.push_back(key - 1);
+            bytesInSplit = 0;
+        }
+        bytesInSplit += bytes;
+    }
+    splits.push_back(maxQueryKey);
+    if (splits.size() > 1) {
+        Debug(Debug::INFO) << "Transposing streamed results in " << splits.size() << " splits\n";
+    }
+    AlignmentSymmetry::computeOffsetFromCounts(queryHitCount, maxQueryKey + 1);
+
+    DBWriter writer(outDb.c_str(), outDbIndex.c_str(), threads, compressed, Parameters::DBTYPE_PREFILTER_RES);
+    writer.open();
+    unsigned int splitStart = 0;
+    for (size_t split = 0; split < splits.size(); split++) {
+        const unsigned int splitEnd = splits[split];
+        const size_t offsetStart = queryHitCount[splitStart];
+        const size_t hitsInSplit = queryHitCount[splitEnd + 1] - offsetStart;
+        hit_t *hits = new(std::nothrow) hit_t[std::max(hitsInSplit, static_cast<size_t>(1))];
+        Util::checkAllocation(hits, "Cannot allocate memory for the streamed results");
+        // write positions of the split, queryHitCount keeps the start offsets for the output pass
+        std::vector<size_t> fillPos(queryHitCount + splitStart, queryHitCount + splitEnd + 2);
+#pragma omp parallel
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+#pragma omp for schedule(dynamic, 100)
+            for (size_t i = 0; i < streamedReader.getSize(); i++) {
+                const unsigned int targetKey = streamedReader.getDbKey(i);
+                char *data = streamedReader.getData(i, thread_idx);
+                while (*data != '\0') {
+                    hit_t hit = QueryMatcher::parsePrefilterHit(data);
+                    if (hit.seqId >= splitStart && hit.seqId <= splitEnd) {
+                        const size_t pos = __sync_fetch_and_add(&(fillPos[hit.seqId - splitStart]), 1);
+                        hit_t &queryHit = hits[pos - offsetStart];
+                        queryHit.seqId = targetKey;
+                        queryHit.prefScore = hit.prefScore;
+                        queryHit.diagonal = static_cast<unsigned short>(static_cast<short>(hit.diagonal) * -1);
+                    }
+                    data = Util::skipLine(data);
+                }
+            }
+        }
+
+#pragma omp parallel
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+            char buffer[128];
+            std::string result;
+            result.reserve(1000000);
+#pragma omp for schedule(dynamic, 100)
+            for (size_t i = 0; i < queryReader.getSize(); i++) {
+                const unsigned int queryKey = queryReader.getDbKey(i);
+                if (queryKey < splitStart || queryKey > splitEnd) {
+                    continue;
+                }
+                hit_t *begin = hits + (queryHitCount[queryKey] - offsetStart);
+                hit_t *end = hits + (queryHitCount[queryKey + 1] - offsetStart);
+                const size_t count = std::min(static_cast<size_t>(end - begin), maxResListLen);
+                hit_t *first = begin;
+                if (identityFirst) {
+                    for (hit_t *it = begin; it != end; ++it) {
+                        if (it->seqId == queryKey) {
+                            std::swap(*begin, *it);
+                            first = begin + 1;
+                            break;
+                        }
+                    }
+                }
+                if (first < begin + count) {
+                    std::partial_sort(first, begin + count, end, hit_t::compareHitsByScoreAndId);
+                }
+                for (size_t j = 0; j < count; j++) {
+                    size_t len = QueryMatcher::prefilterHitToBuffer(buffer, begin[j]);
+                    result.append(buffer, len);
+                }
+                writer.writeData(result.c_str(), result.length(), queryKey, thread_idx);
+                result.clear();
+            }
+        }
+        delete[] hits;
+        splitStart = splitEnd + 1;
+    }
+    writer.close();
+    delete[] queryHitCount;
+    queryReader.close();
+    streamedReader.close();
+}
+
 int prefilter(int argc, const char **argv, const Command& command) {
     MMseqsMPI::init(argc, argv);
 
@@ -44,6 +185,34 @@ int prefilter(int argc, const char **argv, const Command& command) {
         return EXIT_FAILURE;
     }
 
+    if (par.streamTargets) {
+        if (Parameters::isEqualDbtype(FileUtil::parseDbType(par.db2.c_str()), Parameters::DBTYPE_INDEX_DB)) {
+            Debug(Debug::WARNING) << "--stream-targets cannot stream a precomputed target index. Search the index instead\n";
+        } else if (Parameters::isEqualDbtype(queryDbType, Parameters::DBTYPE_HMM_PROFILE) || Parameters::isEqualDbtype(targetDbType, Parameters::DBTYPE_HMM_PROFILE)) {
+            Debug(Debug::WARNING) << "--stream-targets does not support profiles. Search the target index instead\n";
+        } else {
+            // the queries become the in-memory index and the targets are read once, in order, as the search input.
+            // --max-seqs limits the hits per query, so the per-target lists are not capped. The transpose
+            // bounds its memory by --split-memory-limit and keeps the --max-seqs best hits of each query
+            const int covMode = par.covMode;
+            const size_t maxResListLen = par.maxResListLen;
+            const bool identityFirst = par.db1 == par.db2 || par.includeIdentity;
+            par.covMode = Util::swapCoverageMode(par.covMode);
+            par.maxResListLen = SIZE_MAX;
+            std::string streamedDb = par.db3 + "_streamed";
+            {
+                Prefiltering pref(par.db2, par.db2Index, par.db1, par.db1Index, targetDbType, queryDbType, par);
+                pref.runAllSplits(streamedDb, streamedDb + ".index");
+            }
+            par.covMode = covMode;
+            par.maxResListLen = maxResListLen;
+            transposeStreamedResults(streamedDb, par.db1, par.db1Index, par.db3, par.db3Index, maxResListLen,
+                                     identityFirst, Util::computeMemory(par.splitMemoryLimit), par.threads, par.compressed);
+            DBReader<unsigned int>::removeDb(streamedDb);
+            return EXIT_SUCCESS;
+        }
+    }
+
     Prefiltering pref(par.db1, par.db1Index, par.db2, par.db2Index, queryDbType, targetDbType, par);
 
 #ifdef HAVE_MPI
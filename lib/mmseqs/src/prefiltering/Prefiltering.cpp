@@ -12,7 +12,9 @@
 #include "ByteParser.h"
 #include "Parameters.h"
 #include "MemoryMapped.h"
+#include "HugePages.h"
 #include "FastSort.h"
+#include "QueryCheckpoint.h"
 #include <sys/mman.h>
 
 #ifdef OPENMP
@@ -53,7 +55,9 @@ Prefiltering::Prefiltering(const std::string &queryDB,
         covThr(par.covThr), covMode(par.covMode), includeIdentical(par.includeIdentity),
         preloadMode(par.preloadMode),
         threads(static_cast<unsigned int>(par.threads)),
-        compressed(par.compressed) {
+        compressed(par.compressed),
+        checkpointInterval(static_cast<size_t>(par.checkpointInterval)),
+        checkpointFingerprint(par.checkpointInterval > 0 ? QueryCheckpoint::fingerprint(par, par.prefilter, {queryDBIndex, targetDBIndex}) : 0) {
     sameQTDB = isSameQTDB();
 
     // init the substitution matrices
@@ -88,7 +92,12 @@ Prefiltering::Prefiltering(const std::string &queryDB,
             }
         }
 
-        tidxdbr = new DBReader<unsigned int>(targetDB.c_str(), targetDBIndex.c_str(), threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        int indexMode = DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA;
+        if (preloadMode == Parameters::PRELOAD_MODE_SHM) {
+            // the structures are used in place from the shared segment as with mmap
+            indexMode |= DBReader<unsigned int>::USE_SHM;
+        }
+        tidxdbr = new DBReader<unsigned int>(targetDB.c_str(), targetDBIndex.c_str(), threads, indexMode);
         tidxdbr->open(DBReader<unsigned int>::NOSORT);
 
         templateDBIsIndex = PrefilteringIndexReader::checkIfIndexFile(tidxdbr);
@@ -163,6 +172,36 @@ Prefiltering::Prefiltering(const std::string &queryDB,
         templateDBIsIndex = false;
     }
 
+    if (par.liveTargetDb.empty() == false) {
+        if (templateDBIsIndex == false) {
+            Debug(Debug::ERROR) << "--live-target-db requires a precomputed target index\n";
+            EXIT(EXIT_FAILURE);
+        }
+        // the index only stores the target k-mers, query side settings stay as requested
+        if (Parameters::isEqualDbtype(targetSeqType, Parameters::DBTYPE_HMM_PROFILE) == false) {
+            aaBiasCorrection = par.compBiasCorrection != 0;
+        }
+        DBReader<unsigned int> livedbr(par.liveTargetDb.c_str(), (par.liveTargetDb + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+        livedbr.open(DBReader<unsigned int>::NOSORT);
+        liveTargets.assign((tdbr->getSize() + 63) / 64, 0);
+        size_t liveCount = 0;
+        for (size_t id = 0; id < tdbr->getSize(); id++) {
+            if (livedbr.getId(tdbr->getDbKey(id)) != UINT_MAX) {
+                liveTargets[id >> 6] |= (1ULL << (id & 63));
+                liveCount++;
+            }
+        }
+        if (liveCount != livedbr.getSize()) {
+            Debug(Debug::ERROR) << "Target index does not contain all entries of " << par.liveTargetDb << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        livedbr.close();
+        Debug(Debug::INFO) << "Live target entries: " << liveCount << " of " << tdbr->getSize() << "\n";
+        if (liveCount == tdbr->getSize()) {
+            liveTargets.clear();
+        }
+    }
+
     // restrict amount of allocated memory if all results are requested
     // INT_MAX would allocate 72GB RAM per thread for no reason
     maxResListLen = std::min(tdbr->getSize(), maxResListLen);
@@ -212,6 +251,12 @@ Prefiltering::Prefiltering(const std::string &queryDB,
         kmerSubMat->alphabetSize = alphabetSize;
     }
 
+    // similar k-mer lists of sequence queries recur across queries, profile queries have position specific lists
+    kmerListCache = NULL;
+    if (par.kmerCacheSize > 0 && takeOnlyBestKmer == false && _3merSubMatrix.isValid() && _2merSubMatrix.isValid()) {
+        kmerListCache = new KmerListCache(par.kmerCacheSize);
+    }
+
     if (splitMode == Parameters::QUERY_DB_SPLIT) {
         // create the whole index table
         getIndexTable(0, 0, tdbr->getSize());
@@ -250,6 +295,10 @@ Prefiltering::~Prefiltering() {
         delete sequenceLookup;
     }
 
+    if (kmerListCache != NULL) {
+        delete kmerListCache;
+    }
+
     tdbr->close();
     delete tdbr;
 
@@ -516,6 +565,8 @@ void Prefiltering::getIndexTable(int split, size_t dbFrom, size_t dbSize) {
         // only the ungapped alignment needs the sequence lookup, we can save quite some memory here
         if (diagonalScoring) {
             sequenceLookup = PrefilteringIndexReader::getSequenceLookup(split, tidxdbr, preloadMode);
+        } else {
+            sequenceLookup = NULL;
         }
     } else {
         Timer timer;
@@ -550,6 +601,9 @@ void Prefiltering::getIndexTable(int split, size_t dbFrom, size_t dbSize) {
         tdbr->remapData();
         Debug(Debug::INFO) << "Time for index table init: " << timer.lap() << "\n";
     }
+    if (HugePages::enabled()) {
+        Debug(Debug::INFO) << "Index table memory: " << HugePages::modeName(indexTable->getPageMode()) << "\n";
+    }
 }
 
 bool Prefiltering::isSameQTDB() {
@@ -771,8 +825,8 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
     localThreads = std::max(std::min((size_t)threads, querySize), (size_t)1);
 #endif
 
-    DBWriter tmpDbw(resultDB.c_str(), resultDBIndex.c_str(), localThreads, compressed, Parameters::DBTYPE_PREFILTER_RES);
-    tmpDbw.open();
+    QueryCheckpoint checkpoint(resultDB, resultDBIndex, queryFrom, querySize, checkpointInterval, checkpointFingerprint);
+    DBWriter *tmpDbw = NULL;
 
     // init all thread-specific data structures
     char *notEmpty = new char[querySize];
@@ -786,7 +840,38 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
     Debug(Debug::INFO) << "Starting prefiltering scores calculation (step " << (split + 1) << " of " << splits << ")\n";
     Debug(Debug::INFO) << "Query db start " << (queryFrom + 1) << " to " << queryFrom + querySize << "\n";
     Debug(Debug::INFO) << "Target db start " << (dbFrom + 1) << " to " << dbFrom + dbSize << "\n";
-    Debug::Progress progress(querySize);
+
+    // chunks restored from the checkpoint only add their result list lengths to the statistics,
+    // the k-mer statistics are averaged over the computed queries
+    size_t restoredQueries = 0;
+    for (size_t chunk = 0; chunk < checkpoint.getChunkCount(); chunk++) {
+        if (checkpoint.isDone(chunk) == false) {
+            continue;
+        }
+        std::pair<std::string, std::string> chunkDb = checkpoint.getChunkDb(chunk);
+        DBReader<unsigned int> chunkReader(chunkDb.first.c_str(), chunkDb.second.c_str(), 1, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+        chunkReader.open(DBReader<unsigned int>::NOSORT);
+        for (size_t i = 0; i < chunkReader.getSize(); i++) {
+            size_t id = qdbr->getId(chunkReader.getDbKey(i));
+            if (id < queryFrom || id >= queryFrom + querySize) {
+                continue;
+            }
+            const char *data = chunkReader.getData(i, 0);
+            size_t resultSize = Util::countLines(data, strlen(data));
+            if (resultSize != 0) {
+                notEmpty[id - queryFrom] = 1;
+            }
+            resSize += resultSize;
+            realResSize += std::min(resultSize, maxResListLen);
+            reslens[0]->emplace_back(resultSize);
+            restoredQueries++;
+        }
+        chunkReader.close();
+    }
+    if (restoredQueries > 0) {
+        Debug(Debug::INFO) << "Restored " << restoredQueries << " queries from checkpoint\n";
+    }
+    Debug::Progress progress(querySize - restoredQueries);
 
 #pragma omp parallel num_threads(localThreads)
     {
@@ -803,6 +888,7 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
             matcher.setProfileMatrix(seq.profile_matrix);
         } else if (_3merSubMatrix.isValid() && _2merSubMatrix.isValid()) {
             matcher.setSubstitutionMatrix(&_3merSubMatrix, &_2merSubMatrix);
+            matcher.setKmerListCache(kmerListCache);
         } else {
             matcher.setSubstitutionMatrix(NULL, NULL);
         }
@@ -810,88 +896,120 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
         if (taxonomyHook != NULL) {
             matcher.setQueryMatcherHook(taxonomyHook);
         }
+        if (liveTargets.empty() == false) {
+            matcher.setLiveTargets(liveTargets.data(), dbFrom);
+        }
 
         char buffer[128];
         std::string result;
         result.reserve(1000000);
 
+        for (size_t chunk = 0; chunk < checkpoint.getChunkCount(); chunk++) {
+            if (checkpoint.isDone(chunk)) {
+                continue;
+            }
+#pragma omp single
+            {
+                std::pair<std::string, std::string> chunkDb = checkpoint.getChunkDb(chunk);
+                tmpDbw = new DBWriter(chunkDb.first.c_str(), chunkDb.second.c_str(), localThreads, compressed | Parameters::WRITER_DIRECT_MODE, Parameters::DBTYPE_PREFILTER_RES);
+                tmpDbw->open();
+            }
 #pragma omp for schedule(dynamic, 1) reduction (+: kmersPerPos, resSize, dbMatches, doubleMatches, querySeqLenSum, diagonalOverflow)
-        for (size_t id = queryFrom; id < queryFrom + querySize; id++) {
-            progress.updateProgress();
-            // get query sequence
-            char *seqData = qdbr->getData(id, thread_idx);
-            unsigned int qKey = qdbr->getDbKey(id);
-            seq.mapSequence(id, qKey, seqData, qdbr->getSeqLen(id));
-            size_t targetSeqId = UINT_MAX;
-            if (sameQTDB || includeIdentical) {
-                targetSeqId = tdbr->getId(seq.getDbKey());
-                // only the corresponding split should include the id (hack for the hack)
-                if (targetSeqId >= dbFrom && targetSeqId < (dbFrom + dbSize) && targetSeqId != UINT_MAX) {
-                    targetSeqId = targetSeqId - dbFrom;
-                    if(targetSeqId > tdbr->getSize()){
-                        Debug(Debug::ERROR) << "targetSeqId: " << targetSeqId << " > target database size: "  << tdbr->getSize() <<  "\n";
-                        EXIT(EXIT_FAILURE);
+            for (size_t id = checkpoint.getChunkStart(chunk); id < checkpoint.getChunkEnd(chunk); id++) {
+                progress.updateProgress();
+                // get query sequence
+                char *seqData = qdbr->getData(id, thread_idx);
+                unsigned int qKey = qdbr->getDbKey(id);
+                seq.mapSequence(id, qKey, seqData, qdbr->getSeqLen(id));
+                size_t targetSeqId = UINT_MAX;
+                if (sameQTDB || includeIdentical) {
+                    targetSeqId = tdbr->getId(seq.getDbKey());
+                    // only the corresponding split should include the id (hack for the hack)
+                    if (targetSeqId >= dbFrom && targetSeqId < (dbFrom + dbSize) && targetSeqId != UINT_MAX) {
+                        targetSeqId = targetSeqId - dbFrom;
+                        if(targetSeqId > tdbr->getSize()){
+                            Debug(Debug::ERROR) << "targetSeqId: " << targetSeqId << " > target database size: "  << tdbr->getSize() <<  "\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                    }else{
+                        targetSeqId = UINT_MAX;
                     }
-                }else{
-                    targetSeqId = UINT_MAX;
                 }
-            }
-            // calculate prefiltering results
-            if (taxonomyHook != NULL) {
-                taxonomyHook->setDbFrom(dbFrom);
-            }
-            std::pair<hit_t *, size_t> prefResults = matcher.matchQuery(&seq, targetSeqId, targetSeqType==Parameters::DBTYPE_NUCLEOTIDES);
-            size_t resultSize = prefResults.second;
-            const float queryLength = static_cast<float>(qdbr->getSeqLen(id));
-            for (size_t i = 0; i < resultSize; i++) {
-                hit_t *res = prefResults.first + i;
-                // correct the 0 indexed sequence id again to its real identifier
-                size_t targetSeqId1 = res->seqId + dbFrom;
-                // replace id with key
-                res->seqId = tdbr->getDbKey(targetSeqId1);
-                if (UNLIKELY(targetSeqId1 >= tdbr->getSize())) {
-                    Debug(Debug::WARNING) << "Wrong prefiltering result for query: " << qdbr->getDbKey(id) << " -> " << targetSeqId1 << "\t" << res->prefScore << "\n";
+                // calculate prefiltering results
+                if (taxonomyHook != NULL) {
+                    taxonomyHook->setDbFrom(dbFrom);
                 }
+                std::pair<hit_t *, size_t> prefResults = matcher.matchQuery(&seq, targetSeqId, targetSeqType==Parameters::DBTYPE_NUCLEOTIDES);
+                size_t resultSize = prefResults.second;
+                const float queryLength = static_cast<float>(qdbr->getSeqLen(id));
+                for (size_t i = 0; i < resultSize; i++) {
+                    hit_t *res = prefResults.first + i;
+                    // correct the 0 indexed sequence id again to its real identifier
+                    size_t targetSeqId1 = res->seqId + dbFrom;
+                    // replace id with key
+                    res->seqId = tdbr->getDbKey(targetSeqId1);
+                    if (UNLIKELY(targetSeqId1 >= tdbr->getSize())) {
+                        Debug(Debug::WARNING) << "Wrong prefiltering result for query: " << qdbr->getDbKey(id) << " -> " << targetSeqId1 << "\t" << res->prefScore << "\n";
+                    }
 
-                // TODO: check if this should happen when diagonalScoring == false
-                if (covThr > 0.0 && (covMode == Parameters::COV_MODE_BIDIRECTIONAL
-                                               || covMode == Parameters::COV_MODE_QUERY
-                                               || covMode == Parameters::COV_MODE_LENGTH_SHORTER )) {
-                    const float targetLength = static_cast<float>(tdbr->getSeqLen(targetSeqId1));
-                    if (Util::canBeCovered(covThr, covMode, queryLength, targetLength) == false) {
-                        continue;
+                    // TODO: check if this should happen when diagonalScoring == false
+                    if (covThr > 0.0 && (covMode == Parameters::COV_MODE_BIDIRECTIONAL
+                                                   || covMode == Parameters::COV_MODE_QUERY
+                                                   || covMode == Parameters::COV_MODE_LENGTH_SHORTER )) {
+                        const float targetLength = static_cast<float>(tdbr->getSeqLen(targetSeqId1));
+                        if (Util::canBeCovered(covThr, covMode, queryLength, targetLength) == false) {
+                            continue;
+                        }
                     }
-                }
 
-                // write prefiltering results to a string
-                int len = QueryMatcher::prefilterHitToBuffer(buffer, *res);
-                result.append(buffer, len);
-            }
-            tmpDbw.writeData(result.c_str(), result.length(), qKey, thread_idx);
-            result.clear();
+                    // write prefiltering results to a string
+                    int len = QueryMatcher::prefilterHitToBuffer(buffer, *res);
+                    result.append(buffer, len);
+                }
+                tmpDbw->writeData(result.c_str(), result.length(), qKey, thread_idx);
+                result.clear();
 
-            // update statistics counters
-            if (resultSize != 0) {
-                notEmpty[id - queryFrom] = 1;
-            }
+                // update statistics counters
+                if (resultSize != 0) {
+                    notEmpty[id - queryFrom] = 1;
+                }
 
-            if (Debug::debugLevel >= Debug::INFO) {
-                kmersPerPos += matcher.getStatistics()->kmersPerPos;
-                dbMatches += matcher.getStatistics()->dbMatches;
-                doubleMatches += matcher.getStatistics()->doubleMatches;
-                querySeqLenSum += seq.L;
-                diagonalOverflow += matcher.getStatistics()->diagonalOverflow;
-                resSize += resultSize;
-                realResSize += std::min(resultSize, maxResListLen);
-                reslens[thread_idx]->emplace_back(resultSize);
+                if (Debug::debugLevel >= Debug::INFO) {
+                    kmersPerPos += matcher.getStatistics()->kmersPerPos;
+                    dbMatches += matcher.getStatistics()->dbMatches;
+                    doubleMatches += matcher.getStatistics()->doubleMatches;
+                    querySeqLenSum += seq.L;
+                    diagonalOverflow += matcher.getStatistics()->diagonalOverflow;
+                    resSize += resultSize;
+                    realResSize += std::min(resultSize, maxResListLen);
+                    reslens[thread_idx]->emplace_back(resultSize);
+                }
+            } // step end
+#pragma omp single
+            {
+                if (splitMode == Parameters::TARGET_DB_SPLIT && splits == 1) {
+#ifdef HAVE_MPI
+                    // if a mpi rank processed a single split, it must have it merged before all ranks can be united
+                    tmpDbw->close(true);
+#else
+                    tmpDbw->close(merge);
+#endif
+                } else {
+                    tmpDbw->close(merge);
+                }
+                delete tmpDbw;
+                tmpDbw = NULL;
+                checkpoint.commit(chunk);
             }
-        } // step end
+        }
     }
+    checkpoint.finish();
 
     if (Debug::debugLevel >= Debug::INFO) {
-        statistics_t stats(kmersPerPos / static_cast<double>(totalQueryDBSize),
-                           dbMatches / totalQueryDBSize,
-                           doubleMatches / totalQueryDBSize,
+        const size_t computedQueries = std::max(totalQueryDBSize - restoredQueries, (size_t) 1);
+        statistics_t stats(kmersPerPos / static_cast<double>(computedQueries),
+                           dbMatches / computedQueries,
+                           doubleMatches / computedQueries,
                            querySeqLenSum, diagonalOverflow,
                            resSize / totalQueryDBSize);
 
@@ -903,17 +1021,10 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
         }
 
         printStatistics(stats, reslens, localThreads, empty, maxResListLen);
-    }
-
-    if (splitMode == Parameters::TARGET_DB_SPLIT && splits == 1) {
-#ifdef HAVE_MPI
-        // if a mpi rank processed a single split, it must have it merged before all ranks can be united
-        tmpDbw.close(true);
-#else
-        tmpDbw.close(merge);
-#endif
-    } else {
-        tmpDbw.close(merge);
+        if (kmerListCache != NULL) {
+            Debug(Debug::INFO) << kmerListCache->getListCount() << " cached k-mer lists in "
+                               << (kmerListCache->getUsedBytes() / (1024 * 1024)) << " MB\n";
+        }
     }
 
     // sort by ids
@@ -929,7 +1040,7 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
             delete sequenceLookup;
             sequenceLookup = NULL;
         }
-        DBReader<unsigned int> resultReader(tmpDbw.getDataFileName(), tmpDbw.getIndexFileName(), threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+        DBReader<unsigned int> resultReader(resultDB.c_str(), resultDBIndex.c_str(), threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
         resultReader.open(DBReader<unsigned int>::NOSORT);
         resultReader.readMmapedDataInMemory();
         const std::pair<std::string, std::string> tempDb = Util::databaseNames((resultDB + "_tmp"));
@@ -11,6 +11,7 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <utility>
 
 class QueryMatcherTaxonomyHook;
@@ -78,6 +79,8 @@ private:
     ScoreMatrix _3merSubMatrix;
     IndexTable *indexTable;
     SequenceLookup *sequenceLookup;
+    // shared by the query matchers of all splits, NULL if disabled
+    KmerListCache *kmerListCache;
 
     // parameter
     int splits;
@@ -112,7 +115,11 @@ private:
     int preloadMode;
     const unsigned int threads;
     int compressed;
+    const size_t checkpointInterval;
+    const uint64_t checkpointFingerprint;
     QueryMatcherTaxonomyHook* taxonomyHook;
+    // target index entries also present in --live-target-db, empty if all entries are live
+    std::vector<uint64_t> liveTargets;
 
     bool runSplit(const std::string &resultDB, const std::string &resultDBIndex, size_t split, bool merge);
 
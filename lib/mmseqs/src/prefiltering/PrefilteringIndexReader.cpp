@@ -342,7 +342,7 @@ DBReader<unsigned int> *PrefilteringIndexReader::openNewReader(DBReader<unsigned
         size_t nextDataOffset = dbr->findNextOffsetid(id);
         size_t dataSize = nextDataOffset-currDataOffset;
         reader->setData(dbr->getDataUncompressed(id), dataSize);
-        reader->setMode(DBReader<unsigned int>::USE_DATA);
+        reader->setMode(DBReader<unsigned int>::USE_DATA | (dbr->getMode() & DBReader<unsigned int>::USE_SHM));
         return reader;
     }
 
@@ -26,12 +26,15 @@ QueryMatcher::QueryMatcher(IndexTable *indexTable, SequenceLookup *sequenceLooku
                            bool diagonalScoring, unsigned int minDiagScoreThr, bool takeOnlyBestKmer, bool isNucleotide)
         : idx(indexTable->getAlphabetSize(), kmerSize), isNucleotide(isNucleotide), hook(NULL)
 {
+    this->liveTargets = NULL;
+    this->liveTargetsOffset = 0;
     this->kmerSubMat = kmerSubMat;
     this->ungappedAlignmentSubMat = ungappedAlignmentSubMat;
     this->indexTable = indexTable;
     this->kmerSize = kmerSize;
     this->kmerThr = kmerThr;
     this->kmerGenerator = new KmerGenerator(kmerSize, indexTable->getAlphabetSize(), kmerThr);
+    this->kmerListCache = NULL;
     this->aaBiasCorrection = aaBiasCorrection;
     this->scaleBiasCorr = aaBiasCorrectionScale;
     this->takeOnlyBestKmer = takeOnlyBestKmer;
@@ -250,6 +253,15 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
             kmerElementSize = 1;
             exactKmer = idx.int2index(kmer);
             index = &exactKmer;
+        } else if (kmerListCache != NULL) {
+            exactKmer = idx.int2index(kmer);
+            std::pair<size_t*, size_t> kmerList = kmerListCache->get(exactKmer, kmerMatchScore);
+            if (kmerList.first == NULL) {
+                kmerList = kmerGenerator->generateKmerList(kmer);
+                kmerListCache->add(exactKmer, kmerMatchScore, kmerList.first, kmerList.second);
+            }
+            kmerElementSize = kmerList.second;
+            index = kmerList.first;
         } else {
             std::pair<size_t*, size_t> kmerList = kmerGenerator->generateKmerList(kmer);
             kmerElementSize = kmerList.second;
@@ -314,9 +326,22 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
                     goto outer;
                 }
             }
-            memcpy(sequenceHits, entries, sizeof(IndexEntryLocal) * seqListSize);
-            sequenceHits += seqListSize;
-            numMatches += seqListSize;
+            if (liveTargets == NULL) {
+                memcpy(sequenceHits, entries, sizeof(IndexEntryLocal) * seqListSize);
+                sequenceHits += seqListSize;
+                numMatches += seqListSize;
+            } else {
+                size_t liveListSize = 0;
+                for (size_t i = 0; i < seqListSize; i++) {
+                    const size_t id = entries[i].seqId + liveTargetsOffset;
+                    if ((liveTargets[id >> 6] >> (id & 63)) & 1) {
+                        sequenceHits[liveListSize] = entries[i];
+                        liveListSize++;
+                    }
+                }
+                sequenceHits += liveListSize;
+                numMatches += liveListSize;
+            }
         }
         indexTo = current_i;
     }
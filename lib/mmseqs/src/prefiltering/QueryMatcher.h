@@ -11,6 +11,7 @@
 #include "CacheFriendlyOperations.h"
 #include "UngappedAlignment.h"
 #include "KmerGenerator.h"
+#include "KmerListCache.h"
 
 
 struct statistics_t{
@@ -77,6 +78,18 @@ public:
         kmerGenerator->setDivideStrategy(three, two);
     }
 
+    // similar k-mer lists are looked up in and added to the shared cache, NULL generates every list
+    // must only be set if the k-mer generator uses the substitution matrices and not a profile
+    void setKmerListCache(KmerListCache *cache) {
+        this->kmerListCache = cache;
+    }
+
+    // only index entries with a set bit (seqId + offset) are matched, NULL matches all entries
+    void setLiveTargets(const uint64_t *liveTargets, size_t offset) {
+        this->liveTargets = liveTargets;
+        this->liveTargetsOffset = offset;
+    }
+
     // get statistics
     const statistics_t *getStatistics() {
         return stats;
@@ -141,6 +154,7 @@ protected:
     BaseMatrix *ungappedAlignmentSubMat;
     /* generates kmer lists */
     KmerGenerator *kmerGenerator;
+    KmerListCache *kmerListCache;
     /* contains the sequences for a kmer */
     IndexTable *indexTable;
     // k of the k-mer
@@ -184,6 +198,10 @@ protected:
     // last data pointer (for overflow check)
     IndexEntryLocal *lastSequenceHit;
 
+    // bitmap of target entries that may be reported
+    const uint64_t *liveTargets;
+    size_t liveTargetsOffset;
+
     // max seq. per query
     size_t maxHitsPerQuery;
 
@@ -7,11 +7,18 @@
 #include "Debug.h"
 #include "Util.h"
 #include "SequenceLookup.h"
+#include "HugePages.h"
 
 SequenceLookup::SequenceLookup(size_t sequenceCount, size_t dataSize)
-        : sequenceCount(sequenceCount), dataSize(dataSize), currentIndex(0), currentOffset(0), externalData(false) {
-    data = new(std::nothrow) char[dataSize + 1];
-    Util::checkAllocation(data, "Can not allocate data memory in SequenceLookup");
+        : sequenceCount(sequenceCount), dataSize(dataSize), currentIndex(0), currentOffset(0), externalData(false),
+          hugePages(HugePages::enabled()) {
+    if (hugePages) {
+        int pageMode;
+        data = (char *) HugePages::allocate(dataSize + 1, pageMode);
+    } else {
+        data = new(std::nothrow) char[dataSize + 1];
+        Util::checkAllocation(data, "Can not allocate data memory in SequenceLookup");
+    }
 
     offsets = new(std::nothrow) size_t[sequenceCount + 1];
     Util::checkAllocation(offsets, "Can not allocate offsets memory in SequenceLookup");
@@ -19,12 +26,16 @@ SequenceLookup::SequenceLookup(size_t sequenceCount, size_t dataSize)
 }
 
 SequenceLookup::SequenceLookup(size_t sequenceCount)
-        : sequenceCount(sequenceCount), data(NULL), dataSize(0), offsets(NULL), currentIndex(0), currentOffset(0), externalData(true) {
+        : sequenceCount(sequenceCount), data(NULL), dataSize(0), offsets(NULL), currentIndex(0), currentOffset(0), externalData(true), hugePages(false) {
 }
 
 SequenceLookup::~SequenceLookup() {
     if(externalData == false){
-        delete[] data;
+        if (hugePages) {
+            HugePages::release(data, dataSize + 1);
+        } else {
+            delete[] data;
+        }
         delete[] offsets;
     }
 }
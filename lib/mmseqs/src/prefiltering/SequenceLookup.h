@@ -50,6 +50,8 @@ private:
 
     // if data are read from mmap
     bool externalData;
+    // data is allocated through HugePages
+    bool hugePages;
 };
 
 
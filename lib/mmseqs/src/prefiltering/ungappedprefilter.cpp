@@ -26,8 +26,7 @@ int prefilterInternal(int argc, const char **argv, const Command &command, int m
     DBWriter resultWriter(par.db3.c_str(), par.db3Index.c_str(), 1, par.compressed, Parameters::DBTYPE_PREFILTER_RES);
     resultWriter.open();
     bool sameDB = (par.db2.compare(par.db1) == 0);
-    bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
-    IndexReader tDbrIdx(par.db2, par.threads, IndexReader::SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0 );
+    IndexReader tDbrIdx(par.db2, par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) );
     IndexReader * qDbrIdx = NULL;
     DBReader<unsigned int> * qdbr = NULL;
     DBReader<unsigned int> * tdbr = tDbrIdx.sequenceReader;
@@ -39,7 +38,7 @@ int prefilterInternal(int argc, const char **argv, const Command &command, int m
         querySeqType = targetSeqType;
     } else {
         // open the sequence, prefiltering and output databases
-        qDbrIdx = new IndexReader(par.db1, par.threads,  IndexReader::SEQUENCES, (touch) ? IndexReader::PRELOAD_INDEX : 0);
+        qDbrIdx = new IndexReader(par.db1, par.threads,  IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
         qdbr = qDbrIdx->sequenceReader;
         querySeqType = qdbr->getDbtype();
     }
@@ -0,0 +1,87 @@
+// asserts are the test checks, keep them in release builds
+#undef NDEBUG
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "Command.h"
+#include "CommandDeclarations.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "DownloadDatabase.h"
+#include "Parameters.h"
+#include "Prefiltering.h"
+#include "Util.h"
+
+const char* binary_name = "test_streamtargets";
+extern const char* MMSEQS_CURRENT_INDEX_VERSION;
+const char* index_version_compatible = MMSEQS_CURRENT_INDEX_VERSION;
+std::vector<KmerThreshold> externalThreshold = {};
+std::vector<DatabaseDownload> externalDownloads = {};
+bool hide_base_downloads = false;
+DEFAULT_PARAMETER_SINGLETON_INIT
+
+static void writeSequenceDb(const std::string &db, const std::vector<std::string> &sequences) {
+    DBWriter writer(db.c_str(), (db + ".index").c_str(), 1, 0, Parameters::DBTYPE_AMINO_ACIDS);
+    writer.open();
+    for (size_t i = 0; i < sequences.size(); i++) {
+        std::string entry = sequences[i] + "\n";
+        writer.writeData(entry.c_str(), entry.size(), i, 0);
+    }
+    writer.close(true);
+}
+
+// More queries than --max-seqs hit the same target. Every query has to keep that target,
+// as in the search without --stream-targets, which caps the hits per query and not per target.
+int main(int, const char**) {
+    char tmpTemplate[] = "/tmp/test_streamtargets_XXXXXX";
+    char *tmpDir = mkdtemp(tmpTemplate);
+    assert(tmpDir != NULL);
+    const std::string queryDb = std::string(tmpDir) + "/query";
+    const std::string targetDb = std::string(tmpDir) + "/target";
+    const std::string resultDb = std::string(tmpDir) + "/pref";
+
+    const std::string sequence = "MKTAYIAKQRQISFVKSHFSRQLEERLGLIEVQAPILSRVGDGTQDNLSGAEKAVQVKVKALPDAQFEVVHSLAKWKRQTLGQHDFSAGEGLYTHMKALRPDEDRLSPLHSVYVDQWDWERVMGDGERQFSTLKSTVEAIWAGIKATEAAVSEEFGLAPFLPDQIHFVHSQELLSRYPDLDAKGRERAIAKDLGAVFLVGIGGKLSDGHRHDVRAPDYDDWSTPSELGHAGLNGDILVWNPVLEDAFELSSMGIRVDADTLKHQLALTGDEDRLELEWHQALLRGEMPQTIGGGIGQSRLTMLLLQLPHIGQVQCGVWPAACRESVPALL";
+    const size_t queryCount = 10;
+    const size_t maxSeqs = 3;
+    writeSequenceDb(queryDb, std::vector<std::string>(queryCount, sequence));
+    writeSequenceDb(targetDb, std::vector<std::string>(1, sequence));
+
+    Parameters &par = Parameters::getInstance();
+    Command command = { "prefilter", prefilter, &par.prefilter, COMMAND_PREFILTER, "", NULL, "", "", 0, {} };
+    const std::string maxSeqsValue = SSTR(maxSeqs);
+    const char *argv[] = { queryDb.c_str(), targetDb.c_str(), resultDb.c_str(), "--stream-targets", "1",
+                           "--max-seqs", maxSeqsValue.c_str(), "--threads", "1", "-v", "1" };
+    assert(prefilter(sizeof(argv) / sizeof(argv[0]), argv, command) == EXIT_SUCCESS);
+
+    DBReader<unsigned int> reader(resultDb.c_str(), (resultDb + ".index").c_str(), 1,
+                                  DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    reader.open(DBReader<unsigned int>::NOSORT);
+    assert(reader.getSize() == queryCount);
+    size_t queriesWithHit = 0;
+    for (size_t i = 0; i < reader.getSize(); i++) {
+        char *data = reader.getData(i, 0);
+        char dbKey[255 + 1];
+        while (*data != '\0') {
+            Util::parseKey(data, dbKey);
+            if (Util::fast_atoi<unsigned int>(dbKey) == 0) {
+                queriesWithHit++;
+                break;
+            }
+            data = Util::skipLine(data);
+        }
+    }
+    reader.close();
+    std::cout << queriesWithHit << " of " << queryCount << " queries found the target with --max-seqs " << maxSeqs << std::endl;
+    assert(queriesWithHit == queryCount);
+
+    DBReader<unsigned int>::removeDb(queryDb);
+    DBReader<unsigned int>::removeDb(targetDb);
+    DBReader<unsigned int>::removeDb(resultDb);
+    rmdir(tmpDir);
+    return EXIT_SUCCESS;
+}
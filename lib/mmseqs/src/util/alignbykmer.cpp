@@ -23,8 +23,7 @@ int alignbykmer(int argc, const char **argv, const Command &command) {
     Parameters &par = Parameters::getInstance();
     par.parseParameters(argc, argv, command, true, 0, 0);
 
-    bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
-    IndexReader * tDbrIdx = new IndexReader(par.db2, par.threads, IndexReader::SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0 );
+    IndexReader * tDbrIdx = new IndexReader(par.db2, par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) );
     IndexReader * qDbrIdx = NULL;
     int querySeqType = 0;
     DBReader<unsigned int> * qdbr = NULL;
@@ -37,7 +36,7 @@ int alignbykmer(int argc, const char **argv, const Command &command) {
         querySeqType = targetSeqType;
     } else {
         // open the sequence, prefiltering and output databases
-        qDbrIdx = new IndexReader(par.db1, par.threads,  IndexReader::SEQUENCES, (touch) ? IndexReader::PRELOAD_INDEX : 0);
+        qDbrIdx = new IndexReader(par.db1, par.threads,  IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
         qdbr = qDbrIdx->sequenceReader;
         querySeqType = qdbr->getDbtype();
     }
@@ -153,7 +153,6 @@ int convertalignments(int argc, const char **argv, const Command &command) {
         format = Parameters::FORMAT_ALIGNMENT_BLAST_TAB;
         addColumnHeaders = true;
     }
-    const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
 
     bool needSequenceDB = false;
     bool needBacktrace = false;
@@ -198,8 +197,8 @@ int convertalignments(int argc, const char **argv, const Command &command) {
         tSetToSource = readSetToSource(file2);
     }
 
-    IndexReader qDbr(par.db1, par.threads,  IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0, dbaccessMode);
-    IndexReader qDbrHeader(par.db1, par.threads, IndexReader::SRC_HEADERS , (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+    IndexReader qDbr(par.db1, par.threads,  IndexReader::SRC_SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA), dbaccessMode);
+    IndexReader qDbrHeader(par.db1, par.threads, IndexReader::SRC_HEADERS , IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
 
     IndexReader *tDbr;
     IndexReader *tDbrHeader;
@@ -207,8 +206,8 @@ int convertalignments(int argc, const char **argv, const Command &command) {
         tDbr = &qDbr;
         tDbrHeader= &qDbrHeader;
     } else {
-        tDbr = new IndexReader(par.db2, par.threads, IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0, dbaccessMode);
-        tDbrHeader = new IndexReader(par.db2, par.threads, IndexReader::SRC_HEADERS, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+        tDbr = new IndexReader(par.db2, par.threads, IndexReader::SRC_SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA), dbaccessMode);
+        tDbrHeader = new IndexReader(par.db2, par.threads, IndexReader::SRC_HEADERS, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
     }
 
     bool queryNucs = Parameters::isEqualDbtype(qDbr.sequenceReader->getDbtype(), Parameters::DBTYPE_NUCLEOTIDES);
@@ -4,15 +4,92 @@
 #include "Util.h"
 #include "FastSort.h"
 #include "Parameters.h"
+#include "itoa.h"
 
 #ifdef OPENMP
 #include <omp.h>
 #endif
 
+// appends all entries below a node of the given level, level 0 nodes are the entries themselves
+static void appendLeaves(std::vector<DBReader<unsigned int>*> &levels, size_t level, unsigned int key,
+                         unsigned int thread_idx, std::string &result) {
+    if (level == 0) {
+        char buffer[32];
+        char *tmpBuff = Itoa::u32toa_sse2(key, buffer);
+        result.append(buffer, tmpBuff - buffer - 1);
+        result.push_back('\n');
+        return;
+    }
+    DBReader<unsigned int> *reader = levels[level - 1];
+    size_t id = reader->getId(key);
+    if (id == UINT_MAX) {
+        Debug(Debug::ERROR) << "Entry " << key << " of cluster level " << (level + 1) << " is not a representative in cluster level " << level << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    // copy the members, getData of the next level might reuse the decompression buffer
+    std::vector<unsigned int> members;
+    char *data = reader->getData(id, thread_idx);
+    while (*data != '\0') {
+        members.emplace_back(Util::fast_atoi<unsigned int>(data));
+        data = Util::skipLine(data);
+    }
+    for (size_t i = 0; i < members.size(); i++) {
+        appendLeaves(levels, level - 1, members[i], thread_idx, result);
+    }
+}
+
 int createclusearchdb(int argc, const char **argv, const Command& command) {
     Parameters &par = Parameters::getInstance();
     par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
-    DBReader<unsigned int> clusterReader(par.db2.c_str(), par.db2Index.c_str(), par.threads,
+    // more than one clustering describes a hierarchy: each clustering clusters the representatives of the previous one
+    const std::string outDb = par.filenames.back();
+    const size_t levelCount = par.filenames.size() - 2;
+    std::string clusterDb = par.db2;
+    // search detects the levels by the consecutive _clu_<level> DBs, remove those of a previous run with more levels
+    for (size_t level = (levelCount > 1 ? levelCount + 1 : 1);
+         FileUtil::fileExists((outDb + "_clu_" + SSTR(level) + ".dbtype").c_str()); level++) {
+        DBReader<unsigned int>::removeDb(outDb + "_clu_" + SSTR(level));
+    }
+    if (levelCount > 1) {
+        std::vector<DBReader<unsigned int>*> levels;
+        for (size_t i = 0; i < levelCount; i++) {
+            const std::string &levelDb = par.filenames[i + 1];
+            DBReader<unsigned int> *reader = new DBReader<unsigned int>(levelDb.c_str(), (levelDb + ".index").c_str(), par.threads,
+                                                                        DBReader<unsigned int>::USE_DATA | DBReader<unsigned int>::USE_INDEX);
+            reader->open(DBReader<unsigned int>::NOSORT);
+            levels.emplace_back(reader);
+        }
+        // the top level flattened to the entries is the clustering of the representative DB
+        clusterDb = outDb + "_clu";
+        DBWriter dbwFlat(clusterDb.c_str(), (clusterDb + ".index").c_str(), static_cast<unsigned int>(par.threads), par.compressed,
+                         Parameters::DBTYPE_CLUSTER_RES);
+        dbwFlat.open();
+        DBReader<unsigned int> *top = levels.back();
+        Debug::Progress progress(top->getSize());
+#pragma omp parallel
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+            std::string result;
+#pragma omp for schedule(dynamic, 10)
+            for (size_t id = 0; id < top->getSize(); id++) {
+                progress.updateProgress();
+                unsigned int repKey = top->getDbKey(id);
+                appendLeaves(levels, levelCount, repKey, thread_idx, result);
+                dbwFlat.writeData(result.c_str(), result.length(), repKey, thread_idx);
+                result.clear();
+            }
+        }
+        dbwFlat.close();
+        for (size_t i = 0; i < levelCount; i++) {
+            levels[i]->close();
+            delete levels[i];
+            DBReader<unsigned int>::copyDb(par.filenames[i + 1], outDb + "_clu_" + SSTR(i + 1));
+        }
+    }
+    DBReader<unsigned int> clusterReader(clusterDb.c_str(), (clusterDb + ".index").c_str(), par.threads,
                                          DBReader<unsigned int>::USE_DATA | DBReader<unsigned int>::USE_INDEX);
     clusterReader.open(DBReader<unsigned int>::NOSORT);
     std::vector<std::string> suffixes = Util::split(par.dbSuffixList, ",");
@@ -25,14 +102,14 @@ int createclusearchdb(int argc, const char **argv, const Command& command) {
         reader.open(DBReader<unsigned int>::NOSORT);
         reader.readMmapedDataInMemory();
 
-        std::string repDbSeq = par.db3 + suffixes[prefix];
-        std::string repDbSeqIdx = par.db3 + suffixes[prefix] + ".index";
+        std::string repDbSeq = outDb + suffixes[prefix];
+        std::string repDbSeqIdx = outDb + suffixes[prefix] + ".index";
 
         DBWriter dbwRep(repDbSeq.c_str(), repDbSeqIdx.c_str(), static_cast<unsigned int>(par.threads), par.compressed,
                         reader.getDbtype());
         dbwRep.open();
-        std::string seqsDbSeq = par.db3 + "_seq" + suffixes[prefix];
-        std::string seqsDbSeqIdx = par.db3 + "_seq" + suffixes[prefix] + ".index";
+        std::string seqsDbSeq = outDb + "_seq" + suffixes[prefix];
+        std::string seqsDbSeqIdx = outDb + "_seq" + suffixes[prefix] + ".index";
         DBWriter dbwClu(seqsDbSeq.c_str(), seqsDbSeqIdx.c_str(), static_cast<unsigned int>(par.threads), par.compressed,
                         reader.getDbtype());
         dbwClu.open();
@@ -111,7 +188,9 @@ int createclusearchdb(int argc, const char **argv, const Command& command) {
         dbrSeq.close();
     }
     clusterReader.close();
-    DBReader<unsigned int>::copyDb(par.db2, par.db3 + "_clu");
+    if (levelCount == 1) {
+        DBReader<unsigned int>::copyDb(par.db2, outDb + "_clu");
+    }
 
     struct DBSuffix {
         DBFiles::Files flag;
@@ -131,13 +210,13 @@ int createclusearchdb(int argc, const char **argv, const Command& command) {
     for (size_t i = 0; i < ARRAY_SIZE(suffices); ++i) {
         std::string file = par.db1 + suffices[i].suffix;
         if (suffices[i].flag && FileUtil::fileExists(file.c_str())) {
-            DBReader<unsigned int>::copyDb(file, par.db3 + suffices[i].suffix);
+            DBReader<unsigned int>::copyDb(file, outDb + suffices[i].suffix);
         }
     }
     for (size_t i = 0; i < ARRAY_SIZE(suffices); ++i) {
-        std::string file = par.db3 + suffices[i].suffix;
+        std::string file = outDb + suffices[i].suffix;
         if (suffices[i].flag && FileUtil::fileExists(file.c_str())) {
-            std::string fileToLinkTo = par.db3 + "_seq" + suffices[i].suffix;
+            std::string fileToLinkTo = outDb + "_seq" + suffices[i].suffix;
             if (FileUtil::fileExists(fileToLinkTo.c_str())){
                 DBReader<unsigned int>::removeDb(fileToLinkTo);
             }
@@ -0,0 +1,165 @@
+#include "Parameters.h"
+#include "DBReader.h"
+#include "Debug.h"
+#include "FileUtil.h"
+#include "Util.h"
+
+#include <cstring>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+// the index stores the compressed size for compressed DBs, their decompressed data is terminated by '\0'
+static size_t dataLength(DBReader<unsigned int> &reader, size_t id, const char *data) {
+    return reader.isCompressed() ? strlen(data) : reader.getEntryLen(id) - 1;
+}
+
+// Writes the cluster TSV, the representative FASTA and the FASTA of all cluster members in one pass
+// over the cluster DB. Output is equivalent to createtsv, result2repseq + result2flat --use-fasta-header
+// and createseqfiledb + result2flat, but no intermediate DBs are created.
+// Clusters are processed in blocks, each chunk of a block is filled by one thread and the chunks are
+// written in cluster DB order, so the output does not depend on the number of threads.
+int createclusterfiles(int argc, const char **argv, const Command &command) {
+    Parameters &par = Parameters::getInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    DBReader<unsigned int> seqDb(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    seqDb.open(DBReader<unsigned int>::NOSORT);
+    if (par.preloadMode != Parameters::PRELOAD_MODE_MMAP) {
+        seqDb.readMmapedDataInMemory();
+    }
+
+    DBReader<unsigned int> headerDb(par.hdr1.c_str(), par.hdr1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    headerDb.open(DBReader<unsigned int>::NOSORT);
+    if (par.preloadMode != Parameters::PRELOAD_MODE_MMAP) {
+        headerDb.readMmapedDataInMemory();
+    }
+
+    DBReader<unsigned int> cluDb(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    cluDb.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+
+    FILE *tsvFile = FileUtil::openAndDelete(par.db3.c_str(), "w");
+    FILE *repFile = FileUtil::openAndDelete(par.db4.c_str(), "w");
+    FILE *allFile = FileUtil::openAndDelete(par.db5.c_str(), "w");
+
+    const size_t chunkSize = 256;
+    const size_t chunksPerBlock = std::max(static_cast<size_t>(par.threads) * 16, static_cast<size_t>(1));
+    std::vector<std::string> tsvChunks(chunksPerBlock);
+    std::vector<std::string> repChunks(chunksPerBlock);
+    std::vector<std::string> allChunks(chunksPerBlock);
+
+    Debug::Progress progress(cluDb.getSize());
+    for (size_t blockStart = 0; blockStart < cluDb.getSize(); blockStart += chunkSize * chunksPerBlock) {
+        const size_t blockEnd = std::min(blockStart + chunkSize * chunksPerBlock, cluDb.getSize());
+        const size_t chunks = (blockEnd - blockStart + chunkSize - 1) / chunkSize;
+#pragma omp parallel
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+            char dbKey[255];
+            std::string repHeader;
+#pragma omp for schedule(dynamic, 1)
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                std::string &tsv = tsvChunks[chunk];
+                std::string &rep = repChunks[chunk];
+                std::string &all = allChunks[chunk];
+                tsv.clear();
+                rep.clear();
+                all.clear();
+                const size_t chunkEnd = std::min(blockStart + (chunk + 1) * chunkSize, blockEnd);
+                for (size_t i = blockStart + chunk * chunkSize; i < chunkEnd; ++i) {
+                    progress.updateProgress();
+
+                    char *data = cluDb.getData(i, thread_idx);
+                    if (*data == '\0') {
+                        continue;
+                    }
+                    const unsigned int repKey = cluDb.getDbKey(i);
+                    const size_t repHeaderId = headerDb.getId(repKey);
+                    const size_t repSeqId = seqDb.getId(repKey);
+                    if (repHeaderId == UINT_MAX || repSeqId == UINT_MAX) {
+                        Debug(Debug::ERROR) << "Entry " << repKey << " does not contain a sequence\n";
+                        EXIT(EXIT_FAILURE);
+                    }
+                    // copied, the member lookups below reuse the decompression buffer of compressed header DBs
+                    const char *repHeaderData = headerDb.getData(repHeaderId, thread_idx);
+                    repHeader.assign(repHeaderData, Util::skipLine((char *) repHeaderData) - repHeaderData);
+                    const std::string repAccession = Util::parseFastaHeader(repHeader.c_str());
+
+                    rep.append(1, '>');
+                    rep.append(repHeader);
+                    if (rep.back() == '\n') {
+                        rep.back() = ' ';
+                    }
+                    rep.append(1, '\n');
+                    const char *repSequence = seqDb.getData(repSeqId, thread_idx);
+                    const size_t repSequenceLen = dataLength(seqDb, repSeqId, repSequence);
+                    rep.append(repSequence, repSequenceLen);
+                    if (repSequenceLen == 0 || rep.back() != '\n') {
+                        rep.append(1, '\n');
+                    }
+
+                    all.append(1, '>');
+                    all.append(repAccession);
+                    all.append(1, '\n');
+
+                    while (*data != '\0') {
+                        Util::parseKey(data, dbKey);
+                        data = Util::skipLine(data);
+
+                        const unsigned int memberKey = (unsigned int) strtoul(dbKey, NULL, 10);
+                        const size_t headerId = headerDb.getId(memberKey);
+                        const size_t seqId = seqDb.getId(memberKey);
+                        if (headerId == UINT_MAX || seqId == UINT_MAX) {
+                            Debug(Debug::ERROR) << "Entry " << memberKey << " does not contain a sequence\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                        const char *header = headerDb.getData(headerId, thread_idx);
+                        const size_t headerLen = dataLength(headerDb, headerId, header);
+                        const char *sequence = seqDb.getData(seqId, thread_idx);
+                        const size_t sequenceLen = dataLength(seqDb, seqId, sequence);
+
+                        tsv.append(repAccession);
+                        tsv.append(1, '\t');
+                        tsv.append(Util::parseFastaHeader(header));
+                        tsv.append(1, '\n');
+
+                        all.append(1, '>');
+                        all.append(header, headerLen);
+                        all.append(sequence, sequenceLen);
+                    }
+                }
+            }
+        }
+
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            if (fwrite(tsvChunks[chunk].c_str(), sizeof(char), tsvChunks[chunk].size(), tsvFile) != tsvChunks[chunk].size()
+                || fwrite(repChunks[chunk].c_str(), sizeof(char), repChunks[chunk].size(), repFile) != repChunks[chunk].size()
+                || fwrite(allChunks[chunk].c_str(), sizeof(char), allChunks[chunk].size(), allFile) != allChunks[chunk].size()) {
+                Debug(Debug::ERROR) << "Cannot write cluster output\n";
+                EXIT(EXIT_FAILURE);
+            }
+        }
+    }
+
+    if (fclose(tsvFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << par.db3 << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(repFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << par.db4 << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(allFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << par.db5 << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    cluDb.close();
+    headerDb.close();
+    seqDb.close();
+
+    return EXIT_SUCCESS;
+}
@@ -21,10 +21,9 @@ int createtsv(int argc, const char **argv, const Command &command) {
 
     bool queryNucs = Parameters::isEqualDbtype(FileUtil::parseDbType(par.db1.c_str()), Parameters::DBTYPE_NUCLEOTIDES);
     bool targetNucs = Parameters::isEqualDbtype(FileUtil::parseDbType(par.db2.c_str()), Parameters::DBTYPE_NUCLEOTIDES);
-    const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
     int queryHeaderType = (queryNucs) ? IndexReader::SRC_HEADERS : IndexReader::HEADERS;
     queryHeaderType = (par.idxSeqSrc == 0) ? queryHeaderType :  (par.idxSeqSrc == 1) ?  IndexReader::HEADERS : IndexReader::SRC_HEADERS;
-    IndexReader qDbrHeader(par.db1, par.threads, queryHeaderType, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+    IndexReader qDbrHeader(par.db1, par.threads, queryHeaderType, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
     IndexReader * tDbrHeader=NULL;
     DBReader<unsigned int> * queryDB = qDbrHeader.sequenceReader;
     DBReader<unsigned int> * targetDB = NULL;
@@ -43,7 +42,7 @@ int createtsv(int argc, const char **argv, const Command &command) {
             int targetHeaderType = (targetNucs) ? IndexReader::SRC_HEADERS : IndexReader::HEADERS;
             targetHeaderType = (par.idxSeqSrc == 0) ? targetHeaderType :  (par.idxSeqSrc == 1) ?  IndexReader::HEADERS : IndexReader::SRC_HEADERS;
 
-            tDbrHeader = new IndexReader(par.db2, par.threads, targetHeaderType, touch);
+            tDbrHeader = new IndexReader(par.db2, par.threads, targetHeaderType, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_DATA));
             tHeaderIndex = tDbrHeader->sequenceReader->getIndex();
             targetDB = tDbrHeader->sequenceReader;
         }
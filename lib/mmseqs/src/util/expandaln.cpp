@@ -112,14 +112,13 @@ int expandaln(int argc, const char **argv, const Command& command, bool returnAl
     DBReader<unsigned int> *resultBcReader = NULL;
     IndexReader *resultBcReaderIdx = NULL;
     if (Parameters::isEqualDbtype(FileUtil::parseDbType(par.db2.c_str()), Parameters::DBTYPE_INDEX_DB)) {
-        bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
         cReaderIdx = new IndexReader(par.db2, par.threads,
                                      IndexReader::SRC_SEQUENCES,
-                                     (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+                                     IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
         cReader = cReaderIdx->sequenceReader;
         resultBcReaderIdx = new IndexReader(par.db4, par.threads,
                                             IndexReader::ALIGNMENTS,
-                                            (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+                                            IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
         resultBcReader = resultBcReaderIdx->sequenceReader;
     } else {
         cReader = new DBReader<unsigned int>(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
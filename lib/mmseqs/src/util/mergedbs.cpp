@@ -16,7 +16,7 @@ int mergedbs(int argc, const char **argv, const Command& command) {
 
     const std::vector<std::string> prefices = Util::split(par.mergePrefixes, ",");
 
-    const int preloadMode = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP) ? IndexReader::PRELOAD_INDEX : 0;
+    const int preloadMode = IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX);
     IndexReader qDbr(par.db1, 1, IndexReader::SEQUENCES, preloadMode, DBReader<unsigned int>::USE_INDEX);
 
     // skip par.db{1,2}
@@ -19,7 +19,6 @@ int mergeresultsbyset(int argc, const char **argv, const Command &command) {
 //    resultReader.open(DBReader<unsigned int>::NOSORT);
 
 
-    const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
     unsigned int databaseType = IndexReader::USER_SELECT;
     int dbtype = FileUtil::parseDbType(par.db2.c_str());
     if(Parameters::isEqualDbtype(dbtype, Parameters::DBTYPE_INDEX_DB)||
@@ -30,7 +29,7 @@ int mergeresultsbyset(int argc, const char **argv, const Command &command) {
     }
     IndexReader resultReader(par.db2, par.threads,
                               databaseType,
-                             (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+                             IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
 
     int dbType = resultReader.sequenceReader->getDbtype();
     dbType = DBReader<unsigned int>::setExtendedDbtype(dbType, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
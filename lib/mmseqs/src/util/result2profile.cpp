@@ -68,10 +68,9 @@ int result2profile(int argc, const char **argv, const Command &command, bool ret
     if (Parameters::isEqualDbtype(targetDbtype, Parameters::DBTYPE_INDEX_DB)) {
         uint16_t extended = DBReader<unsigned int>::getExtendedDbtype(FileUtil::parseDbType(par.db3.c_str()));
         needSrcIndex = extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC;
-        bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
         tDbrIdx = new IndexReader(par.db2, par.threads,
                                   needSrcIndex ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-                                  (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+                                  IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
         tDbr = tDbrIdx->sequenceReader;
         templateDBIsIndex = true;
         targetSeqType = tDbr->getDbtype();
@@ -71,11 +71,10 @@ int doswap(Parameters& par, bool isGeneralMode) {
         };
         resultReader.close();
     } else {
-        bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
-        IndexReader query(par.db1, par.threads, IndexReader::SEQUENCES, (touch) ? IndexReader::PRELOAD_INDEX : 0);
+        IndexReader query(par.db1, par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
         aaResSize = query.sequenceReader->getAminoAcidDBSize();
 
-        IndexReader target(par.db2, par.threads, IndexReader::SEQUENCES, (touch) ? IndexReader::PRELOAD_INDEX : 0);
+        IndexReader target(par.db2, par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
         maxTargetId = target.sequenceReader->getLastKey();
 
         targetElementExists = new char[maxTargetId + 1];
@@ -9,8 +9,10 @@ LocalParameters& localPar = LocalParameters::getLocalInstance();
 void updateValdiation() {
     DbValidator::allDb.push_back(LocalParameters::DBTYPE_CA_ALPHA);
     DbValidator::allDb.push_back(LocalParameters::DBTYPE_TMSCORE);
+    DbValidator::allDb.push_back(LocalParameters::DBTYPE_FEATURES);
     DbValidator::allDbAndFlat.push_back(LocalParameters::DBTYPE_CA_ALPHA);
     DbValidator::allDbAndFlat.push_back(LocalParameters::DBTYPE_TMSCORE);
+    DbValidator::allDbAndFlat.push_back(LocalParameters::DBTYPE_FEATURES);
 }
 void (*validatorUpdate)(void) = updateValdiation;
 
@@ -152,6 +154,66 @@ std::vector<Command> foldseekCommands = {
                                            {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                            {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::resultDb },
                                            {"alnDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &FoldSeekDbValidator::alignmentDb }}},
+        {"reassignsplit",       reassignsplit,       &localPar.threadsandcompression, COMMAND_CLUSTER | COMMAND_EXPERT,
+                "Split clusters into members that pass the alignment to their representative and rejected members",
+                "# Used by cluster --cluster-reassign\n"
+                "foldseek reassignsplit DB clu aln clu_accepted rejected seeds\n",
+                "agent <agent@local>",
+                "<i:sequenceDB> <i:clusterDB> <i:alignmentDB> <o:clusterDB> <o:sequenceDB> <o:sequenceDB>",
+                CITATION_FOLDSEEK, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"clusterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
+                                           {"alignmentDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
+                                           {"clusterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
+                                           {"sequenceDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"sequenceDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::sequenceDb }}},
+        {"reassignmerge",       reassignmerge,       &localPar.threadsandcompression, COMMAND_CLUSTER | COMMAND_EXPERT,
+                "Merge accepted cluster members and reassigned members into a graph for clust",
+                "# Used by cluster --cluster-reassign\n"
+                "foldseek reassignmerge DB clu_accepted seeds_aln graph\n",
+                "agent <agent@local>",
+                "<i:sequenceDB> <i:clusterDB> <i:alignmentDB> <o:clusterDB>",
+                CITATION_FOLDSEEK, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"clusterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
+                                           {"alignmentDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
+                                           {"clusterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::clusterDb }}},
+        {"reorderdb",           reorderdb,           &localPar.onlythreads,         COMMAND_CLUSTER | COMMAND_EXPERT,
+                "Reorder a database so that members of a cluster are stored next to their representative",
+                "# Reorder the target database by a clustering and recreate the index\n"
+                "foldseek cluster DB clu tmp\n"
+                "foldseek reorderdb DB clu DB_reordered\n"
+                "foldseek createindex DB_reordered tmp\n",
+                "agent <agent@local>",
+                "<i:sequenceDB> <i:clusterDB> <o:sequenceDB>",
+                CITATION_FOLDSEEK, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"clusterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
+                                           {"sequenceDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::sequenceDb }}},
+        {"sketchmatcher",       sketchmatcher,       &localPar.sketchmatcher,       COMMAND_CLUSTER | COMMAND_EXPERT,
+                "Find linclust candidate pairs from MinHash sketches of 3Di+AA k-mers",
+                "# Used by cluster --sketch-prefilter 1\n"
+                "foldseek sketchmatcher DB pref --sketch-db DB_sketch\n",
+                "agent <agent@local>",
+                "<i:sequenceDB> <o:prefDB>",
+                CITATION_FOLDSEEK, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"prefDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::prefilterDb }}},
+        {"cachelookup",         cachelookup,         &localPar.threadsandcompression, COMMAND_ALIGNMENT | COMMAND_EXPERT,
+                "Answer queries from a result cache and list the queries that are not cached",
+                "# Used by search --result-cache\n"
+                "foldseek cachelookup queryDB cache/search cachedAlnDB missing.list\n",
+                "agent <agent@local>",
+                "<i:queryDB> <cacheDB> <o:alignmentDB> <o:missingFile>",
+                CITATION_FOLDSEEK, {{"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"cacheDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, NULL },
+                                           {"alignmentDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
+                                           {"missingFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile }}},
+        {"cachestore",          cachestore,          &localPar.onlythreads,         COMMAND_ALIGNMENT | COMMAND_EXPERT,
+                "Add the alignment results of a search to a result cache",
+                "# Used by search --result-cache\n"
+                "foldseek cachestore queryDB alnDB cache/search\n",
+                "agent <agent@local>",
+                "<i:queryDB> <i:alignmentDB> <cacheDB>",
+                CITATION_FOLDSEEK, {{"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"alignmentDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
+                                           {"cacheDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, NULL }}},
         {"structurerescorediagonal",     structureungappedalign,       &localPar.structurerescorediagonal,      COMMAND_ALIGNMENT,
                 "Compute sequence identity for diagonal",
                 NULL,
@@ -207,11 +269,15 @@ std::vector<Command> foldseekCommands = {
                 "# cluster database and build a searchable db\n"
                 "foldseek cluster sequenceDB clusterDB tmp --min-seq-id 0.3\n"
                 "foldseek createclusearchdb sequenceDB clusterDB clusterSearchDb\n"
-                "foldseek search sequenceDB clusterSearchDb aln tmp --cluster-search 1\n",
+                "foldseek search sequenceDB clusterSearchDb aln tmp --cluster-search 1\n"
+                "# multi-level: each clustering clusters the representatives of the previous one\n"
+                "foldseek createsubdb clusterDB sequenceDB repDB\n"
+                "foldseek cluster repDB repClusterDB tmp -c 0.5\n"
+                "foldseek createclusearchdb sequenceDB clusterDB repClusterDB clusterSearchDb\n",
                 "Martin Steinegger <martin.steinegger@snu.ac.kr>",
-                "<i:sequenceDB> <i:clusterDB> <o:sequenceDB>",
+                "<i:sequenceDB> <i:clusterDB1> ... <i:clusterDBn> <o:sequenceDB>",
                 CITATION_FOLDSEEK|CITATION_MMSEQS2, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
-                                           {"clusterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
+                                           {"clusterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA | DbType::VARIADIC, &DbValidator::clusterDb },
                                            {"clusterSearchDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::sequenceDb }}},
         {"mmcreateindex",        createindex,          &localPar.createindex,          COMMAND_HIDDEN,
                 NULL,
@@ -250,6 +316,14 @@ std::vector<Command> foldseekCommands = {
                 "<i:DB> <o:caDB>",
                 CITATION_FOLDSEEK, {{"Db", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::sequenceDb },
                                            {"caDb", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &FoldSeekDbValidator::cadb }}},
+        {"precomputefeatures",   precomputefeatures,     &localPar.precomputefeatures, COMMAND_FORMAT_CONVERSION | COMMAND_EXPERT,
+                "Precompute numeric residues and C-alpha coordinates of a structure DB for the aligners",
+                "# Used automatically by structurealign and tmalign if DB_feat exists\n"
+                "foldseek precomputefeatures DB DB_feat\n",
+                "agent <agent@local>",
+                "<i:Db> <o:featureDb>",
+                CITATION_FOLDSEEK, {{"Db", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::sequenceDb },
+                                           {"featureDb", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &FoldSeekDbValidator::featuredb }}},
         {"convert2pdb",          convert2pdb,             &localPar.convert2pdb,          COMMAND_FORMAT_CONVERSION,
                 "Convert a foldseek structure db to a single multi model PDB file or a directory of PDB files",
                 NULL,
@@ -20,6 +20,13 @@ extern int structureeasyrbh(int argc, const char** argv, const Command &command)
 extern int structureungappedalign(int argc, const char** argv, const Command &command);
 extern int convert2pdb(int argc, const char** argv, const Command &command);
 extern int compressca(int argc, const char** argv, const Command &command);
+extern int precomputefeatures(int argc, const char** argv, const Command &command);
+extern int reassignsplit(int argc, const char** argv, const Command &command);
+extern int reassignmerge(int argc, const char** argv, const Command &command);
+extern int sketchmatcher(int argc, const char** argv, const Command &command);
+extern int reorderdb(int argc, const char **argv, const Command &command);
+extern int cachelookup(int argc, const char **argv, const Command &command);
+extern int cachestore(int argc, const char **argv, const Command &command);
 extern int scoremultimer(int argc, const char **argv, const Command& command);
 extern int easymultimersearch(int argc, const char **argv, const Command &command);
 extern int createmultimerreport(int argc, const char **argv, const Command &command);
@@ -22,15 +22,6 @@ LDDTCalculator::LDDTCalculator(unsigned int maxQueryLength, unsigned int maxTarg
     for(unsigned int i = 0; i < maxTargetLength; i++) {
         target_coordinates[i] = new float[3];
     }
-    dists_to_score = new bool*[maxQueryLength];
-    for(unsigned int i = 0; i < maxQueryLength; i++) {
-        dists_to_score[i] = new bool[maxQueryLength];
-    }
-
-    score = new float*[maxAlignLength];
-    for(unsigned int i = 0; i < maxAlignLength; i++) {
-        score[i] = new float[maxAlignLength];
-    }
     reduce_score = new float[maxAlignLength];
     norm = new float[maxQueryLength];
     query_to_align = new int[maxQueryLength];
@@ -52,18 +43,6 @@ LDDTCalculator::~LDDTCalculator() {
         }
         delete[] target_coordinates;
     }
-    if(dists_to_score) {
-        for(unsigned int i = 0; i < maxQueryLength; i++) {
-            delete[] dists_to_score[i];
-        }
-        delete[] dists_to_score;
-    }
-    if(score) {
-        for(unsigned int i = 0; i < maxAlignLength; i++) {
-            delete[] score[i];
-        }
-        delete[] score;
-    }
     if(reduce_score) {
         delete[] reduce_score;
     }
@@ -91,30 +70,24 @@ void LDDTCalculator::initQuery(unsigned int queryLen, float *qx, float *qy, floa
         query_coordinates[i][1] = qy[i];
         query_coordinates[i][2] = qz[i];
     }
-    // Initialize arrays
-    for(unsigned int i = 0; i < queryLength; i++) {
-        memset(dists_to_score[i], 0, sizeof(bool) * queryLength);
-    }
-
-    query_grid = Grid(query_coordinates, queryLength);
-    memset(norm, 0, sizeof(float) * queryLength);
 
+    // query residues within CUTOFF of each other are the pairs that are scored
+    neighbor_start.resize(queryLength + 1);
+    neighbor_idx.clear();
+    neighbor_dist.clear();
     for(unsigned int col = 0; col < queryLength; col++) {
+        neighbor_start[col] = neighbor_idx.size();
         for (unsigned int row = 0; row < queryLength; row++) {
-            float distance = dist(query_coordinates[row], query_coordinates[col]);
-            bool isClose = (col != row) && (distance < CUTOFF);
-            dists_to_score[col][row] = isClose;
-            dists_to_score[row][col] = isClose;
-            norm[col] += dists_to_score[row][col];
-        }
-
-        if(norm[col] != 0) {
-            norm[col] = 1 / norm[col];
-        } else {
-            norm[col] = INF;
+            float distance = dist(query_coordinates[col], query_coordinates[row]);
+            if (col != row && distance < CUTOFF) {
+                neighbor_idx.push_back(row);
+                neighbor_dist.push_back(distance);
+            }
         }
+        unsigned int neighbors = neighbor_idx.size() - neighbor_start[col];
+        norm[col] = (neighbors != 0) ? 1 / (float) neighbors : INF;
     }
-
+    neighbor_start[queryLength] = neighbor_idx.size();
 }
 
 LDDTCalculator::LDDTScoreResult LDDTCalculator::computeLDDTScore(unsigned int targetLen, int qStartPos, int tStartPos, const std::string &backtrace,
@@ -128,7 +101,25 @@ LDDTCalculator::LDDTScoreResult LDDTCalculator::computeLDDTScore(unsigned int ta
     }
 
     constructAlignHashes(qStartPos, tStartPos, backtrace);
-    calculateLddtScores();
+    // without a threshold the bounded computation never stops early
+    calculateBoundedLddtScores(-INF);
+    return LDDTScoreResult(reduce_score, alignLength);
+}
+
+LDDTCalculator::LDDTScoreResult LDDTCalculator::computeBoundedLDDTScore(unsigned int targetLen, int qStartPos, int tStartPos, const std::string &backtrace,
+                                                                        float *tx, float *ty, float *tz, float threshold) {
+    targetLength = targetLen;
+
+    for(unsigned int i = 0; i < targetLength; i++) {
+        target_coordinates[i][0] = tx[i];
+        target_coordinates[i][1] = ty[i];
+        target_coordinates[i][2] = tz[i];
+    }
+
+    constructAlignHashes(qStartPos, tStartPos, backtrace);
+    if (calculateBoundedLddtScores(threshold) == false) {
+        return LDDTScoreResult(upperBound);
+    }
     return LDDTScoreResult(reduce_score, alignLength);
 }
 
@@ -154,66 +145,38 @@ void LDDTCalculator::constructAlignHashes(int query_idx, int target_idx, const s
     alignLength = align_idx;
 }
 
-void LDDTCalculator::calculateLddtScores() {
-    const int DIR = 14;
-    int dx[DIR] = {0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0};
-    int dy[DIR] = {0, 1, 1, 1, 0, 0, 0, -1, -1, -1, 1, 1, 1, 0};
-    int dz[DIR] = {0, 1, 0, -1, 1, 0, -1, 1, 0, -1, 1, 0, -1, 1};
+// Residues are finalized in alignment order using the neighbor lists of initQuery. A pair is scored once,
+// when its first residue is processed, and added to both residues, so a residue is final once it was processed.
+// After each block the unprocessed residues are assumed to score perfectly, if even then the average stays
+// below the threshold the computation stops. Per residue sums are multiples of 0.25 and therefore exact in any order.
+bool LDDTCalculator::calculateBoundedLddtScores(float threshold) {
+    const int BLOCK_SIZE = 32;
     memset(reduce_score, 0, sizeof(float) * alignLength);
-    std::map<std::tuple<int, int, int>, bool> visited_boxes;
-    // Create a set of unique boxes containing aligned residues
-    for (unsigned int align_idx = 0; align_idx < alignLength; align_idx++) {
-        if (align_to_query[align_idx] != -1) {
-            std::tuple<int, int, int> box_coord = query_grid.getGridCoordinates(query_coordinates[align_to_query[align_idx]]);
-            // If box_coord has been visited already, skip
-            if (visited_boxes.find(box_coord) != visited_boxes.end()) {
+    float finalSum = 0.0;
+    for (unsigned int align_idx1 = 0; align_idx1 < alignLength; align_idx1++) {
+        int query_idx1 = align_to_query[align_idx1];
+        float *target1 = target_coordinates[align_to_target[align_idx1]];
+        for (unsigned int k = neighbor_start[query_idx1]; k < neighbor_start[query_idx1 + 1]; k++) {
+            int align_idx2 = query_to_align[neighbor_idx[k]];
+            // unaligned or already processed
+            if (align_idx2 <= (int) align_idx1) {
                 continue;
             }
-            visited_boxes[box_coord] = true;
-            std::pair<std::tuple<int, int, int>, int> ref;
-            ref.first = box_coord;
-            ref.second = 0;
-
-            std::pair<size_t, size_t> box_members = query_grid.getBoxMemberRange(box_coord);
-
-            for (size_t i = box_members.first; i < box_members.second; i++) {
-                int query_idx1 = query_grid.box[i].second;
-                int align_idx1 = query_to_align[query_idx1];
-                if (align_idx1 == -1) {
-                    continue;
-                }
-
-                // Different boxes
-                for (int dir = 0; dir < DIR; dir++) {
-                    std::pair<std::tuple<int, int, int>, int> ref;
-                    std::tuple<int, int, int> key = std::make_tuple(std::get<0>(box_coord) + dx[dir],
-                                    std::get<1>(box_coord) + dy[dir],
-                                    std::get<2>(box_coord) + dz[dir]);
-                    std::pair<size_t, size_t> boxPrime_members = query_grid.getBoxMemberRange(key);
-
-                    size_t i2 = (dir == 0) ? i + 1 : boxPrime_members.first;
-                    for (; i2 < boxPrime_members.second; i2++) {
-                        int query_idx2 = query_grid.box[i2].second;;
-                        int align_idx2 = query_to_align[query_idx2];
-                        if (align_idx2 == -1) {
-                            continue;
-                        }
-                        if (dists_to_score[query_idx1][query_idx2]) {
-                            float distance = dist(query_coordinates[query_idx1], query_coordinates[query_idx2]);
-                            float dist_sub = dist(target_coordinates[align_to_target[align_idx1]],
-                                                  target_coordinates[align_to_target[align_idx2]]);
-                            float d_l = std::abs(distance - dist_sub);
-                            float score = 0.25 * ((d_l < 0.5) + (d_l < 1.0) + (d_l < 2.0) + (d_l < 4.0));
-                            reduce_score[align_idx2] += score;
-                            reduce_score[align_idx1] += score;
-                        }
-                    }
-                }
+            float dist_sub = dist(target1, target_coordinates[align_to_target[align_idx2]]);
+            float d_l = std::abs(neighbor_dist[k] - dist_sub);
+            float score = 0.25 * ((d_l < 0.5) + (d_l < 1.0) + (d_l < 2.0) + (d_l < 4.0));
+            reduce_score[align_idx2] += score;
+            reduce_score[align_idx1] += score;
+        }
+        reduce_score[align_idx1] *= norm[query_idx1];
+        finalSum += reduce_score[align_idx1];
+        unsigned int processed = align_idx1 + 1;
+        if (processed % BLOCK_SIZE == 0 && processed < alignLength) {
+            upperBound = (finalSum + (float) (alignLength - processed)) / (float) alignLength;
+            if (upperBound < threshold) {
+                return false;
             }
         }
     }
-
-    for(unsigned int idx = 0; idx < alignLength; idx++) {
-        reduce_score[idx] *= norm[align_to_query[idx]]; // reduce_score[] contains the lddt scores per residue
-    }
+    return true;
 }
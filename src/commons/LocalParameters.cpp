@@ -5,6 +5,7 @@
 
 const int LocalParameters::DBTYPE_CA_ALPHA = 101;
 const int LocalParameters::DBTYPE_TMSCORE = 102;
+const int LocalParameters::DBTYPE_FEATURES = 103;
 
 LocalParameters::LocalParameters() :
         Parameters(),
@@ -23,6 +24,7 @@ LocalParameters::LocalParameters() :
         PARAM_COORD_STORE_MODE(PARAM_COORD_STORE_MODE_ID, "--coord-store-mode", "Coord store mode", "Coordinate storage mode: \n1: C-alpha as float\n2: C-alpha as difference (uint16_t)", typeid(int), (void *) &coordStoreMode, "^[1-2]{1}$",MMseqsParameter::COMMAND_EXPERT),
         PARAM_MIN_ASSIGNED_CHAINS_THRESHOLD(PARAM_MIN_ASSIGNED_CHAINS_THRESHOLD_ID, "--min-assigned-chains-ratio", "Minimum assigned chains percentage Threshold", "minimum percentage of assigned chains out of all query chains > thr [0,100] %", typeid(float), (void *) & minAssignedChainsThreshold, "^[0-9]*(\\.[0-9]+)?$"),
         PARAM_CLUSTER_SEARCH(PARAM_CLUSTER_SEARCH_ID, "--cluster-search", "Cluster search", "first find representative then align all cluster members", typeid(int), (void *) &clusterSearch, "^[0-1]{1}$",MMseqsParameter::COMMAND_MISC),
+        PARAM_CLUSTER_SEARCH_EVAL_RELAX(PARAM_CLUSTER_SEARCH_EVAL_RELAX_ID, "--cluster-search-eval-relax", "Cluster search E-value relaxation", "E-value threshold factor per level above the leaves of a multi-level cluster search DB (range 1.0-inf)", typeid(double), (void *) &clusterSearchEvalRelax, "^[0-9]*(\\.[0-9]+)?$", MMseqsParameter::COMMAND_MISC | MMseqsParameter::COMMAND_EXPERT),
         PARAM_FILE_INCLUDE(PARAM_FILE_INCLUDE_ID, "--file-include", "File Inclusion Regex", "Include file names based on this regex", typeid(std::string), (void *) &fileInclude, "^.*$"),
         PARAM_FILE_EXCLUDE(PARAM_FILE_EXCLUDE_ID, "--file-exclude", "File Exclusion Regex", "Exclude file names based on this regex", typeid(std::string), (void *) &fileExclude, "^.*$"),
         PARAM_INDEX_EXCLUDE(PARAM_INDEX_EXCLUDE_ID, "--index-exclude", "Index Exclusion", "Exclude parts of the index:\n0: Full index\n1: Exclude k-mer index (for use with --prefilter-mode 1)\n2: Exclude C-alpha coordinates (for use with --sort-by-structure-bits 0)\nFlags can be combined bit wise", typeid(int), (void *) &indexExclude, "^[0-3]{1}$", MMseqsParameter::COMMAND_EXPERT),
@@ -30,10 +32,19 @@ LocalParameters::LocalParameters() :
         PARAM_MULTIMER_REPORT_MODE_BC_COMPAT(PARAM_MULTIMER_REPORT_MODE_BC_COMPAT_ID, "--complex-report-mode", "", "", typeid(int), (void *) &multimerReportMode, "^[0-1]{1}$", MMseqsParameter::COMMAND_HIDDEN),
         PARAM_EXPAND_MULTIMER_EVALUE(PARAM_EXPAND_MULTIMER_EVALUE_ID, "--expand-multimer-evalue", "Multimer E-value", "E-value threshold for multimer chain expansion (range 0.0-inf)", typeid(double), (void *) &eValueThrExpandMultimer, "^([-+]?[0-9]*\\.?[0-9]+([eE][-+]?[0-9]+)?)|[0-9]*(\\.[0-9]+)?$", MMseqsParameter::COMMAND_ALIGN),
         PARAM_EXPAND_MULTIMER_EVALUE_BC_COMPAT(PARAM_EXPAND_MULTIMER_EVALUE_BC_COMPAT_ID, "--expand-complex-evalue", "", "", typeid(double), (void *) &eValueThrExpandMultimer, "^([-+]?[0-9]*\\.?[0-9]+([eE][-+]?[0-9]+)?)|[0-9]*(\\.[0-9]+)?$", MMseqsParameter::COMMAND_HIDDEN),
-        PARAM_INPUT_FORMAT(PARAM_INPUT_FORMAT_ID, "--input-format", "Input format", "Format of input structures:\n0: Auto-detect by extension\n1: PDB\n2: mmCIF\n3: mmJSON\n4: ChemComp\n5: Foldcomp", typeid(int), (void *) &inputFormat, "^[0-5]{1}$"),
+        PARAM_INPUT_FORMAT(PARAM_INPUT_FORMAT_ID, "--input-format", "Input format", "Format of input structures:\n0: Auto-detect by extension\n1: PDB\n2: mmCIF\n3: mmJSON\n4: ChemComp\n5: Foldcomp\n6: BinaryCIF", typeid(int), (void *) &inputFormat, "^[0-6]{1}$"),
         PARAM_PDB_OUTPUT_MODE(PARAM_PDB_OUTPUT_MODE_ID, "--pdb-output-mode", "PDB output mode", "PDB output mode:\n0: Single multi-model PDB file\n1: One PDB file per chain\n2: One PDB file per complex", typeid(int), (void *) &pdbOutputMode, "^[0-2]{1}$", MMseqsParameter::COMMAND_MISC),
         PARAM_PROSTT5_MODEL(PARAM_PROSTT5_MODEL_ID, "--prostt5-model", "Path to ProstT5", "Path to ProstT5 model", typeid(std::string), (void *) &prostt5Model, "^.*$", MMseqsParameter::COMMAND_COMMON),
-        PARAM_GPU(PARAM_GPU_ID, "--gpu", "Use GPU", "Use GPU (CUDA) if possible", typeid(int), (void *) &gpu, "^[0-1]{1}$", MMseqsParameter::COMMAND_COMMON)
+        PARAM_GPU(PARAM_GPU_ID, "--gpu", "Use GPU", "Use GPU (CUDA) if possible", typeid(int), (void *) &gpu, "^[0-1]{1}$", MMseqsParameter::COMMAND_COMMON),
+        PARAM_AUTO_TUNE(PARAM_AUTO_TUNE_ID, "--auto-tune", "Auto tune", "Pick the k-mer or ungapped prefilter by estimated runtime, overrides --prefilter-mode\n(fixed stage costs scaled by a benchmark cached per host in ~/.cache/foldseek)", typeid(int), (void *) &autoTune, "^[0-1]{1}$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_WRITE_FEATURES(PARAM_WRITE_FEATURES_ID, "--write-features", "Write alignment features", "Write _feat DB with precomputed numeric residues and C-alpha coordinates for faster alignment", typeid(int), (void *) &writeFeatures, "^[0-1]{1}$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PACK_RESIDUES(PARAM_PACK_RESIDUES_ID, "--pack-residues", "Pack residues", "Store amino acid and 3Di residues of the _feat DB in 10 bits per residue\nand keep the 16 bit C-alpha encoding of the _ca DB", typeid(int), (void *) &packResidues, "^[0-1]{1}$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_SKETCH_PREFILTER(PARAM_SKETCH_PREFILTER_ID, "--sketch-prefilter", "Sketch prefilter", "Find linclust candidates with MinHash sketches (sketchmatcher) instead of kmermatcher", typeid(int), (void *) &sketchPrefilter, "^[0-1]{1}$", MMseqsParameter::COMMAND_CLUSTLINEAR | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_SKETCH_SIZE(PARAM_SKETCH_SIZE_ID, "--sketch-size", "Sketch size", "Number of MinHash values per entry, multiple of --sketch-bands", typeid(int), (void *) &sketchSize, "^[1-9]{1}[0-9]*$", MMseqsParameter::COMMAND_CLUSTLINEAR | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_SKETCH_BANDS(PARAM_SKETCH_BANDS_ID, "--sketch-bands", "Sketch bands", "Number of LSH bands, more bands with fewer rows each increase recall", typeid(int), (void *) &sketchBands, "^[1-9]{1}[0-9]*$", MMseqsParameter::COMMAND_CLUSTLINEAR | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_SKETCH_KMER_SIZE(PARAM_SKETCH_KMER_SIZE_ID, "--sketch-kmer-size", "Sketch k-mer size", "Length of the combined 3Di+AA k-mers that are sketched", typeid(int), (void *) &sketchKmerSize, "^[1-9]{1}[0-9]*$", MMseqsParameter::COMMAND_CLUSTLINEAR | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_SKETCH_DB(PARAM_SKETCH_DB_ID, "--sketch-db", "Sketch DB", "Read sketches of unchanged entries from and write all sketches to this DB", typeid(std::string), (void *) &sketchDb, "^.*$", MMseqsParameter::COMMAND_CLUSTLINEAR | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_RESULT_CACHE(PARAM_RESULT_CACHE_ID, "--result-cache", "Result cache", "Directory of a result cache: queries with identical amino acid, 3Di and C-alpha data\nare answered from the cache, the other queries are searched and added to it", typeid(std::string), (void *) &resultCache, "^.*$", MMseqsParameter::COMMAND_MISC | MMseqsParameter::COMMAND_EXPERT)
 {
     PARAM_ALIGNMENT_MODE.description = "How to compute the alignment:\n0: automatic\n1: only score and end_pos\n2: also start_pos and cov\n3: also seq.id";
     PARAM_ALIGNMENT_MODE.regex = "^[0-3]{1}$";
@@ -87,6 +98,8 @@ LocalParameters::LocalParameters() :
     structurecreatedb.push_back(&PARAM_COORD_STORE_MODE);
     structurecreatedb.push_back(&PARAM_WRITE_LOOKUP);
     structurecreatedb.push_back(&PARAM_INPUT_FORMAT);
+    structurecreatedb.push_back(&PARAM_WRITE_FEATURES);
+    structurecreatedb.push_back(&PARAM_PACK_RESIDUES);
     // protein chain only
     structurecreatedb.push_back(&PARAM_FILE_INCLUDE);
     structurecreatedb.push_back(&PARAM_FILE_EXCLUDE);
@@ -116,6 +129,7 @@ LocalParameters::LocalParameters() :
     structurerescorediagonal.push_back(&PARAM_TMSCORE_THRESHOLD);
     structurerescorediagonal.push_back(&PARAM_LDDT_THRESHOLD);
     structurerescorediagonal.push_back(&PARAM_ALIGNMENT_TYPE);
+    structurerescorediagonal.push_back(&PARAM_CHECKPOINT_INTERVAL);
     structurerescorediagonal = combineList(structurerescorediagonal, align);
 
     structurealign.push_back(&PARAM_TMSCORE_THRESHOLD);
@@ -123,7 +137,22 @@ LocalParameters::LocalParameters() :
     structurealign.push_back(&PARAM_SORT_BY_STRUCTURE_BITS);
     structurealign.push_back(&PARAM_ALIGNMENT_TYPE);
     structurealign.push_back(&PARAM_EXACT_TMSCORE);
+    structurealign.push_back(&PARAM_CHECKPOINT_INTERVAL);
     structurealign = combineList(structurealign, align);
+
+    // precomputefeatures
+    precomputefeatures.push_back(&PARAM_PACK_RESIDUES);
+    precomputefeatures.push_back(&PARAM_THREADS);
+    precomputefeatures.push_back(&PARAM_V);
+
+    // sketchmatcher
+    sketchmatcher.push_back(&PARAM_SKETCH_SIZE);
+    sketchmatcher.push_back(&PARAM_SKETCH_BANDS);
+    sketchmatcher.push_back(&PARAM_SKETCH_KMER_SIZE);
+    sketchmatcher.push_back(&PARAM_SKETCH_DB);
+    sketchmatcher.push_back(&PARAM_COMPRESSED);
+    sketchmatcher.push_back(&PARAM_THREADS);
+    sketchmatcher.push_back(&PARAM_V);
 //    tmalign.push_back(&PARAM_GAP_OPEN);
 //    tmalign.push_back(&PARAM_GAP_EXTEND);
     // strucclust
@@ -142,6 +171,9 @@ LocalParameters::LocalParameters() :
     structuresearchworkflow.push_back(&PARAM_RUNNER);
     structuresearchworkflow.push_back(&PARAM_REUSELATEST);
     structuresearchworkflow.push_back(&PARAM_CLUSTER_SEARCH);
+    structuresearchworkflow.push_back(&PARAM_CLUSTER_SEARCH_EVAL_RELAX);
+    structuresearchworkflow.push_back(&PARAM_AUTO_TUNE);
+    structuresearchworkflow.push_back(&PARAM_RESULT_CACHE);
 
     easystructuresearchworkflow = combineList(structuresearchworkflow, structurecreatedb);
     easystructuresearchworkflow = combineList(easystructuresearchworkflow, convertalignments);
@@ -154,6 +186,8 @@ LocalParameters::LocalParameters() :
     structureclusterworkflow.push_back(&PARAM_CASCADED);
     structureclusterworkflow.push_back(&PARAM_CLUSTER_STEPS);
     structureclusterworkflow.push_back(&PARAM_CLUSTER_REASSIGN);
+    structureclusterworkflow.push_back(&PARAM_SKETCH_PREFILTER);
+    structureclusterworkflow = combineList(structureclusterworkflow, sketchmatcher);
     structureclusterworkflow.push_back(&PARAM_REMOVE_TMP_FILES);
     structureclusterworkflow.push_back(&PARAM_REUSELATEST);
     structureclusterworkflow.push_back(&PARAM_RUNNER);
@@ -232,6 +266,7 @@ LocalParameters::LocalParameters() :
     maskLowerCaseMode = 1;
     coordStoreMode = COORD_STORE_MODE_CA_DIFF;
     clusterSearch = 0;
+    clusterSearchEvalRelax = 10.0;
     inputFormat = 0; // auto detect
     fileInclude = ".*";
     fileExclude = "^$";
@@ -241,6 +276,15 @@ LocalParameters::LocalParameters() :
     eValueThrExpandMultimer = 10000.0;
     prostt5Model = "";
     gpu = 0;
+    autoTune = 0;
+    writeFeatures = 0;
+    packResidues = 0;
+    sketchPrefilter = 0;
+    sketchSize = 32;
+    sketchBands = 8;
+    sketchKmerSize = 6;
+    sketchDb = "";
+    resultCache = "";
 
     citations.emplace(CITATION_FOLDSEEK, "van Kempen, M., Kim, S.S., Tumescheit, C., Mirdita, M., Lee, J., Gilchrist, C.L.M., Söding, J., and Steinegger, M. Fast and accurate protein structure search with Foldseek. Nature Biotechnology, doi:10.1038/s41587-023-01773-0 (2023)");
     citations.emplace(CITATION_FOLDSEEK_MULTIMER, "Kim, W., Mirdita, M., Levy Karin, E., Gilchrist, C.L.M., Schweke, H., Söding, J., Levy, E., and Steinegger, M. Rapid and Sensitive Protein Complex Alignment with Foldseek-Multimer. bioRxiv, doi:10.1101/2024.04.14.589414 (2024)");
@@ -328,5 +372,6 @@ std::vector<int> LocalParameters::getOutputFormat(int formatMode, const std::str
 
 std::vector<int> FoldSeekDbValidator::tmscore = {LocalParameters::DBTYPE_TMSCORE};
 std::vector<int> FoldSeekDbValidator::cadb = {LocalParameters::DBTYPE_CA_ALPHA};
+std::vector<int> FoldSeekDbValidator::featuredb = {LocalParameters::DBTYPE_FEATURES};
 std::vector<int> FoldSeekDbValidator::flatfileStdinAndFolder = {LocalParameters::DBTYPE_FLATFILE, LocalParameters::DBTYPE_STDIN,LocalParameters::DBTYPE_DIRECTORY};
 std::vector<int> FoldSeekDbValidator::flatfileAndFolder = {LocalParameters::DBTYPE_FLATFILE, LocalParameters::DBTYPE_DIRECTORY};
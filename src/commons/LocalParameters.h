@@ -10,6 +10,7 @@ const int CITATION_PROSTT5 = CITATION_FOLDSEEK << 2;
 struct FoldSeekDbValidator : public DbValidator {
     static std::vector<int> tmscore;
     static std::vector<int> cadb;
+    static std::vector<int> featuredb;
     static std::vector<int> flatfileStdinAndFolder;
     static std::vector<int> flatfileAndFolder;
 
@@ -27,6 +28,7 @@ public:
 
     static const int DBTYPE_CA_ALPHA;
     static const int DBTYPE_TMSCORE;
+    static const int DBTYPE_FEATURES;
 
     static const int ALIGNMENT_TYPE_3DI = 0;
     static const int ALIGNMENT_TYPE_TMALIGN = 1;
@@ -101,6 +103,8 @@ public:
     std::vector<MMseqsParameter *> createmultimerreport;
     std::vector<MMseqsParameter *> expandmultimer;
     std::vector<MMseqsParameter *> convert2pdb;
+    std::vector<MMseqsParameter *> sketchmatcher;
+    std::vector<MMseqsParameter *> precomputefeatures;
 
     PARAMETER(PARAM_PREF_MODE)
     PARAMETER(PARAM_TMSCORE_THRESHOLD)
@@ -117,6 +121,7 @@ public:
     PARAMETER(PARAM_COORD_STORE_MODE)
     PARAMETER(PARAM_MIN_ASSIGNED_CHAINS_THRESHOLD)
     PARAMETER(PARAM_CLUSTER_SEARCH)
+    PARAMETER(PARAM_CLUSTER_SEARCH_EVAL_RELAX)
     PARAMETER(PARAM_FILE_INCLUDE)
     PARAMETER(PARAM_FILE_EXCLUDE)
     PARAMETER(PARAM_INDEX_EXCLUDE)
@@ -128,6 +133,15 @@ public:
     PARAMETER(PARAM_PDB_OUTPUT_MODE)
     PARAMETER(PARAM_PROSTT5_MODEL)
     PARAMETER(PARAM_GPU)
+    PARAMETER(PARAM_AUTO_TUNE)
+    PARAMETER(PARAM_WRITE_FEATURES)
+    PARAMETER(PARAM_PACK_RESIDUES)
+    PARAMETER(PARAM_SKETCH_PREFILTER)
+    PARAMETER(PARAM_SKETCH_SIZE)
+    PARAMETER(PARAM_SKETCH_BANDS)
+    PARAMETER(PARAM_SKETCH_KMER_SIZE)
+    PARAMETER(PARAM_SKETCH_DB)
+    PARAMETER(PARAM_RESULT_CACHE)
 
     int prefMode;
     float tmScoreThr;
@@ -144,6 +158,7 @@ public:
     int coordStoreMode;
     float minAssignedChainsThreshold;
     int clusterSearch;
+    double clusterSearchEvalRelax;
     std::string fileInclude;
     std::string fileExclude;
     int indexExclude;
@@ -153,6 +168,15 @@ public:
     int pdbOutputMode;
     std::string prostt5Model;
     int gpu;
+    int autoTune;
+    int writeFeatures;
+    int packResidues;
+    int sketchPrefilter;
+    int sketchSize;
+    int sketchBands;
+    int sketchKmerSize;
+    std::string sketchDb;
+    std::string resultCache;
 
     static std::vector<int> getOutputFormat(int formatMode, const std::string &outformat, bool &needSequences, bool &needBacktrace, bool &needFullHeaders,
                                             bool &needLookup, bool &needSource, bool &needTaxonomyMapping, bool &needTaxonomy, bool &needQCa, bool &needTCa, bool &needTMaligner,
@@ -0,0 +1,270 @@
+#include "StructureLookup.h"
+#include "MemoryMapped.h"
+#include "FileUtil.h"
+#include "Debug.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <numeric>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct SortEntryByKey {
+    SortEntryByKey(const unsigned int *keys) : keys(keys) {}
+    bool operator() (unsigned int i, unsigned int j) const {
+        return keys[i] < keys[j];
+    }
+    const unsigned int *keys;
+};
+
+// size and modification time identify the state of a text file, SIZE_MAX and 0 if it does not exist
+static void textFileState(const std::string &file, size_t &size, size_t &mtime) {
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) {
+        size = SIZE_MAX;
+        mtime = 0;
+        return;
+    }
+    size = static_cast<size_t>(st.st_size);
+    mtime = static_cast<size_t>(st.st_mtime);
+}
+
+static bool textFileMatches(const std::string &file, size_t size, size_t mtime) {
+    size_t currentSize, currentMtime;
+    textFileState(file, currentSize, currentMtime);
+    return currentSize == size && currentMtime == mtime;
+}
+
+StructureLookup::StructureLookup(const std::string &db, bool needSource)
+        : entryCount(0), sourceCount(0), keys(NULL), sets(NULL), keyOrder(NULL), nameOffsets(NULL), namePool(NULL),
+          sourceSets(NULL), sourceOffsets(NULL), sourcePool(NULL), mmapData(NULL), mmapSize(0) {
+    if (readBinary(db, needSource) == false) {
+        readText(db, needSource);
+    }
+}
+
+StructureLookup::~StructureLookup() {
+    if (mmapData != NULL) {
+        munmap(mmapData, mmapSize);
+    }
+}
+
+size_t StructureLookup::getId(unsigned int key) const {
+    const unsigned int *it = std::lower_bound(keyOrder, keyOrder + entryCount, key,
+                                              [this](unsigned int id, unsigned int value) { return keys[id] < value; });
+    if (it == keyOrder + entryCount || keys[*it] != key) {
+        return SIZE_MAX;
+    }
+    return *it;
+}
+
+unsigned int StructureLookup::keyToSet(unsigned int key) const {
+    size_t id = getId(key);
+    return (id == SIZE_MAX) ? UINT_MAX : sets[id];
+}
+
+const char* StructureLookup::setToSource(unsigned int set) const {
+    const unsigned int *it = std::lower_bound(sourceSets, sourceSets + sourceCount, set);
+    if (it == sourceSets + sourceCount || *it != set) {
+        return "";
+    }
+    return sourcePool + sourceOffsets[it - sourceSets];
+}
+
+void StructureLookup::getSetRuns(std::vector<size_t> &starts) const {
+    starts.clear();
+    for (size_t i = 0; i < entryCount; i++) {
+        if (i == 0 || sets[i] != sets[i - 1]) {
+            starts.emplace_back(i);
+        }
+    }
+    starts.emplace_back(entryCount);
+}
+
+void StructureLookup::readText(const std::string &db, bool needSource) {
+    std::string lookupFile = db + ".lookup";
+    if (FileUtil::fileExists(lookupFile.c_str()) == false) {
+        Debug(Debug::ERROR) << "Lookup file " << lookupFile << " does not exist\n";
+        EXIT(EXIT_FAILURE);
+    }
+    MemoryMapped lookup(lookupFile, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
+    char *data = (char *) lookup.getData();
+    char *end = data + lookup.mappedSize();
+    while (data < end && *data != '\0') {
+        char *lineEnd = std::find(data, end, '\n');
+        char *nameStart = std::find(data, lineEnd, '\t');
+        char *nameEnd = (nameStart == lineEnd) ? lineEnd : std::find(nameStart + 1, lineEnd, '\t');
+        if (nameEnd == lineEnd) {
+            Debug(Debug::WARNING) << "Not enough columns in lookup file " << lookupFile << "\n";
+        } else {
+            keysData.emplace_back(Util::fast_atoi<unsigned int>(data));
+            setsData.emplace_back(Util::fast_atoi<unsigned int>(nameEnd + 1));
+            nameOffsetsData.emplace_back(namePoolData.size());
+            namePoolData.append(nameStart + 1, nameEnd - nameStart - 1);
+            namePoolData.push_back('\0');
+        }
+        data = (lineEnd == end) ? end : lineEnd + 1;
+    }
+    lookup.close();
+    entryCount = keysData.size();
+    keyOrderData.resize(entryCount);
+    std::iota(keyOrderData.begin(), keyOrderData.end(), 0);
+    std::stable_sort(keyOrderData.begin(), keyOrderData.end(), SortEntryByKey(keysData.data()));
+
+    std::string sourceFile = db + ".source";
+    if (needSource && FileUtil::fileExists(sourceFile.c_str())) {
+        std::vector<std::pair<unsigned int, std::string>> sources;
+        MemoryMapped source(sourceFile, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
+        data = (char *) source.getData();
+        end = data + source.mappedSize();
+        while (data < end && *data != '\0') {
+            char *lineEnd = std::find(data, end, '\n');
+            char *nameStart = std::find(data, lineEnd, '\t');
+            if (nameStart == lineEnd) {
+                Debug(Debug::WARNING) << "Not enough columns in source file " << sourceFile << "\n";
+            } else {
+                sources.emplace_back(Util::fast_atoi<unsigned int>(data), std::string(nameStart + 1, lineEnd - nameStart - 1));
+            }
+            data = (lineEnd == end) ? end : lineEnd + 1;
+        }
+        source.close();
+        std::stable_sort(sources.begin(), sources.end(),
+                         [](const std::pair<unsigned int, std::string> &a, const std::pair<unsigned int, std::string> &b) { return a.first < b.first; });
+        for (size_t i = 0; i < sources.size(); i++) {
+            sourceSetsData.emplace_back(sources[i].first);
+            sourceOffsetsData.emplace_back(sourcePoolData.size());
+            sourcePoolData.append(sources[i].second);
+            sourcePoolData.push_back('\0');
+        }
+    }
+    sourceCount = sourceSetsData.size();
+
+    keys = keysData.data();
+    sets = setsData.data();
+    keyOrder = keyOrderData.data();
+    nameOffsets = nameOffsetsData.data();
+    namePool = namePoolData.c_str();
+    sourceSets = sourceSetsData.data();
+    sourceOffsets = sourceOffsetsData.data();
+    sourcePool = sourcePoolData.c_str();
+}
+
+// layout: version, lookup and source text file sizes and modification times, entryCount, sourceCount,
+// name and source pool sizes, nameOffsets, sourceOffsets, keys, sets, keyOrder, sourceSets, namePool, sourcePool
+bool StructureLookup::readBinary(const std::string &db, bool needSource) {
+    std::string binFile = binaryFile(db);
+    if (FileUtil::fileExists(binFile.c_str()) == false) {
+        return false;
+    }
+    FILE *handle = fopen(binFile.c_str(), "r");
+    if (handle == NULL) {
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fileno(handle), &sb) < 0) {
+        Debug(Debug::ERROR) << "Failed to fstat file " << binFile << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    const size_t headerSize = 9 * sizeof(size_t);
+    if ((size_t) sb.st_size < headerSize) {
+        fclose(handle);
+        return false;
+    }
+    char *data = (char *) mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fileno(handle), 0);
+    if (data == MAP_FAILED) {
+        Debug(Debug::ERROR) << "Failed to mmap file " << binFile << " with error " << errno << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    fclose(handle);
+
+    const size_t *header = (const size_t *) data;
+    const size_t version = header[0];
+    bool valid = version == SERIALIZATION_VERSION;
+    if (valid) {
+        const size_t expectedSize = headerSize
+                                    + (header[5] + header[6]) * sizeof(size_t)
+                                    + (3 * header[5] + header[6]) * sizeof(unsigned int)
+                                    + header[7] + header[8];
+        // the text files were rewritten after createdb (e.g. renamedbkeys), they win
+        valid = expectedSize == (size_t) sb.st_size
+                && textFileMatches(db + ".lookup", header[1], header[2])
+                && (needSource == false || textFileMatches(db + ".source", header[3], header[4]));
+    }
+    if (valid == false) {
+        if (version != SERIALIZATION_VERSION) {
+            Debug(Debug::WARNING) << "Outdated lookup file " << binFile << ", reading text lookup instead\n";
+        }
+        munmap(data, sb.st_size);
+        return false;
+    }
+
+    entryCount = header[5];
+    sourceCount = header[6];
+    const char *p = data + headerSize;
+    nameOffsets = (const size_t *) p;
+    p += entryCount * sizeof(size_t);
+    sourceOffsets = (const size_t *) p;
+    p += sourceCount * sizeof(size_t);
+    keys = (const unsigned int *) p;
+    p += entryCount * sizeof(unsigned int);
+    sets = (const unsigned int *) p;
+    p += entryCount * sizeof(unsigned int);
+    keyOrder = (const unsigned int *) p;
+    p += entryCount * sizeof(unsigned int);
+    sourceSets = (const unsigned int *) p;
+    p += sourceCount * sizeof(unsigned int);
+    namePool = p;
+    p += header[7];
+    sourcePool = p;
+
+    mmapData = data;
+    mmapSize = sb.st_size;
+    return true;
+}
+
+void StructureLookup::writeBinary(const std::string &db) {
+    StructureLookup lookup;
+    lookup.readText(db, true);
+
+    std::string binFile = binaryFile(db);
+    FILE *handle = FileUtil::openAndDelete(binFile.c_str(), "w");
+    size_t header[9] = {
+            SERIALIZATION_VERSION,
+            0, 0, 0, 0,
+            lookup.entryCount,
+            lookup.sourceCount,
+            lookup.namePoolData.size(),
+            lookup.sourcePoolData.size()
+    };
+    textFileState(db + ".lookup", header[1], header[2]);
+    textFileState(db + ".source", header[3], header[4]);
+    struct Block {
+        const void *data;
+        size_t size;
+    };
+    const Block blocks[] = {
+            { header, sizeof(header) },
+            { lookup.nameOffsets, lookup.entryCount * sizeof(size_t) },
+            { lookup.sourceOffsets, lookup.sourceCount * sizeof(size_t) },
+            { lookup.keys, lookup.entryCount * sizeof(unsigned int) },
+            { lookup.sets, lookup.entryCount * sizeof(unsigned int) },
+            { lookup.keyOrder, lookup.entryCount * sizeof(unsigned int) },
+            { lookup.sourceSets, lookup.sourceCount * sizeof(unsigned int) },
+            { lookup.namePool, lookup.namePoolData.size() },
+            { lookup.sourcePool, lookup.sourcePoolData.size() }
+    };
+    for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+        if (blocks[i].size > 0 && fwrite(blocks[i].data, 1, blocks[i].size, handle) != blocks[i].size) {
+            Debug(Debug::ERROR) << "Cannot write to lookup file " << binFile << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+    if (fclose(handle) != 0) {
+        Debug(Debug::ERROR) << "Cannot close lookup file " << binFile << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef FOLDSEEK_STRUCTURELOOKUP_H
+#define FOLDSEEK_STRUCTURELOOKUP_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Entry name and set (file number or complex id) per key from <db>.lookup and the
+// source file name per set from <db>.source.
+// createdb also writes both as flat arrays with a string pool to <db>.lookup.bin, which
+// is mmapped instead of parsing the text files. The text files are the fallback if the
+// binary file is missing or their size or modification time changed since it was written.
+class StructureLookup {
+public:
+    StructureLookup(const std::string &db, bool needSource);
+    ~StructureLookup();
+
+    static std::string binaryFile(const std::string &db) {
+        return db + ".lookup.bin";
+    }
+    static void writeBinary(const std::string &db);
+
+    // entries are kept in the order of the lookup file, chains of a complex are consecutive
+    size_t size() const {
+        return entryCount;
+    }
+    unsigned int getKey(size_t id) const {
+        return keys[id];
+    }
+    unsigned int getSet(size_t id) const {
+        return sets[id];
+    }
+    const unsigned int* getKeys() const {
+        return keys;
+    }
+    const char* getName(size_t id) const {
+        return namePool + nameOffsets[id];
+    }
+
+    // returns SIZE_MAX if the key is not contained
+    size_t getId(unsigned int key) const;
+    // returns UINT_MAX if the key is not contained
+    unsigned int keyToSet(unsigned int key) const;
+    // returns an empty string if the set has no source
+    const char* setToSource(unsigned int set) const;
+
+    // start of each run of consecutive entries sharing a set, followed by size()
+    void getSetRuns(std::vector<size_t> &starts) const;
+
+private:
+    static const size_t SERIALIZATION_VERSION = 2;
+
+    StructureLookup()
+            : entryCount(0), sourceCount(0), keys(NULL), sets(NULL), keyOrder(NULL), nameOffsets(NULL), namePool(NULL),
+              sourceSets(NULL), sourceOffsets(NULL), sourcePool(NULL), mmapData(NULL), mmapSize(0) {}
+
+    void readText(const std::string &db, bool needSource);
+    bool readBinary(const std::string &db, bool needSource);
+
+    size_t entryCount;
+    size_t sourceCount;
+
+    const unsigned int *keys;
+    const unsigned int *sets;
+    // entry ids sorted by key
+    const unsigned int *keyOrder;
+    const size_t *nameOffsets;
+    const char *namePool;
+
+    // sorted by set
+    const unsigned int *sourceSets;
+    const size_t *sourceOffsets;
+    const char *sourcePool;
+
+    char *mmapData;
+    size_t mmapSize;
+
+    // backing storage when read from the text files
+    std::vector<unsigned int> keysData;
+    std::vector<unsigned int> setsData;
+    std::vector<unsigned int> keyOrderData;
+    std::vector<size_t> nameOffsetsData;
+    std::string namePoolData;
+    std::vector<unsigned int> sourceSetsData;
+    std::vector<size_t> sourceOffsetsData;
+    std::string sourcePoolData;
+};
+
+#endif
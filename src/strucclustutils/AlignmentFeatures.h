@@ -0,0 +1,161 @@
+#ifndef FOLDSEEK_ALIGNMENTFEATURES_H
+#define FOLDSEEK_ALIGNMENTFEATURES_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Coordinate16.h"
+
+class LocalParameters;
+
+// Precomputed target-side data for the aligners, stored in the <DB>_feat sidecar.
+// Entry layout:
+//   uint32_t length
+//   uint32_t flags
+//   float    ca[3 * length] (x block, y block, z block; only if HAS_CA)
+//   uint8_t  aa[length]     (numeric amino acid residues)
+//   uint8_t  ss[length]     (numeric 3Di residues)
+// or, if PACKED_RESIDUES is set, instead of aa and ss
+//   uint8_t  packed[getPackedSize(length)]
+// with 10 bits per residue (5 bit amino acid, 5 bit 3Di) in little endian bit order
+// and padding so that the unpack routine can always load 16 bytes.
+// If CA_DIFF16 is set as well, ca holds getDiff16Size(length) bytes in the 16 bit difference
+// encoding of the _ca DB instead of floats.
+// Entries are padded to a multiple of four bytes including the DB terminator, so that
+// float coordinates stay aligned in the data file and can be used without a copy.
+class AlignmentFeatures {
+public:
+    static const uint32_t HAS_CA = 1;
+    static const uint32_t PACKED_RESIDUES = 2;
+    static const uint32_t CA_DIFF16 = 4;
+
+    struct Entry {
+        Entry() : length(0), ca(NULL), caDiff16(false), aa(NULL), ss(NULL), packed(NULL) {}
+
+        unsigned int length;
+        // use readCa, the coordinates might be unaligned or difference encoded
+        const char *ca;
+        bool caDiff16;
+        const unsigned char *aa;
+        const unsigned char *ss;
+        const unsigned char *packed;
+    };
+
+    static size_t getPackedSize(unsigned int length) {
+        return (10 * static_cast<size_t>(length) + 7) / 8 + 6;
+    }
+
+    // a 32 bit start and 16 bit differences per dimension, as written by Coordinate16::convertToDiff16
+    static size_t getDiff16Size(unsigned int length) {
+        return 3 * (static_cast<size_t>(length) + 1) * sizeof(int16_t);
+    }
+
+    static size_t getCaSize(unsigned int length, uint32_t flags) {
+        if ((flags & HAS_CA) == 0) {
+            return 0;
+        }
+        return (flags & CA_DIFF16) ? getDiff16Size(length) : 3 * static_cast<size_t>(length) * sizeof(float);
+    }
+
+    // returns false if the entry is shorter than its header claims
+    static bool parse(const char *data, size_t dataSize, Entry &entry) {
+        if (data == NULL || dataSize < 2 * sizeof(uint32_t)) {
+            return false;
+        }
+        uint32_t length;
+        uint32_t flags;
+        memcpy(&length, data, sizeof(uint32_t));
+        memcpy(&flags, data + sizeof(uint32_t), sizeof(uint32_t));
+        size_t needed = 2 * sizeof(uint32_t);
+        needed += getCaSize(length, flags);
+        needed += (flags & PACKED_RESIDUES) ? getPackedSize(length) : 2 * static_cast<size_t>(length);
+        if (dataSize < needed) {
+            return false;
+        }
+        data += 2 * sizeof(uint32_t);
+        entry.length = length;
+        entry.ca = NULL;
+        entry.caDiff16 = (flags & CA_DIFF16) != 0;
+        if (flags & HAS_CA) {
+            entry.ca = data;
+            data += getCaSize(length, flags);
+        }
+        if (flags & PACKED_RESIDUES) {
+            entry.aa = NULL;
+            entry.ss = NULL;
+            entry.packed = reinterpret_cast<const unsigned char *>(data);
+        } else {
+            entry.aa = reinterpret_cast<const unsigned char *>(data);
+            entry.ss = entry.aa + length;
+            entry.packed = NULL;
+        }
+        return true;
+    }
+
+    // aligned float coordinates are returned in place, others are decoded by coords or copied into buffer,
+    // NULL if the entry has none
+    static float *readCa(const Entry &entry, Coordinate16 &coords, std::vector<float> &buffer) {
+        if (entry.ca == NULL) {
+            return NULL;
+        }
+        if (entry.caDiff16) {
+            return coords.read(entry.ca, entry.length, getDiff16Size(entry.length));
+        }
+        if (reinterpret_cast<uintptr_t>(entry.ca) % sizeof(float) == 0) {
+            return const_cast<float *>(reinterpret_cast<const float *>(entry.ca));
+        }
+        buffer.resize(3 * static_cast<size_t>(entry.length));
+        memcpy(buffer.data(), entry.ca, buffer.size() * sizeof(float));
+        return buffer.data();
+    }
+
+    // ca is either 3 * length floats or, with caDiff16, getDiff16Size(length) bytes of difference encoding
+    static void append(std::vector<char> &out, unsigned int length, const char *ca, bool caDiff16,
+                       const unsigned char *aa, const unsigned char *ss, bool pack) {
+        uint32_t flags = (ca != NULL) ? HAS_CA : 0;
+        flags |= pack ? PACKED_RESIDUES : 0;
+        flags |= (ca != NULL && caDiff16) ? CA_DIFF16 : 0;
+        out.resize(2 * sizeof(uint32_t));
+        memcpy(out.data(), &length, sizeof(uint32_t));
+        memcpy(out.data() + sizeof(uint32_t), &flags, sizeof(uint32_t));
+        if (ca != NULL) {
+            out.insert(out.end(), ca, ca + getCaSize(length, flags));
+        }
+        if (pack) {
+            size_t offset = out.size();
+            out.resize(offset + getPackedSize(length), 0);
+            packResidues(aa, ss, length, reinterpret_cast<unsigned char *>(out.data() + offset));
+        } else {
+            out.insert(out.end(), aa, aa + length);
+            out.insert(out.end(), ss, ss + length);
+        }
+        out.resize(out.size() + (3 - out.size() % 4), 0);
+    }
+
+    // packed has to be zero initialized, residues have to be smaller than 32
+    static void packResidues(const unsigned char *aa, const unsigned char *ss, unsigned int length, unsigned char *packed);
+
+    // writes length numeric residues each into aa and ss
+    static void unpackResidues(const unsigned char *packed, unsigned int length, unsigned char *aa, unsigned char *ss);
+
+    // <DB>_feat for a DB name or a DB.idx name
+    static std::string getFeatureDbName(std::string db) {
+        if (db.size() > 4 && db.compare(db.size() - 4, 4, ".idx") == 0) {
+            db = db.substr(0, db.size() - 4);
+        }
+        return db + "_feat";
+    }
+
+    // hash of the dbtype and index files of the DB the features are computed from
+    static uint64_t getSourceFingerprint(const std::string &db);
+
+    // features map residues with the default matrices only and have to match the fingerprint of the
+    // target DB stored in <DB>_feat.fingerprint, single entries are still checked against the target length
+    static bool isUsable(const LocalParameters &par, const std::string &featureDb);
+};
+
+int writeAlignmentFeatures(LocalParameters &par, const std::string &db, const std::string &featureDb);
+
+#endif //FOLDSEEK_ALIGNMENTFEATURES_H
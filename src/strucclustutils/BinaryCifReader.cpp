@@ -0,0 +1,548 @@
+#include "BinaryCifReader.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+static void fail(const std::string& message) {
+    throw std::runtime_error("BinaryCIF: " + message);
+}
+
+// MessagePack stores all numbers big-endian
+static uint64_t readBigEndian(const char*& it, const char* end, size_t bytes) {
+    if ((size_t)(end - it) < bytes) {
+        fail("unexpected end of data");
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value = (value << 8) | (uint8_t) it[i];
+    }
+    it += bytes;
+    return value;
+}
+
+static void parseValue(const char*& it, const char* end, BinaryCifReader::Value& value, int depth) {
+    if (depth > 64) {
+        fail("nesting too deep");
+    }
+    if (it >= end) {
+        fail("unexpected end of data");
+    }
+    uint8_t byte = (uint8_t) *it++;
+    size_t count = 0;
+    bool isMap = false;
+    if (byte <= 0x7f) {
+        value.type = BinaryCifReader::Value::INT;
+        value.i = byte;
+        return;
+    } else if (byte >= 0xe0) {
+        value.type = BinaryCifReader::Value::INT;
+        value.i = (int8_t) byte;
+        return;
+    } else if (byte >= 0x80 && byte <= 0x8f) {
+        isMap = true;
+        count = byte & 0x0f;
+    } else if (byte >= 0x90 && byte <= 0x9f) {
+        count = byte & 0x0f;
+    } else if (byte >= 0xa0 && byte <= 0xbf) {
+        value.type = BinaryCifReader::Value::STR;
+        value.size = byte & 0x1f;
+    } else {
+        switch (byte) {
+            case 0xc0:
+                value.type = BinaryCifReader::Value::NIL;
+                return;
+            case 0xc2:
+            case 0xc3:
+                value.type = BinaryCifReader::Value::BOOL;
+                value.i = byte == 0xc3;
+                return;
+            case 0xc4:
+            case 0xc5:
+            case 0xc6:
+                value.type = BinaryCifReader::Value::BIN;
+                value.size = readBigEndian(it, end, 1 << (byte - 0xc4));
+                break;
+            case 0xca: {
+                uint32_t bits = readBigEndian(it, end, 4);
+                float number;
+                memcpy(&number, &bits, sizeof(float));
+                value.type = BinaryCifReader::Value::FLOAT;
+                value.f = number;
+                return;
+            }
+            case 0xcb: {
+                uint64_t bits = readBigEndian(it, end, 8);
+                double number;
+                memcpy(&number, &bits, sizeof(double));
+                value.type = BinaryCifReader::Value::FLOAT;
+                value.f = number;
+                return;
+            }
+            case 0xcc:
+            case 0xcd:
+            case 0xce:
+            case 0xcf:
+                value.type = BinaryCifReader::Value::INT;
+                value.i = (int64_t) readBigEndian(it, end, 1 << (byte - 0xcc));
+                return;
+            case 0xd0:
+                value.type = BinaryCifReader::Value::INT;
+                value.i = (int8_t) readBigEndian(it, end, 1);
+                return;
+            case 0xd1:
+                value.type = BinaryCifReader::Value::INT;
+                value.i = (int16_t) readBigEndian(it, end, 2);
+                return;
+            case 0xd2:
+                value.type = BinaryCifReader::Value::INT;
+                value.i = (int32_t) readBigEndian(it, end, 4);
+                return;
+            case 0xd3:
+                value.type = BinaryCifReader::Value::INT;
+                value.i = (int64_t) readBigEndian(it, end, 8);
+                return;
+            case 0xd9:
+            case 0xda:
+            case 0xdb:
+                value.type = BinaryCifReader::Value::STR;
+                value.size = readBigEndian(it, end, 1 << (byte - 0xd9));
+                break;
+            case 0xdc:
+            case 0xdd:
+                count = readBigEndian(it, end, 2 << (byte - 0xdc));
+                break;
+            case 0xde:
+            case 0xdf:
+                isMap = true;
+                count = readBigEndian(it, end, 2 << (byte - 0xde));
+                break;
+            default:
+                fail("unsupported MessagePack type");
+        }
+    }
+
+    if (value.type == BinaryCifReader::Value::STR || value.type == BinaryCifReader::Value::BIN) {
+        if ((size_t)(end - it) < value.size) {
+            fail("unexpected end of data");
+        }
+        value.data = it;
+        it += value.size;
+        return;
+    }
+
+    value.type = isMap ? BinaryCifReader::Value::MAP : BinaryCifReader::Value::ARRAY;
+    value.size = count;
+    size_t elements = isMap ? 2 * count : count;
+    // every element takes at least one byte
+    if ((size_t)(end - it) < elements) {
+        fail("unexpected end of data");
+    }
+    value.children.resize(elements);
+    for (size_t i = 0; i < elements; ++i) {
+        parseValue(it, end, value.children[i], depth + 1);
+    }
+}
+
+const BinaryCifReader::Value* BinaryCifReader::Value::find(const char* key) const {
+    if (type != MAP) {
+        return NULL;
+    }
+    size_t keyLen = strlen(key);
+    for (size_t i = 0; i + 1 < children.size(); i += 2) {
+        const Value& k = children[i];
+        if (k.type == STR && k.size == keyLen && memcmp(k.data, key, keyLen) == 0) {
+            return &children[i + 1];
+        }
+    }
+    return NULL;
+}
+
+double BinaryCifReader::Value::asNumber() const {
+    if (type == INT || type == BOOL) {
+        return (double) i;
+    } else if (type == FLOAT) {
+        return f;
+    }
+    fail("expected a number");
+    return 0.0;
+}
+
+std::string BinaryCifReader::Value::asString() const {
+    if (type != STR) {
+        fail("expected a string");
+    }
+    return std::string(data, size);
+}
+
+static const BinaryCifReader::Value& require(const BinaryCifReader::Value& map, const char* key) {
+    const BinaryCifReader::Value* value = map.find(key);
+    if (value == NULL) {
+        fail(std::string("missing field ") + key);
+    }
+    return *value;
+}
+
+// element counts are read from the file, they must not exceed what the input can describe
+static size_t requireCount(const BinaryCifReader::Value& map, const char* key, size_t maxCount) {
+    double count = require(map, key).asNumber();
+    if (!(count >= 0.0 && count <= (double) maxCount)) {
+        fail(std::string("invalid ") + key);
+    }
+    return (size_t) count;
+}
+
+// numbers may be doubles, they are range checked before the conversion
+static int32_t requireInt32(const BinaryCifReader::Value& map, const char* key, const char* encoding) {
+    double value = require(map, key).asNumber();
+    if (!(value >= (double) INT32_MIN && value <= (double) INT32_MAX)) {
+        fail(std::string(encoding) + " " + key + " out of range");
+    }
+    return (int32_t) value;
+}
+
+static int32_t toInt32(int64_t value, const char* encoding) {
+    if (value < INT32_MIN || value > INT32_MAX) {
+        fail(std::string(encoding) + " value out of range");
+    }
+    return (int32_t) value;
+}
+
+enum DataType {
+    Int8 = 1,
+    Int16 = 2,
+    Int32 = 3,
+    Uint8 = 4,
+    Uint16 = 5,
+    Uint32 = 6,
+    Float32 = 32,
+    Float64 = 33
+};
+
+template <typename T>
+static void readArray(const char* data, size_t size, std::vector<T>& out) {
+    size_t count = size / sizeof(T);
+    out.resize(count);
+    memcpy(out.data(), data, count * sizeof(T));
+}
+
+template <typename T, typename U>
+static void convertArray(const char* data, size_t size, std::vector<U>& out) {
+    size_t count = size / sizeof(T);
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        T value;
+        memcpy(&value, data + i * sizeof(T), sizeof(T));
+        out[i] = (U) value;
+    }
+}
+
+// decodes an encoding chain from the last to the first encoding, BinaryCIF data is little-endian
+// maxCount bounds the length of run-length decoded arrays, the only encoding that expands its input
+static void decodeNumbers(const BinaryCifReader::Value& encodings, const char* data, size_t size, size_t maxCount,
+                          std::vector<int32_t>& ints, std::vector<double>& floats, bool& isFloat) {
+    if (encodings.type != BinaryCifReader::Value::ARRAY || encodings.children.empty()) {
+        fail("missing encoding");
+    }
+    isFloat = false;
+    bool isRaw = true;
+    std::vector<int32_t> tmp;
+    for (size_t k = encodings.children.size(); k > 0; --k) {
+        const BinaryCifReader::Value& encoding = encodings.children[k - 1];
+        std::string kind = require(encoding, "kind").asString();
+        if (kind == "ByteArray") {
+            if (isRaw == false) {
+                fail("ByteArray has to be the last encoding");
+            }
+            isRaw = false;
+            switch (requireInt32(encoding, "type", "ByteArray")) {
+                case Int8:    convertArray<int8_t>(data, size, ints); break;
+                case Int16:   convertArray<int16_t>(data, size, ints); break;
+                case Int32:   readArray(data, size, ints); break;
+                case Uint8:   convertArray<uint8_t>(data, size, ints); break;
+                case Uint16:  convertArray<uint16_t>(data, size, ints); break;
+                case Uint32:  convertArray<uint32_t>(data, size, ints); break;
+                case Float32: convertArray<float>(data, size, floats); isFloat = true; break;
+                case Float64: convertArray<double>(data, size, floats); isFloat = true; break;
+                default:
+                    fail("unsupported ByteArray type");
+            }
+            continue;
+        }
+        if (isRaw) {
+            fail("missing ByteArray encoding");
+        }
+        if (kind == "FixedPoint") {
+            double factor = require(encoding, "factor").asNumber();
+            floats.resize(ints.size());
+            for (size_t i = 0; i < ints.size(); ++i) {
+                floats[i] = ints[i] / factor;
+            }
+            isFloat = true;
+        } else if (kind == "IntervalQuantization") {
+            double min = require(encoding, "min").asNumber();
+            double max = require(encoding, "max").asNumber();
+            double numSteps = require(encoding, "numSteps").asNumber();
+            double delta = numSteps > 1 ? (max - min) / (numSteps - 1) : 0.0;
+            floats.resize(ints.size());
+            for (size_t i = 0; i < ints.size(); ++i) {
+                floats[i] = min + delta * ints[i];
+            }
+            isFloat = true;
+        } else if (kind == "RunLength") {
+            size_t srcSize = requireCount(encoding, "srcSize", maxCount);
+            tmp.clear();
+            tmp.reserve(srcSize);
+            for (size_t i = 0; i + 1 < ints.size(); i += 2) {
+                if (ints[i + 1] < 0 || tmp.size() + ints[i + 1] > srcSize) {
+                    fail("invalid RunLength encoding");
+                }
+                tmp.insert(tmp.end(), ints[i + 1], ints[i]);
+            }
+            ints.swap(tmp);
+        } else if (kind == "Delta") {
+            int64_t value = requireInt32(encoding, "origin", "Delta");
+            for (size_t i = 0; i < ints.size(); ++i) {
+                value += ints[i];
+                ints[i] = toInt32(value, "Delta");
+            }
+        } else if (kind == "IntegerPacking") {
+            int byteCount = requireInt32(encoding, "byteCount", "IntegerPacking");
+            bool isUnsigned = require(encoding, "isUnsigned").i != 0;
+            // unpacking only merges values
+            size_t srcSize = requireCount(encoding, "srcSize", ints.size());
+            int32_t upper = byteCount == 1 ? (isUnsigned ? 0xFF : 0x7F) : (isUnsigned ? 0xFFFF : 0x7FFF);
+            int32_t lower = isUnsigned ? INT32_MIN : (byteCount == 1 ? -0x80 : -0x8000);
+            tmp.clear();
+            tmp.reserve(srcSize);
+            size_t i = 0;
+            while (i < ints.size()) {
+                if (tmp.size() == srcSize) {
+                    fail("invalid IntegerPacking encoding");
+                }
+                int64_t value = 0;
+                int32_t t = ints[i];
+                while (t == upper || t == lower) {
+                    value += t;
+                    i++;
+                    if (i == ints.size()) {
+                        fail("invalid IntegerPacking encoding");
+                    }
+                    t = ints[i];
+                }
+                tmp.push_back(toInt32(value + t, "IntegerPacking"));
+                i++;
+            }
+            ints.swap(tmp);
+        } else {
+            fail("unsupported encoding " + kind);
+        }
+        if (isFloat && k > 1) {
+            fail("float data cannot be decoded further");
+        }
+    }
+}
+
+static void decodeData(const BinaryCifReader::Value& encodedData, size_t rowCount,
+                       std::vector<int32_t>& ints, std::vector<double>& floats,
+                       std::vector<std::string>& strings, bool& isFloat, bool& isString) {
+    const BinaryCifReader::Value& encodings = require(encodedData, "encoding");
+    const BinaryCifReader::Value& data = require(encodedData, "data");
+    if (data.type != BinaryCifReader::Value::BIN) {
+        fail("expected binary data");
+    }
+    isString = false;
+    if (encodings.type == BinaryCifReader::Value::ARRAY && encodings.children.size() == 1
+        && require(encodings.children[0], "kind").asString() == "StringArray") {
+        const BinaryCifReader::Value& encoding = encodings.children[0];
+        const BinaryCifReader::Value& stringData = require(encoding, "stringData");
+        const BinaryCifReader::Value& offsetData = require(encoding, "offsets");
+        if (stringData.type != BinaryCifReader::Value::STR || offsetData.type != BinaryCifReader::Value::BIN) {
+            fail("invalid StringArray encoding");
+        }
+        std::vector<int32_t> offsets;
+        decodeNumbers(require(encoding, "offsetEncoding"), offsetData.data, offsetData.size, rowCount + 1, offsets, floats, isFloat);
+        if (isFloat) {
+            fail("invalid StringArray offsets");
+        }
+        strings.clear();
+        for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+            if (offsets[i] < 0 || offsets[i] > offsets[i + 1] || (size_t) offsets[i + 1] > stringData.size) {
+                fail("invalid StringArray offsets");
+            }
+            strings.emplace_back(stringData.data + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+        decodeNumbers(require(encoding, "dataEncoding"), data.data, data.size, rowCount, ints, floats, isFloat);
+        if (isFloat) {
+            fail("invalid StringArray indices");
+        }
+        for (size_t i = 0; i < ints.size(); ++i) {
+            if (ints[i] >= (int32_t) strings.size()) {
+                fail("invalid StringArray index");
+            }
+        }
+        isString = true;
+    } else {
+        decodeNumbers(encodings, data.data, data.size, rowCount, ints, floats, isFloat);
+    }
+    if ((isFloat ? floats.size() : ints.size()) != rowCount) {
+        fail("column length does not match the row count");
+    }
+}
+
+void BinaryCifReader::parse(const char* buffer, size_t bufferSize) {
+    root = Value();
+    block = NULL;
+    inputSize = bufferSize;
+    const char* it = buffer;
+    parseValue(it, buffer + bufferSize, root, 0);
+    const Value& blocks = require(root, "dataBlocks");
+    if (blocks.type != Value::ARRAY || blocks.children.empty()) {
+        fail("no data blocks");
+    }
+    block = &blocks.children[0];
+}
+
+bool BinaryCifReader::isBinaryCif(const char* buffer, size_t bufferSize) {
+    if (bufferSize == 0) {
+        return false;
+    }
+    // all text based formats start with a printable character
+    uint8_t byte = (uint8_t) buffer[0];
+    return (byte >= 0x80 && byte <= 0x8f) || byte == 0xde || byte == 0xdf;
+}
+
+const BinaryCifReader::Value* BinaryCifReader::findCategory(const std::string& category) const {
+    if (block == NULL) {
+        return NULL;
+    }
+    const Value* categories = block->find("categories");
+    if (categories == NULL || categories->type != Value::ARRAY) {
+        return NULL;
+    }
+    // category names are usually stored with their leading underscore
+    for (size_t i = 0; i < categories->children.size(); ++i) {
+        const Value* name = categories->children[i].find("name");
+        if (name == NULL || name->type != Value::STR) {
+            continue;
+        }
+        const char* data = name->data;
+        size_t size = name->size;
+        if (size > 0 && data[0] == '_') {
+            data++;
+            size--;
+        }
+        if (size == category.size() && memcmp(data, category.c_str(), size) == 0) {
+            return &categories->children[i];
+        }
+    }
+    return NULL;
+}
+
+size_t BinaryCifReader::getRowCount(const std::string& category) const {
+    const Value* cat = findCategory(category);
+    if (cat == NULL) {
+        return 0;
+    }
+    return requireCount(*cat, "rowCount", inputSize);
+}
+
+void BinaryCifReader::getColumn(const std::string& category, const std::string& name, Column& column) const {
+    column.rowCount = 0;
+    column.ints.clear();
+    column.floats.clear();
+    column.strings.clear();
+    column.mask.clear();
+    const Value* cat = findCategory(category);
+    if (cat == NULL) {
+        return;
+    }
+    const Value& columns = require(*cat, "columns");
+    for (size_t i = 0; i < columns.children.size(); ++i) {
+        const Value* columnName = columns.children[i].find("name");
+        if (columnName == NULL || columnName->type != Value::STR
+            || columnName->size != name.size() || memcmp(columnName->data, name.c_str(), name.size()) != 0) {
+            continue;
+        }
+        size_t rowCount = requireCount(*cat, "rowCount", inputSize);
+        bool isFloat, isString;
+        decodeData(require(columns.children[i], "data"), rowCount, column.ints, column.floats, column.strings, isFloat, isString);
+        column.type = isString ? Column::STRING : (isFloat ? Column::FLOAT : Column::INT);
+        const Value* mask = columns.children[i].find("mask");
+        if (mask != NULL && mask->type != Value::NIL) {
+            std::vector<int32_t> maskInts;
+            std::vector<double> maskFloats;
+            std::vector<std::string> maskStrings;
+            decodeData(*mask, rowCount, maskInts, maskFloats, maskStrings, isFloat, isString);
+            if (isFloat || isString) {
+                fail("invalid mask");
+            }
+            column.mask.assign(maskInts.begin(), maskInts.end());
+        }
+        column.rowCount = rowCount;
+        return;
+    }
+}
+
+int BinaryCifReader::Column::getInt(size_t row) const {
+    switch (type) {
+        case INT:
+            return ints[row];
+        case FLOAT:
+            return (int) floats[row];
+        default:
+            return ints[row] < 0 ? 0 : atoi(strings[ints[row]].c_str());
+    }
+}
+
+double BinaryCifReader::Column::getFloat(size_t row) const {
+    switch (type) {
+        case INT:
+            return ints[row];
+        case FLOAT:
+            return floats[row];
+        default:
+            return ints[row] < 0 ? 0.0 : strtod(strings[ints[row]].c_str(), NULL);
+    }
+}
+
+const std::string& BinaryCifReader::Column::getString(size_t row) const {
+    if (isNull(row)) {
+        scratch.clear();
+        return scratch;
+    }
+    switch (type) {
+        case INT:
+            scratch = std::to_string(ints[row]);
+            return scratch;
+        case FLOAT: {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%g", floats[row]);
+            scratch = buffer;
+            return scratch;
+        }
+        default:
+            if (ints[row] < 0) {
+                scratch.clear();
+                return scratch;
+            }
+            return strings[ints[row]];
+    }
+}
+
+bool BinaryCifReader::Column::equals(size_t rowA, size_t rowB) const {
+    if (isNull(rowA) || isNull(rowB)) {
+        return isNull(rowA) == isNull(rowB);
+    }
+    switch (type) {
+        case FLOAT:
+            return floats[rowA] == floats[rowB];
+        case STRING:
+            return ints[rowA] == ints[rowB]
+                   || (ints[rowA] >= 0 && ints[rowB] >= 0 && strings[ints[rowA]] == strings[ints[rowB]]);
+        default:
+            return ints[rowA] == ints[rowB];
+    }
+}
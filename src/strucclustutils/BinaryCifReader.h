@@ -0,0 +1,79 @@
+#ifndef FOLDSEEK_BINARYCIFREADER_H
+#define FOLDSEEK_BINARYCIFREADER_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal reader for BinaryCIF (https://github.com/molstar/BinaryCIF)
+// The MessagePack document is parsed without copying, columns are only decoded when requested.
+// Malformed input throws std::runtime_error.
+class BinaryCifReader {
+public:
+    struct Value {
+        enum Type { NIL, BOOL, INT, FLOAT, STR, BIN, ARRAY, MAP };
+        Type type = NIL;
+        int64_t i = 0;
+        double f = 0.0;
+        const char* data = NULL;
+        size_t size = 0;
+        // arrays hold their elements, maps alternate between keys and values
+        std::vector<Value> children;
+
+        const Value* find(const char* key) const;
+        double asNumber() const;
+        std::string asString() const;
+    };
+
+    class Column {
+    public:
+        enum Type { INT, FLOAT, STRING };
+
+        Column() : type(INT), rowCount(0) {}
+
+        bool isPresent() const {
+            return rowCount > 0;
+        }
+
+        // '.' and '?' values
+        bool isNull(size_t row) const {
+            return mask.empty() == false && mask[row] != 0;
+        }
+
+        int getInt(size_t row) const;
+        double getFloat(size_t row) const;
+        // the returned reference is valid until the next call for a numeric column
+        const std::string& getString(size_t row) const;
+        bool equals(size_t rowA, size_t rowB) const;
+
+    private:
+        friend class BinaryCifReader;
+        Type type;
+        size_t rowCount;
+        std::vector<int32_t> ints;
+        std::vector<double> floats;
+        std::vector<std::string> strings;
+        std::vector<uint8_t> mask;
+        mutable std::string scratch;
+    };
+
+    void parse(const char* buffer, size_t bufferSize);
+
+    // rows of a category in the first data block, 0 if it does not exist
+    size_t getRowCount(const std::string& category) const;
+
+    // the column is empty if the category or column do not exist
+    void getColumn(const std::string& category, const std::string& name, Column& column) const;
+
+    static bool isBinaryCif(const char* buffer, size_t bufferSize);
+
+private:
+    Value root;
+    const Value* block = NULL;
+    // bounds the row counts read from the file, every atom takes at least one byte in its coordinate columns
+    size_t inputSize = 0;
+
+    const Value* findCategory(const std::string& category) const;
+};
+
+#endif //FOLDSEEK_BINARYCIFREADER_H
@@ -2,6 +2,7 @@
 // Created by Martin Steinegger on 6/7/21.
 //
 #include "GemmiWrapper.h"
+#include "BinaryCifReader.h"
 #include "mmread.hpp"
 #ifdef HAVE_ZLIB
 #include "gz.hpp"
@@ -96,7 +97,12 @@ bool GemmiWrapper::load(const std::string& filename, Format format) {
         gemmi::BasicInput infile(filename);
 #endif
         if (format == Format::Detect) {
-            format = mapFormat(gemmi::coor_format_from_ext(infile.basepath()));
+            format = gemmi::iends_with(infile.basepath(), ".bcif") ? Format::BinaryCif : mapFormat(gemmi::coor_format_from_ext(infile.basepath()));
+        }
+        if (format == Format::BinaryCif) {
+            gemmi::CharArray mem = read_into_buffer(infile);
+            loadBinaryCif(mem.data(), mem.size(), filename);
+            return true;
         }
         gemmi::Structure st;
         std::unordered_map<std::string, int> entity_to_tax_id;
@@ -174,7 +180,15 @@ bool GemmiWrapper::loadFromBuffer(const char * buffer, size_t bufferSize, const
         gemmi::BasicInput infile(name);
 #endif
         if (format == Format::Detect) {
-            format = mapFormat(gemmi::coor_format_from_ext(infile.basepath()));
+            if (gemmi::iends_with(infile.basepath(), ".bcif") || BinaryCifReader::isBinaryCif(buffer, bufferSize)) {
+                format = Format::BinaryCif;
+            } else {
+                format = mapFormat(gemmi::coor_format_from_ext(infile.basepath()));
+            }
+        }
+        if (format == Format::BinaryCif) {
+            loadBinaryCif(buffer, bufferSize, name);
+            return true;
         }
 
         gemmi::Structure st;
@@ -255,6 +269,8 @@ bool GemmiWrapper::loadFoldcompStructure(std::istream& stream, const std::string
     }
     std::vector<AtomCoordinate> coordinates;
     fc.useAltAtomOrder = false;
+    // only N/CA/C/CB are used, skip reconstructing the rest of the side chains
+    fc.backboneOnly = true;
     res = fc.decompress(coordinates);
     if (res != 0) {
         return false;
@@ -275,6 +291,12 @@ bool GemmiWrapper::loadFoldcompStructure(std::istream& stream, const std::string
     cb.clear();
     n.clear();
     ami.clear();
+    ca.reserve(fc.header.nResidue);
+    ca_bfactor.reserve(fc.header.nResidue);
+    c.reserve(fc.header.nResidue);
+    cb.reserve(fc.header.nResidue);
+    n.reserve(fc.header.nResidue);
+    ami.reserve(fc.header.nResidue);
     title.append(fc.strTitle);
     names.push_back(filename);
     const AtomCoordinate& first = coordinates[0];
@@ -302,11 +324,8 @@ bool GemmiWrapper::loadFoldcompStructure(std::istream& stream, const std::string
                 c_atom  = {NAN, NAN, NAN};
                 ca_atom_bfactor = 0.0;
             }
-            if (threeAA2oneAA.find(atom.residue) == threeAA2oneAA.end()) {
-                ami.push_back('X');
-            } else {
-                ami.push_back(threeAA2oneAA[atom.residue]);
-            }
+            std::unordered_map<std::string, char>::const_iterator aa = threeAA2oneAA.find(atom.residue);
+            ami.push_back(aa == threeAA2oneAA.end() ? 'X' : aa->second);
             residueIndex = atom.residue_index;
         }
 
@@ -442,3 +461,266 @@ void GemmiWrapper::updateStructure(void * void_st, const std::string& filename,
         }
     }
 }
+
+// Reads the structure directly from the decoded atom_site columns of a BinaryCIF file.
+// Models, chains and residues are grouped the same way as gemmi::make_structure and
+// filtered the same way as updateStructure, without building a gemmi::Structure.
+void GemmiWrapper::loadBinaryCif(const char* buffer, size_t bufferSize, const std::string& filename) {
+    BinaryCifReader reader;
+    reader.parse(buffer, bufferSize);
+
+    size_t atomCount = reader.getRowCount("atom_site");
+    BinaryCifReader::Column groupPdb, atomId, compId, labelAsymId, asymId, entityId, seqId, insCode, x, y, z, bIso, modelNum;
+    reader.getColumn("atom_site", "group_PDB", groupPdb);
+    reader.getColumn("atom_site", "auth_atom_id", atomId);
+    if (atomId.isPresent() == false) {
+        reader.getColumn("atom_site", "label_atom_id", atomId);
+    }
+    reader.getColumn("atom_site", "auth_comp_id", compId);
+    if (compId.isPresent() == false) {
+        reader.getColumn("atom_site", "label_comp_id", compId);
+    }
+    reader.getColumn("atom_site", "label_asym_id", labelAsymId);
+    reader.getColumn("atom_site", "auth_asym_id", asymId);
+    if (asymId.isPresent() == false) {
+        reader.getColumn("atom_site", "label_asym_id", asymId);
+    }
+    reader.getColumn("atom_site", "label_entity_id", entityId);
+    reader.getColumn("atom_site", "auth_seq_id", seqId);
+    reader.getColumn("atom_site", "pdbx_PDB_ins_code", insCode);
+    reader.getColumn("atom_site", "Cartn_x", x);
+    reader.getColumn("atom_site", "Cartn_y", y);
+    reader.getColumn("atom_site", "Cartn_z", z);
+    reader.getColumn("atom_site", "B_iso_or_equiv", bIso);
+    reader.getColumn("atom_site", "pdbx_PDB_model_num", modelNum);
+    if (atomCount > 0 && (atomId.isPresent() == false || compId.isPresent() == false || asymId.isPresent() == false
+        || seqId.isPresent() == false || x.isPresent() == false || y.isPresent() == false || z.isPresent() == false)) {
+        throw std::runtime_error("BinaryCIF: missing _atom_site columns in " + filename);
+    }
+
+    struct Residue {
+        std::string name;
+        std::string seqId;
+        std::string subchain;
+        std::string entityId;
+        char hetFlag;
+        bool hasCA;
+        float caBfactor;
+        Vec3 ca, cb, n, c;
+    };
+    struct Chain {
+        std::string name;
+        std::vector<Residue> residues;
+        std::unordered_map<std::string, size_t> lookup;
+    };
+    struct Model {
+        std::string name;
+        std::vector<Chain> chains;
+    };
+    std::vector<Model> models;
+    Model* model = NULL;
+    Chain* currChain = NULL;
+    Residue* residue = NULL;
+    size_t modelRow = 0, chainRow = 0, residueRow = 0;
+    std::string key;
+    for (size_t row = 0; row < atomCount; ++row) {
+        if (model == NULL || (modelNum.isPresent() && modelNum.equals(row, modelRow) == false)) {
+            const std::string& modelName = modelNum.isPresent() ? modelNum.getString(row) : "1";
+            model = NULL;
+            for (size_t i = 0; i < models.size(); ++i) {
+                if (models[i].name == modelName) {
+                    model = &models[i];
+                    break;
+                }
+            }
+            if (model == NULL) {
+                models.emplace_back();
+                models.back().name = modelName;
+                model = &models.back();
+            }
+            modelRow = row;
+            currChain = NULL;
+        }
+        if (currChain == NULL || asymId.equals(row, chainRow) == false) {
+            model->chains.emplace_back();
+            currChain = &model->chains.back();
+            currChain->name = asymId.getString(row);
+            chainRow = row;
+            residue = NULL;
+        }
+        if (residue == NULL || compId.equals(row, residueRow) == false || seqId.equals(row, residueRow) == false
+            || (insCode.isPresent() && insCode.equals(row, residueRow) == false)) {
+            key = seqId.getString(row);
+            key.push_back('\t');
+            if (insCode.isPresent()) {
+                key.append(insCode.getString(row));
+            }
+            std::string seqKey = key;
+            key.push_back('\t');
+            key.append(compId.getString(row));
+            std::unordered_map<std::string, size_t>::const_iterator it = currChain->lookup.find(key);
+            if (it != currChain->lookup.end()) {
+                residue = &currChain->residues[it->second];
+            } else {
+                currChain->lookup.emplace(key, currChain->residues.size());
+                currChain->residues.emplace_back();
+                residue = &currChain->residues.back();
+                residue->name = compId.getString(row);
+                residue->seqId = seqKey;
+                residue->subchain = labelAsymId.isPresent() ? labelAsymId.getString(row) : "";
+                residue->entityId = entityId.isPresent() ? entityId.getString(row) : "";
+                residue->hetFlag = '\0';
+                if (groupPdb.isPresent()) {
+                    const std::string& group = groupPdb.getString(row);
+                    if (group.empty() == false && (toupper(group[0]) == 'A' || toupper(group[0]) == 'H')) {
+                        residue->hetFlag = toupper(group[0]);
+                    }
+                }
+                residue->hasCA = false;
+                residue->caBfactor = 0.0f;
+                residue->ca = {NAN, NAN, NAN};
+                residue->cb = {NAN, NAN, NAN};
+                residue->n  = {NAN, NAN, NAN};
+                residue->c  = {NAN, NAN, NAN};
+            }
+            residueRow = row;
+        }
+
+        const std::string& atom = atomId.getString(row);
+        Vec3 pos = {x.getFloat(row), y.getFloat(row), z.getFloat(row)};
+        if (atom == "CA") {
+            residue->ca = pos;
+            residue->caBfactor = (bIso.isPresent() && bIso.isNull(row) == false) ? bIso.getFloat(row) : 50.0f;
+            residue->hasCA = true;
+        } else if (atom == "CB") {
+            residue->cb = pos;
+        } else if (atom == "N") {
+            residue->n = pos;
+        } else if (atom == "C") {
+            residue->c = pos;
+        }
+    }
+
+    std::unordered_map<std::string, bool> entityIsPolymer;
+    BinaryCifReader::Column entityIds, entityTypes;
+    reader.getColumn("entity", "id", entityIds);
+    reader.getColumn("entity", "type", entityTypes);
+    if (entityIds.isPresent() && entityTypes.isPresent()) {
+        for (size_t i = 0; i < reader.getRowCount("entity"); ++i) {
+            entityIsPolymer.emplace(entityIds.getString(i), entityTypes.getString(i) == "polymer");
+        }
+    }
+
+    std::unordered_map<std::string, int> entity_to_tax_id;
+    static const std::vector<std::pair<std::string, std::string>> loops_with_taxids = {
+        { "entity_src_nat", "pdbx_ncbi_taxonomy_id"},
+        { "entity_src_gen", "pdbx_gene_src_ncbi_taxonomy_id"},
+        { "pdbx_entity_src_syn", "ncbi_taxonomy_id"}
+    };
+    for (size_t i = 0; i < loops_with_taxids.size(); ++i) {
+        BinaryCifReader::Column taxEntity, taxIdColumn;
+        reader.getColumn(loops_with_taxids[i].first, "entity_id", taxEntity);
+        reader.getColumn(loops_with_taxids[i].first, loops_with_taxids[i].second, taxIdColumn);
+        if (taxEntity.isPresent() == false || taxIdColumn.isPresent() == false) {
+            continue;
+        }
+        for (size_t row = 0; row < reader.getRowCount(loops_with_taxids[i].first); ++row) {
+            if (taxIdColumn.isNull(row)) {
+                continue;
+            }
+            const std::string& taxId = taxIdColumn.getString(row);
+            const char* endptr = NULL;
+            int value = gemmi::no_sign_atoi(taxId.c_str(), &endptr);
+            if (endptr != NULL && *endptr == '\0') {
+                entity_to_tax_id.emplace(taxEntity.getString(row), value);
+            }
+        }
+    }
+
+    title.clear();
+    chain.clear();
+    names.clear();
+    chainNames.clear();
+    modelIndices.clear();
+    modelCount = 0;
+    ca.clear();
+    ca_bfactor.clear();
+    c.clear();
+    cb.clear();
+    n.clear();
+    ami.clear();
+    taxIds.clear();
+    BinaryCifReader::Column titleColumn;
+    reader.getColumn("struct", "title", titleColumn);
+    if (titleColumn.isPresent()) {
+        title.append(titleColumn.getString(0));
+    }
+    size_t pos = filename.find_last_of("\\/");
+    std::string name = (std::string::npos == pos) ? filename : filename.substr(pos + 1, filename.length());
+    size_t currPos = 0;
+    for (size_t m = 0; m < models.size(); ++m) {
+        modelCount++;
+        char* rest;
+        errno = 0;
+        unsigned int modelNumber = strtoul(models[m].name.c_str(), &rest, 10);
+        bool validModelNumber = !((rest != models[m].name.c_str() && *rest != '\0') || errno == ERANGE);
+        for (size_t ci = 0; ci < models[m].chains.size(); ++ci) {
+            const Chain& ch = models[m].chains[ci];
+            size_t chainStartPos = currPos;
+            chainNames.push_back(ch.name);
+            modelIndices.push_back(validModelNumber ? modelNumber : modelCount);
+            names.push_back(name);
+            int taxId = -1;
+            size_t subchainStart = 0;
+            bool isPolymer = false;
+            for (size_t ri = 0; ri < ch.residues.size(); ++ri) {
+                const Residue& res = ch.residues[ri];
+                // entity type of the subchain, falls back to the gemmi heuristic without an entity category
+                if (ri == 0 || res.subchain != ch.residues[ri - 1].subchain) {
+                    subchainStart = ri;
+                    size_t subchainEnd = ri + 1;
+                    while (subchainEnd < ch.residues.size() && ch.residues[subchainEnd].subchain == res.subchain) {
+                        subchainEnd++;
+                    }
+                    std::unordered_map<std::string, bool>::const_iterator entity = entityIsPolymer.find(res.entityId);
+                    if (entity != entityIsPolymer.end()) {
+                        isPolymer = entity->second;
+                    } else {
+                        bool isWater = res.name == "HOH" || res.name == "WAT" || res.name == "DOD" || res.name == "H2O";
+                        isPolymer = isWater == false && subchainEnd - subchainStart > 1;
+                    }
+                }
+                // only the first residue of a microheterogeneity group, as in first_conformer
+                if (ri > 0 && ch.residues[ri - 1].seqId == res.seqId) {
+                    continue;
+                }
+                if (taxId == -1) {
+                    std::unordered_map<std::string, int>::const_iterator it = entity_to_tax_id.find(res.entityId);
+                    if (it != entity_to_tax_id.end()) {
+                        taxId = it->second;
+                    }
+                }
+                std::unordered_map<std::string, char>::const_iterator aa = threeAA2oneAA.find(res.name);
+                bool isHetAtomInList = res.hetFlag == 'H' && aa != threeAA2oneAA.end();
+                if (isHetAtomInList == false && res.hetFlag != 'A') {
+                    continue;
+                }
+                if (isHetAtomInList && isPolymer == false) {
+                    continue;
+                }
+                if (res.hasCA == false) {
+                    continue;
+                }
+                ca_bfactor.push_back(res.caBfactor);
+                ca.push_back(res.ca);
+                cb.push_back(res.cb);
+                n.push_back(res.n);
+                c.push_back(res.c);
+                currPos++;
+                ami.push_back(aa == threeAA2oneAA.end() ? 'X' : aa->second);
+            }
+            taxIds.push_back(taxId == -1 ? 0 : taxId);
+            chain.push_back(std::make_pair(chainStartPos, currPos));
+        }
+    }
+}
@@ -2,6 +2,7 @@
 #define FOLDSEEK_MULTIMERUTIL_H
 #include "Matcher.h"
 #include "MemoryMapped.h"
+#include "StructureLookup.h"
 #include "TMaligner.h"
 
 const unsigned int NOT_AVAILABLE_CHAIN_KEY = 4294967295;
@@ -18,11 +19,11 @@ const float DEF_TM_SCORE = -1.0;
 const int UNINITIALIZED = 0;
 const unsigned int MULTIPLE_CHAINED_COMPLEX = 2;
 const unsigned int SIZE_OF_SUPERPOSITION_VECTOR = 12;
+const double ASSIGNMENT_REFINE_MARGIN = 0.9;
 typedef std::pair<std::string, std::string> compNameChainName_t;
 typedef std::map<unsigned int, unsigned int> chainKeyToComplexId_t;
 typedef std::map<unsigned int, std::vector<unsigned int>> complexIdToChainKeys_t;
 typedef std::vector<unsigned int> cluster_t;
-typedef std::map<std::pair<unsigned int, unsigned int>, float> distMap_t;
 typedef std::string resultToWrite_t;
 typedef std::string chainName_t;
 typedef std::pair<unsigned int, resultToWrite_t> resultToWriteWithKey_t;
@@ -37,6 +38,50 @@ struct Chain {
     std::vector<float> caVecZ;
 };
 
+// sufficient statistics of aligned CA pairs, summing them over chain pairs
+// gives the Kabsch superposition of a whole assignment
+struct SuperpositionStats {
+    SuperpositionStats() {
+        reset();
+    }
+    double count;
+    double qSum[3];
+    double dbSum[3];
+    // cross[a][b] = sum of db_a * q_b
+    double cross[3][3];
+
+    void reset() {
+        count = 0.0;
+        memset(qSum, 0, sizeof(qSum));
+        memset(dbSum, 0, sizeof(dbSum));
+        memset(cross, 0, sizeof(cross));
+    }
+
+    void add(float qX, float qY, float qZ, float dbX, float dbY, float dbZ) {
+        const double q[3] = {qX, qY, qZ};
+        const double db[3] = {dbX, dbY, dbZ};
+        count += 1.0;
+        for (size_t a = 0; a < 3; a++) {
+            qSum[a] += q[a];
+            dbSum[a] += db[a];
+            for (size_t b = 0; b < 3; b++) {
+                cross[a][b] += db[a] * q[b];
+            }
+        }
+    }
+
+    void add(const SuperpositionStats &o) {
+        count += o.count;
+        for (size_t a = 0; a < 3; a++) {
+            qSum[a] += o.qSum[a];
+            dbSum[a] += o.dbSum[a];
+            for (size_t b = 0; b < 3; b++) {
+                cross[a][b] += o.cross[a][b];
+            }
+        }
+    }
+};
+
 struct ChainToChainAln {
     ChainToChainAln() {}
     ChainToChainAln(Chain &queryChain, Chain &targetChain, float *qCaData, float *dbCaData, Matcher::result_t &alnResult, TMaligner::TMscoreResult &tmResult) : qChain(queryChain), dbChain(targetChain), tmScore((float)tmResult.tmscore) {
@@ -54,6 +99,8 @@ struct ChainToChainAln {
             switch (cigar) {
                 case 'M':
                     matches++;
+                    stats.add(qCaData[qXPos + qPos], qCaData[qYPos + qPos], qCaData[qZPos + qPos],
+                              dbCaData[dbXPos + dbPos], dbCaData[dbYPos + dbPos], dbCaData[dbZPos + dbPos]);
                     qChain.caVecX.emplace_back(qCaData[qXPos + qPos]);
                     qChain.caVecY.emplace_back(qCaData[qYPos + qPos]);
                     qChain.caVecZ.emplace_back(qCaData[qZPos + qPos++]);
@@ -93,6 +140,7 @@ struct ChainToChainAln {
     unsigned int alnLength;
     resultToWrite_t resultToWrite;
     double superposition[SIZE_OF_SUPERPOSITION_VECTOR];
+    SuperpositionStats stats;
     unsigned int label;
     float tmScore;
 
@@ -164,27 +212,19 @@ struct ComplexDataHandler {
 
 
 static void getKeyToIdMapIdToKeysMapIdVec(
-        const std::string &file,
+        const std::string &db,
         std::map<unsigned int, unsigned int> &chainKeyToComplexIdLookup,
         std::map<unsigned int, std::vector<unsigned int>> &complexIdToChainKeysLookup,
         std::vector<unsigned int> &complexIdVec
 ) {
-    if (file.length() == 0) {
+    if (db.length() == 0) {
         return;
     }
-    MemoryMapped lookupDB(file, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
-    char *data = (char *) lookupDB.getData();
-    char *end = data + lookupDB.mappedSize();
-    const char *entry[255];
+    StructureLookup lookup(db, false);
     int prevComplexId =  -1;
-    while (data < end && *data != '\0') {
-        const size_t columns = Util::getWordsOfLine(data, entry, 255);
-        if (columns < 3) {
-            Debug(Debug::WARNING) << "Not enough columns in lookup file " << file << "\n";
-            continue;
-        }
-        auto chainKey = Util::fast_atoi<int>(entry[0]);
-        auto complexId = Util::fast_atoi<int>(entry[2]);
+    for (size_t i = 0; i < lookup.size(); i++) {
+        unsigned int chainKey = lookup.getKey(i);
+        int complexId = lookup.getSet(i);
         chainKeyToComplexIdLookup.emplace(chainKey, complexId);
         if (complexId != prevComplexId) {
             complexIdToChainKeysLookup.emplace(complexId, std::vector<unsigned int>());
@@ -192,9 +232,7 @@ static void getKeyToIdMapIdToKeysMapIdVec(
             prevComplexId = complexId;
         }
         complexIdToChainKeysLookup.at(complexId).emplace_back(chainKey);
-        data = Util::skipLine(data);
     }
-    lookupDB.close();
 }
 
 static ComplexDataHandler parseScoreComplexResult(const char *data, Matcher::result_t &res) {
@@ -1,5 +1,6 @@
 #include <cstring>
 #include <cstdio>
+#include <cstdint>
 
 #include "LocalParameters.h"
 #include "DBReader.h"
@@ -7,7 +8,7 @@
 #include "Util.h"
 #include "FileUtil.h"
 #include "Coordinate16.h"
-#include "MultimerUtil.h"
+#include "StructureLookup.h"
 
 #ifdef OPENMP
 #include <omp.h>
@@ -39,27 +40,35 @@ private:
     unsigned int key;
 };
 
-class MapIterator : public KeyIterator {
+class ComplexIterator : public KeyIterator {
 public:
-    MapIterator(const complexIdToChainKeys_t& map, const std::vector<unsigned int>& complexIndices)
-        : map(map), complexIndices(complexIndices) {}
-    ~MapIterator() {}
+    ComplexIterator(const StructureLookup& lookup, const std::vector<size_t>& complexStarts)
+        : lookup(lookup), complexStarts(complexStarts) {}
+    ~ComplexIterator() {}
 
     size_t getSize() const override {
-        return complexIndices.size();
+        return complexStarts.size() - 1;
     }
 
     std::pair<const unsigned int*, size_t> getDbKeys(size_t index) override {
-        unsigned int key = complexIndices[index];
-        const std::vector<unsigned int>& currentKeys = map.at(key);
-        return std::make_pair(currentKeys.data(), currentKeys.size());
+        size_t start = complexStarts[index];
+        return std::make_pair(lookup.getKeys() + start, complexStarts[index + 1] - start);
     }
 
 private:
-    const complexIdToChainKeys_t& map;
-    const std::vector<unsigned int>& complexIndices;
+    const StructureLookup& lookup;
+    const std::vector<size_t>& complexStarts;
 };
 
+static std::string lookupName(const StructureLookup& lookup, unsigned int key) {
+    size_t id = lookup.getId(key);
+    if (id == SIZE_MAX) {
+        Debug(Debug::ERROR) << "Entry " << key << " is missing in the lookup\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return lookup.getName(id);
+}
+
 void writeTitle(FILE* handle, const char* headerData, size_t headerLen) {
     int remainingHeader = headerLen;
     fprintf(handle, "TITLE     %.*s\n",  std::min(70, (int)remainingHeader), headerData);
@@ -84,11 +93,7 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
         localThreads = par.threads;
     }
 
-    int mode = DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX;
-    if (outputMode != LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
-        mode |= DBReader<unsigned int>::USE_LOOKUP;
-    }
-    DBReader<unsigned int> db(par.db1.c_str(), par.db1Index.c_str(), localThreads, mode);
+    DBReader<unsigned int> db(par.db1.c_str(), par.db1Index.c_str(), localThreads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     db.open(DBReader<unsigned int>::NOSORT);
 
     DBReader<unsigned int> db_header(par.hdr1.c_str(), par.hdr1Index.c_str(), localThreads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
@@ -99,12 +104,13 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
     DBReader<unsigned int> db_ca(dbCa.c_str(), dbCaIndex.c_str(), localThreads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     db_ca.open(DBReader<unsigned int>::NOSORT);
 
-    std::string lookupFile = par.db1 + ".lookup";
-    chainKeyToComplexId_t chainKeyToComplexIdMap;
-    complexIdToChainKeys_t complexIdToChainKeysMap;
-    std::vector<unsigned int> complexIndices;
+    StructureLookup* lookup = NULL;
+    std::vector<size_t> complexStarts;
+    if (outputMode != LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
+        lookup = new StructureLookup(par.db1, false);
+    }
     if (outputMode == LocalParameters::PDB_OUTPUT_MODE_COMPLEX) {
-        getKeyToIdMapIdToKeysMapIdVec(lookupFile, chainKeyToComplexIdMap, complexIdToChainKeysMap, complexIndices);
+        lookup->getSetRuns(complexStarts);
     }
 
     Debug(Debug::INFO) << "Start writing file to " << par.db2 << "\n";
@@ -140,7 +146,7 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
 
         KeyIterator* keyIterator;
         if (outputMode == LocalParameters::PDB_OUTPUT_MODE_COMPLEX) {
-            keyIterator = new MapIterator(complexIdToChainKeysMap, complexIndices);
+            keyIterator = new ComplexIterator(*lookup, complexStarts);
         } else {
             keyIterator = new DbKeyIterator(db);
         }
@@ -150,7 +156,7 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
             std::pair<const unsigned int*, size_t> keys = keyIterator->getDbKeys(i);
             if (outputMode != LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
                 unsigned int key = keys.first[0];
-                std::string name = db.getLookupEntryName(key);
+                std::string name = lookupName(*lookup, key);
                 if (outputMode == LocalParameters::PDB_OUTPUT_MODE_COMPLEX) {
                     std::string chain = name.substr(name.find_last_of('_') + 1);
                     if (chain.size() == 0) {
@@ -195,7 +201,7 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
                     const size_t headerLen = db_header.getEntryLen(headerId) - 2;
                     writeTitle(threadHandle, headerData, headerLen);
                 } else {
-                    std::string name = db.getLookupEntryName(key);
+                    std::string name = lookupName(*lookup, key);
                     chainName = name.substr(name.find_last_of('_') + 1);
                     if (chainName.size() == 0) {
                         chainName = "A";
@@ -225,6 +231,9 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
         Debug(Debug::ERROR) << "Cannot close file " << par.db2 << "\n";
         EXIT(EXIT_FAILURE);
     }
+    if (lookup != NULL) {
+        delete lookup;
+    }
     db_ca.close();
     db_header.close();
     db.close();
@@ -42,12 +42,11 @@ int expandmultimer(int argc, const char **argv, const Command &command) {
     DBWriter resultWriter(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed, dbType);
     resultWriter.open();
 
-    const bool touch = par.preloadMode != Parameters::PRELOAD_MODE_MMAP;
     IndexReader tDbr(
         par.db2,
         par.threads,
         needSrc ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-        touch ? IndexReader::PRELOAD_INDEX : 0,
+        IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
         DBReader<unsigned int>::USE_INDEX
     );
 
@@ -57,10 +56,8 @@ int expandmultimer(int argc, const char **argv, const Command &command) {
     chainKeyToComplexId_t dbChainKeyToComplexIdMap;
     complexIdToChainKeys_t qComplexIdToChainKeysMap;
     complexIdToChainKeys_t dbComplexIdToChainKeysMap;
-    std::string qLookupFile = par.db1 + ".lookup";
-    std::string dbLookupFile = par.db2 + ".lookup";
-    getKeyToIdMapIdToKeysMapIdVec(qLookupFile, qChainKeyToComplexIdMap, qComplexIdToChainKeysMap, qComplexIndices);
-    getKeyToIdMapIdToKeysMapIdVec(dbLookupFile, dbChainKeyToComplexIdMap, dbComplexIdToChainKeysMap, dbComplexIndices);
+    getKeyToIdMapIdToKeysMapIdVec(par.db1, qChainKeyToComplexIdMap, qComplexIdToChainKeysMap, qComplexIndices);
+    getKeyToIdMapIdToKeysMapIdVec(par.db2, dbChainKeyToComplexIdMap, dbComplexIdToChainKeysMap, dbComplexIndices);
     dbComplexIndices.clear();
     qChainKeyToComplexIdMap.clear();
 
@@ -19,13 +19,12 @@ int pareunaligner(int argc, const char **argv, const Command& command) {
     LocalParameters &par = LocalParameters::getLocalInstance();
     par.parseParameters(argc, argv, command, false, 0, MMseqsParameter::COMMAND_ALIGN);
 
-    const bool touch = par.preloadMode != Parameters::PRELOAD_MODE_MMAP;
-    IndexReader qdbr(StructureUtil::getIndexWithSuffix(par.db1, "_ss"), par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
+    IndexReader qdbr(StructureUtil::getIndexWithSuffix(par.db1, "_ss"), par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
     IndexReader qcadbr(
         par.db1,
         par.threads,
         IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY),
-        touch ? IndexReader::PRELOAD_INDEX : 0,
+        IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
         DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
         "_ca"
     );
@@ -38,12 +37,12 @@ int pareunaligner(int argc, const char **argv, const Command& command) {
         tdbr = &qdbr;
         tcadbr = &qcadbr;
     } else {
-        tdbr = new IndexReader(StructureUtil::getIndexWithSuffix(par.db2, "_ss"), par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
+        tdbr = new IndexReader(StructureUtil::getIndexWithSuffix(par.db2, "_ss"), par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
         tcadbr = new IndexReader(
             par.db2,
             par.threads,
             IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY),
-            touch ? IndexReader::PRELOAD_INDEX : 0,
+            IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
             DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
             "_ca"
         );
@@ -0,0 +1,208 @@
+// include xxhash early to avoid incompatibilites with SIMDe
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "FileUtil.h"
+#include "Sequence.h"
+#include "SubstitutionMatrix.h"
+#include "Coordinate16.h"
+#include "AlignmentFeatures.h"
+#include "simd.h"
+
+#include <cinttypes>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+bool AlignmentFeatures::isUsable(const LocalParameters &par, const std::string &featureDb) {
+    if (FileUtil::fileExists((featureDb + ".dbtype").c_str()) == false) {
+        return false;
+    }
+    if (Parameters::isEqualDbtype(FileUtil::parseDbType(featureDb.c_str()), LocalParameters::DBTYPE_FEATURES) == false) {
+        Debug(Debug::WARNING) << featureDb << " is not a feature database and will be ignored\n";
+        return false;
+    }
+    // the matrix parameter holds the serialized matrix after parsing
+    if (BaseMatrix::unserializeName(par.scoringMatrixFile.values.aminoacid().c_str()) != "3di.out") {
+        return false;
+    }
+    std::string fingerprintFile = featureDb + ".fingerprint";
+    FILE *handle = fopen(fingerprintFile.c_str(), "r");
+    uint64_t stored = 0;
+    bool hasFingerprint = handle != NULL && fscanf(handle, "%" SCNx64, &stored) == 1;
+    if (handle != NULL) {
+        fclose(handle);
+    }
+    if (hasFingerprint == false || stored != getSourceFingerprint(featureDb.substr(0, featureDb.size() - 5))) {
+        Debug(Debug::WARNING) << featureDb << " does not belong to the current target database and will be ignored\n";
+        return false;
+    }
+    return true;
+}
+
+uint64_t AlignmentFeatures::getSourceFingerprint(const std::string &db) {
+    const char *suffixes[] = {".dbtype", ".index", "_ss.dbtype", "_ss.index", "_ca.dbtype", "_ca.index"};
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    char buffer[64 * 1024];
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        std::string file = db + suffixes[i];
+        // a missing _ca DB is part of the fingerprint as well
+        XXH64_update(&state, suffixes[i], strlen(suffixes[i]));
+        FILE *handle = fopen(file.c_str(), "r");
+        if (handle == NULL) {
+            continue;
+        }
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), handle)) > 0) {
+            XXH64_update(&state, buffer, read);
+        }
+        fclose(handle);
+    }
+    return XXH64_digest(&state);
+}
+
+void AlignmentFeatures::packResidues(const unsigned char *aa, const unsigned char *ss, unsigned int length, unsigned char *packed) {
+    for (size_t i = 0; i < length; i++) {
+        size_t bit = 10 * i;
+        unsigned int value = static_cast<unsigned int>(aa[i]) | (static_cast<unsigned int>(ss[i]) << 5);
+        value <<= (bit & 7);
+        packed[bit >> 3] |= static_cast<unsigned char>(value & 0xFF);
+        packed[(bit >> 3) + 1] |= static_cast<unsigned char>(value >> 8);
+    }
+}
+
+void AlignmentFeatures::unpackResidues(const unsigned char *packed, unsigned int length, unsigned char *aa, unsigned char *ss) {
+    size_t i = 0;
+    // 8 residues are stored in 10 bytes, every residue is gathered into its own 16 bit lane,
+    // the multiplication shifts each field to the top of its lane
+    const __m128i gather = _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+    const __m128i align = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i mask = _mm_set1_epi16(0x1F);
+    for (; i + 8 <= length; i += 8) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(packed + (i / 8) * 10));
+        __m128i value = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(block, gather), align), 6);
+        __m128i residues = _mm_packus_epi16(_mm_and_si128(value, mask), _mm_srli_epi16(value, 5));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(aa + i), residues);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(ss + i), _mm_srli_si128(residues, 8));
+    }
+    for (; i < length; i++) {
+        size_t bit = 10 * i;
+        unsigned int value = (static_cast<unsigned int>(packed[bit >> 3]) | (static_cast<unsigned int>(packed[(bit >> 3) + 1]) << 8)) >> (bit & 7);
+        aa[i] = static_cast<unsigned char>(value & 0x1F);
+        ss[i] = static_cast<unsigned char>((value >> 5) & 0x1F);
+    }
+}
+
+int writeAlignmentFeatures(LocalParameters &par, const std::string &db, const std::string &featureDb) {
+    DBReader<unsigned int> aaDbr(db.c_str(), (db + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    aaDbr.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+    std::string ssDb = db + "_ss";
+    DBReader<unsigned int> ssDbr(ssDb.c_str(), (ssDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    ssDbr.open(DBReader<unsigned int>::NOSORT);
+    DBReader<unsigned int> *caDbr = NULL;
+    std::string caDb = db + "_ca";
+    if (FileUtil::fileExists((caDb + ".dbtype").c_str())) {
+        caDbr = new DBReader<unsigned int>(caDb.c_str(), (caDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        caDbr->open(DBReader<unsigned int>::NOSORT);
+    } else {
+        Debug(Debug::WARNING) << "No C-alpha database found for " << db << ". Features will only contain residues\n";
+    }
+
+    SubstitutionMatrix subMat3Di(par.scoringMatrixFile.values.aminoacid().c_str(), 2.1, par.scoreBias);
+    std::string blosum;
+    for (size_t i = 0; i < par.substitutionMatrices.size(); i++) {
+        if (par.substitutionMatrices[i].name == "blosum62.out") {
+            std::string matrixData((const char *)par.substitutionMatrices[i].subMatData, par.substitutionMatrices[i].subMatDataLen);
+            std::string matrixName = par.substitutionMatrices[i].name;
+            char * serializedMatrix = BaseMatrix::serialize(matrixName, matrixData);
+            blosum.assign(serializedMatrix);
+            free(serializedMatrix);
+            break;
+        }
+    }
+    SubstitutionMatrix subMatAA(blosum.c_str(), 1.4, par.scoreBias);
+    const bool pack = par.packResidues != 0;
+    if (pack && (subMatAA.alphabetSize > 32 || subMat3Di.alphabetSize > 32)) {
+        Debug(Debug::ERROR) << "Residues do not fit into 5 bits and cannot be packed\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    std::string fingerprintFile = featureDb + ".fingerprint";
+    if (FileUtil::fileExists(fingerprintFile.c_str())) {
+        FileUtil::remove(fingerprintFile.c_str());
+    }
+    DBWriter writer(featureDb.c_str(), (featureDb + ".index").c_str(), par.threads, false, LocalParameters::DBTYPE_FEATURES);
+    writer.open();
+
+    Debug::Progress progress(aaDbr.getSize());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        Sequence seqAA(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMatAA, 0, false, false);
+        Sequence seq3Di(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMat3Di, 0, false, false);
+        Coordinate16 coords;
+        std::vector<char> entry;
+
+#pragma omp for schedule(dynamic, 10)
+        for (size_t id = 0; id < aaDbr.getSize(); id++) {
+            progress.updateProgress();
+            unsigned int key = aaDbr.getDbKey(id);
+            unsigned int length = aaDbr.getSeqLen(id);
+            size_t ssId = ssDbr.getId(key);
+            if (ssId == UINT_MAX) {
+                Debug(Debug::ERROR) << "Entry " << key << " is missing in " << ssDb << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            seqAA.mapSequence(id, key, aaDbr.getData(id, thread_idx), length);
+            seq3Di.mapSequence(ssId, key, ssDbr.getData(ssId, thread_idx), length);
+
+            const char *ca = NULL;
+            bool caDiff16 = false;
+            if (caDbr != NULL) {
+                size_t caId = caDbr->getId(key);
+                if (caId != UINT_MAX) {
+                    const char *caData = caDbr->getData(caId, thread_idx);
+                    size_t caLength = caDbr->getEntryLen(caId);
+                    // packed features keep the compact encoding of the _ca DB, others are decoded once
+                    caDiff16 = pack && caLength < 3 * length * sizeof(float) && caLength >= AlignmentFeatures::getDiff16Size(length);
+                    ca = caDiff16 ? caData : reinterpret_cast<const char *>(coords.read(caData, length, caLength));
+                }
+            }
+            AlignmentFeatures::append(entry, length, ca, caDiff16, seqAA.numSequence, seq3Di.numSequence, pack);
+            writer.writeData(entry.data(), entry.size(), key, thread_idx);
+        }
+    }
+    writer.close(true);
+
+    // written last, an interrupted run leaves no usable feature DB behind
+    FILE *handle = FileUtil::openAndDelete(fingerprintFile.c_str(), "w");
+    fprintf(handle, "%016" PRIx64 "\n", AlignmentFeatures::getSourceFingerprint(db));
+    if (fclose(handle) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << fingerprintFile << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    if (caDbr != NULL) {
+        caDbr->close();
+        delete caDbr;
+    }
+    ssDbr.close();
+    aaDbr.close();
+    return EXIT_SUCCESS;
+}
+
+int precomputefeatures(int argc, const char **argv, const Command& command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+    return writeAlignmentFeatures(par, par.db1, par.db2);
+}
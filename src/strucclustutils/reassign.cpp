@@ -0,0 +1,202 @@
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "FileUtil.h"
+#include "LocalParameters.h"
+#include "FastSort.h"
+
+#include <algorithm>
+#include <climits>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+// Bookkeeping of the --cluster-reassign branch of structurecluster.sh. The alignments, the prefilter
+// and the final clust step run as regular modules, these two modules replace the subtractdbs, swapdb,
+// createsubdb, filterdb, mergedbs and tsv2db calls that were run in between.
+// This is not yet the single process reassignment: structurealign/tmalign and the prefilter have no
+// entry point that works on an in-memory subset or a loaded index, so they still read the linked
+// subsets written here.
+
+// subset of db with the given sorted keys that shares the data of db, like createsubdb --subdb-mode 1
+static void writeLinkedSubset(const std::string &db, const std::string &outDb, const std::vector<unsigned int> &keys) {
+    DBReader<unsigned int> reader(db.c_str(), (db + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+    reader.open(DBReader<unsigned int>::NOSORT);
+    std::vector<DBReader<unsigned int>::Index> index;
+    index.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        size_t id = reader.getId(keys[i]);
+        if (id == UINT_MAX) {
+            Debug(Debug::ERROR) << "Key " << keys[i] << " not found in " << db << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        DBReader<unsigned int>::Index entry;
+        entry.id = keys[i];
+        entry.offset = reader.getOffset(id);
+        entry.length = reader.getEntryLen(id);
+        index.push_back(entry);
+    }
+    FILE *indexFile = FileUtil::openAndDelete((outDb + ".index").c_str(), "w");
+    DBWriter::writeIndex(indexFile, index.size(), index.data());
+    if (fclose(indexFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close index file " << outDb << ".index\n";
+        EXIT(EXIT_FAILURE);
+    }
+    DBReader<unsigned int>::softlinkDb(db, outDb, DBFiles::DATA);
+    DBWriter::writeDbtypeFile(outDb.c_str(), reader.getDbtype(), reader.isCompressed());
+    DBReader<unsigned int>::softlinkDb(db, outDb, DBFiles::SEQUENCE_ANCILLARY);
+    reader.close();
+}
+
+static void writeLinkedSubsets(const std::string &db, const std::string &outDb, const std::vector<unsigned int> &keys) {
+    writeLinkedSubset(db, outDb, keys);
+    writeLinkedSubset(db + "_ss", outDb + "_ss", keys);
+    if (FileUtil::fileExists((db + "_ca.dbtype").c_str())) {
+        writeLinkedSubset(db + "_ca", outDb + "_ca", keys);
+    }
+}
+
+// Splits every cluster into the members that passed the alignment to their representative and the rejected
+// members. Writes the accepted clusters, the rejected members and the reassignment targets (representatives
+// and rejected members) as subsets that link to the data of the sequence DB.
+int reassignsplit(int argc, const char **argv, const Command& command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    DBReader<unsigned int> cluDbr(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    cluDbr.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+    DBReader<unsigned int> alnDbr(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    alnDbr.open(DBReader<unsigned int>::NOSORT);
+
+    DBWriter acceptedWriter(par.db4.c_str(), par.db4Index.c_str(), par.threads, par.compressed, Parameters::DBTYPE_CLUSTER_RES);
+    acceptedWriter.open();
+
+    std::vector<unsigned int> rejectedKeys;
+    std::vector<unsigned int> targetKeys(cluDbr.getSize());
+    Debug::Progress progress(cluDbr.getSize());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        char dbKey[255 + 1];
+        std::vector<unsigned int> alignedKeys;
+        std::vector<unsigned int> localRejectedKeys;
+        std::string result;
+
+#pragma omp for schedule(dynamic, 10)
+        for (size_t i = 0; i < cluDbr.getSize(); i++) {
+            progress.updateProgress();
+            const unsigned int repKey = cluDbr.getDbKey(i);
+            targetKeys[i] = repKey;
+
+            alignedKeys.clear();
+            size_t alnId = alnDbr.getId(repKey);
+            if (alnId != UINT_MAX) {
+                char *data = alnDbr.getData(alnId, thread_idx);
+                while (*data != '\0') {
+                    Util::parseKey(data, dbKey);
+                    alignedKeys.push_back(Util::fast_atoi<unsigned int>(dbKey));
+                    data = Util::skipLine(data);
+                }
+                std::sort(alignedKeys.begin(), alignedKeys.end());
+            }
+
+            // keeps the member order of the cluster DB, like subtractdbs
+            result.clear();
+            char *data = cluDbr.getData(i, thread_idx);
+            while (*data != '\0') {
+                char *start = data;
+                Util::parseKey(data, dbKey);
+                data = Util::skipLine(data);
+                const unsigned int key = Util::fast_atoi<unsigned int>(dbKey);
+                if (std::binary_search(alignedKeys.begin(), alignedKeys.end(), key)) {
+                    result.append(start, data - start);
+                } else {
+                    localRejectedKeys.push_back(key);
+                }
+            }
+            acceptedWriter.writeData(result.c_str(), result.length(), repKey, thread_idx);
+        }
+
+#pragma omp critical
+        {
+            rejectedKeys.insert(rejectedKeys.end(), localRejectedKeys.begin(), localRejectedKeys.end());
+        }
+    }
+    acceptedWriter.close();
+    alnDbr.close();
+    cluDbr.close();
+
+    SORT_PARALLEL(rejectedKeys.begin(), rejectedKeys.end());
+    targetKeys.insert(targetKeys.end(), rejectedKeys.begin(), rejectedKeys.end());
+    SORT_PARALLEL(targetKeys.begin(), targetKeys.end());
+    targetKeys.erase(std::unique(targetKeys.begin(), targetKeys.end()), targetKeys.end());
+    Debug(Debug::INFO) << rejectedKeys.size() << " members did not pass the alignment criteria\n";
+
+    writeLinkedSubsets(par.db1, par.db5, rejectedKeys);
+    writeLinkedSubsets(par.db1, par.db6, targetKeys);
+    return EXIT_SUCCESS;
+}
+
+// Builds the graph for the final clust step: the accepted cluster members of each entry followed by the
+// reassignment hits of that entry. Entries without either become singletons, so every sequence is clustered.
+int reassignmerge(int argc, const char **argv, const Command& command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    DBReader<unsigned int> seqDbr(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX);
+    seqDbr.open(DBReader<unsigned int>::NOSORT);
+    DBReader<unsigned int> acceptedDbr(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    acceptedDbr.open(DBReader<unsigned int>::NOSORT);
+    DBReader<unsigned int> alnDbr(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    alnDbr.open(DBReader<unsigned int>::NOSORT);
+
+    DBWriter writer(par.db4.c_str(), par.db4Index.c_str(), par.threads, par.compressed, Parameters::DBTYPE_CLUSTER_RES);
+    writer.open();
+
+    Debug::Progress progress(seqDbr.getSize());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        char dbKey[255 + 1];
+        std::string result;
+
+#pragma omp for schedule(dynamic, 100)
+        for (size_t i = 0; i < seqDbr.getSize(); i++) {
+            progress.updateProgress();
+            const unsigned int key = seqDbr.getDbKey(i);
+            result.clear();
+            size_t acceptedId = acceptedDbr.getId(key);
+            if (acceptedId != UINT_MAX) {
+                result.append(acceptedDbr.getData(acceptedId, thread_idx), acceptedDbr.getEntryLen(acceptedId) - 1);
+            }
+            size_t alnId = alnDbr.getId(key);
+            if (alnId != UINT_MAX) {
+                char *data = alnDbr.getData(alnId, thread_idx);
+                while (*data != '\0') {
+                    Util::parseKey(data, dbKey);
+                    result.append(dbKey);
+                    result.push_back('\n');
+                    data = Util::skipLine(data);
+                }
+            }
+            if (result.empty()) {
+                result.append(SSTR(key));
+                result.push_back('\n');
+            }
+            writer.writeData(result.c_str(), result.length(), key, thread_idx);
+        }
+    }
+    writer.close();
+    alnDbr.close();
+    acceptedDbr.close();
+    seqDbr.close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "FileUtil.h"
+#include "StructureLookup.h"
+#include "itoa.h"
+
+#include <climits>
+#include <algorithm>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+// writes the entries of one DB component in the new order, entry i gets key i.
+// Entries are copied as stored, like createsubdb, so compressed DBs stay compressed
+static void writeReordered(const std::string &inDb, const std::string &outDb,
+                           const std::vector<unsigned int> &order, int threads) {
+    DBReader<unsigned int> reader(inDb.c_str(), (inDb + ".index").c_str(), threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    reader.open(DBReader<unsigned int>::NOSORT);
+    const bool isCompressed = reader.isCompressed();
+    DBWriter writer(outDb.c_str(), (outDb + ".index").c_str(), threads, 0, Parameters::DBTYPE_OMIT_FILE);
+    writer.open();
+    // static schedule so that merging the thread files keeps the new order on disk
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+#pragma omp for schedule(static)
+        for (size_t i = 0; i < order.size(); i++) {
+            size_t id = reader.getId(order[i]);
+            if (id == UINT_MAX) {
+                continue;
+            }
+            char *data = reader.getDataUncompressed(id);
+            size_t originalLength = reader.getEntryLen(id);
+            if (isCompressed) {
+                // the null byte tells if the entry is compressed and is part of the entry
+                size_t entryLength = *(reinterpret_cast<unsigned int *>(data)) + sizeof(unsigned int) + 1;
+                writer.writeData(data, entryLength, i, thread_idx, false, false);
+            } else {
+                writer.writeData(data, std::max(originalLength, static_cast<size_t>(1)) - 1, i, thread_idx, true, false);
+            }
+            writer.writeIndexEntry(i, writer.getStart(thread_idx), originalLength, thread_idx);
+        }
+    }
+    writer.close(true);
+    DBWriter::writeDbtypeFile(outDb.c_str(), reader.getDbtype(), isCompressed);
+    reader.close();
+}
+
+static void placeKey(DBReader<unsigned int> &seqDbr, unsigned int key, std::vector<bool> &placed,
+                     std::vector<unsigned int> &order, size_t &missing) {
+    size_t seqId = seqDbr.getId(key);
+    if (seqId == UINT_MAX) {
+        missing++;
+    } else if (placed[seqId] == false) {
+        placed[seqId] = true;
+        order.push_back(key);
+    }
+}
+
+int reorderdb(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    DBReader<unsigned int> seqDbr(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX);
+    seqDbr.open(DBReader<unsigned int>::NOSORT);
+    const size_t entryCount = seqDbr.getSize();
+
+    StructureLookup *lookup = NULL;
+    std::vector<size_t> setRuns;
+    std::vector<unsigned int> idToRun;
+    if (FileUtil::fileExists((par.db1 + ".lookup").c_str())) {
+        lookup = new StructureLookup(par.db1, false);
+        lookup->getSetRuns(setRuns);
+        idToRun.resize(lookup->size());
+        for (size_t r = 0; r + 1 < setRuns.size(); r++) {
+            for (size_t j = setRuns[r]; j < setRuns[r + 1]; j++) {
+                idToRun[j] = r;
+            }
+        }
+    }
+
+    // old keys in their new order
+    std::vector<unsigned int> order;
+    order.reserve(entryCount);
+    std::vector<bool> placed(entryCount, false);
+    std::vector<bool> runPlaced(setRuns.size(), false);
+    // chains of one complex have to stay consecutive, so the whole set is placed
+    // at the first cluster that contains any of its chains
+    size_t missing = 0;
+
+    DBReader<unsigned int> cluDbr(par.db2.c_str(), par.db2Index.c_str(), 1, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    cluDbr.open(DBReader<unsigned int>::NOSORT);
+    // clusters are ordered by their representative key to keep the input locality,
+    // representative first, then its members
+    char dbKey[255 + 1];
+    for (size_t i = 0; i < cluDbr.getSize(); i++) {
+        char *data = cluDbr.getData(i, 0);
+        while (*data != '\0') {
+            Util::parseKey(data, dbKey);
+            unsigned int key = Util::fast_atoi<unsigned int>(dbKey);
+            data = Util::skipLine(data);
+            size_t lookupId = (lookup != NULL) ? lookup->getId(key) : SIZE_MAX;
+            if (lookupId == SIZE_MAX) {
+                placeKey(seqDbr, key, placed, order, missing);
+                continue;
+            }
+            unsigned int run = idToRun[lookupId];
+            if (runPlaced[run]) {
+                continue;
+            }
+            runPlaced[run] = true;
+            for (size_t j = setRuns[run]; j < setRuns[run + 1]; j++) {
+                placeKey(seqDbr, lookup->getKey(j), placed, order, missing);
+            }
+        }
+    }
+    cluDbr.close();
+    // entries without a cluster are appended in key order
+    for (size_t i = 0; i < entryCount; i++) {
+        if (placed[i] == false) {
+            order.push_back(seqDbr.getDbKey(i));
+        }
+    }
+    seqDbr.close();
+    if (missing > 0) {
+        Debug(Debug::WARNING) << missing << " cluster members are not contained in " << par.db1 << "\n";
+    }
+
+    const char *suffixes[] = { "", "_ss", "_h", "_ca", "_feat" };
+    for (size_t i = 0; i < ARRAY_SIZE(suffixes); i++) {
+        std::string inDb = par.db1 + suffixes[i];
+        if (FileUtil::fileExists((inDb + ".dbtype").c_str()) == false) {
+            continue;
+        }
+        writeReordered(inDb, par.db3 + suffixes[i], order, par.threads);
+    }
+
+    if (lookup != NULL) {
+        std::string lookupFile = par.db3 + ".lookup";
+        FILE *file = FileUtil::openAndDelete(lookupFile.c_str(), "w");
+        std::string buffer;
+        buffer.reserve(2048);
+        for (size_t i = 0; i < order.size(); i++) {
+            size_t lookupId = lookup->getId(order[i]);
+            if (lookupId == SIZE_MAX) {
+                continue;
+            }
+            buffer.append(SSTR(i));
+            buffer.push_back('\t');
+            buffer.append(lookup->getName(lookupId));
+            buffer.push_back('\t');
+            buffer.append(SSTR(lookup->getSet(lookupId)));
+            buffer.push_back('\n');
+            size_t written = fwrite(buffer.c_str(), sizeof(char), buffer.size(), file);
+            if (written != buffer.size()) {
+                Debug(Debug::ERROR) << "Cannot write to lookup file " << lookupFile << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            buffer.clear();
+        }
+        if (fclose(file) != 0) {
+            Debug(Debug::ERROR) << "Cannot close lookup file " << lookupFile << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        delete lookup;
+        // sets keep their numbers, so the source file stays valid
+        if (FileUtil::fileExists((par.db1 + ".source").c_str())) {
+            FileUtil::copyFile(par.db1 + ".source", par.db3 + ".source");
+        }
+        StructureLookup::writeBinary(par.db3);
+    }
+
+    std::string mappingFile = par.db1 + "_mapping";
+    if (FileUtil::fileExists(mappingFile.c_str())) {
+        std::vector<std::pair<unsigned int, unsigned int>> mapping;
+        Util::readMapping(mappingFile, mapping);
+        std::vector<std::pair<unsigned int, unsigned int>> oldToNew(order.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            oldToNew[i] = std::make_pair(order[i], static_cast<unsigned int>(i));
+        }
+        std::sort(oldToNew.begin(), oldToNew.end());
+        std::vector<std::pair<unsigned int, unsigned int>> remapped;
+        remapped.reserve(mapping.size());
+        for (size_t i = 0; i < mapping.size(); i++) {
+            std::vector<std::pair<unsigned int, unsigned int>>::iterator it =
+                    std::lower_bound(oldToNew.begin(), oldToNew.end(), std::make_pair(mapping[i].first, 0u));
+            if (it != oldToNew.end() && it->first == mapping[i].first) {
+                remapped.push_back(std::make_pair(it->second, mapping[i].second));
+            }
+        }
+        std::sort(remapped.begin(), remapped.end());
+        std::string outMapping = par.db3 + "_mapping";
+        FILE *file = FileUtil::openAndDelete(outMapping.c_str(), "w");
+        char buffer[64];
+        for (size_t i = 0; i < remapped.size(); i++) {
+            char *tmpBuff = Itoa::u32toa_sse2(remapped[i].first, buffer);
+            *(tmpBuff - 1) = '\t';
+            tmpBuff = Itoa::u32toa_sse2(remapped[i].second, tmpBuff);
+            *(tmpBuff - 1) = '\n';
+            size_t length = tmpBuff - buffer;
+            if (fwrite(buffer, sizeof(char), length, file) != length) {
+                Debug(Debug::ERROR) << "Cannot write to mapping file " << outMapping << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+        }
+        if (fclose(file) != 0) {
+            Debug(Debug::ERROR) << "Cannot close mapping file " << outMapping << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+
+    const char *taxSuffixes[] = { "_names.dmp", "_nodes.dmp", "_merged.dmp", "_taxonomy" };
+    for (size_t i = 0; i < ARRAY_SIZE(taxSuffixes); i++) {
+        std::string file = par.db1 + taxSuffixes[i];
+        if (FileUtil::fileExists(file.c_str())) {
+            FileUtil::copyFile(file, par.db3 + taxSuffixes[i]);
+        }
+    }
+
+    if (FileUtil::fileExists((par.db1 + ".idx.dbtype").c_str())) {
+        Debug(Debug::WARNING) << "The precomputed index of " << par.db1 << " is not reordered\n"
+                              << "Run createindex on " << par.db3 << " to create an index in the new order\n";
+    }
+    return EXIT_SUCCESS;
+}
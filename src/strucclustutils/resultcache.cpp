@@ -0,0 +1,344 @@
+// include xxhash early to avoid incompatibilites with SIMDe
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "FileUtil.h"
+#include "Coordinate16.h"
+#include "itoa.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <climits>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+// A result cache is a DB of alignment results with sequential keys. It is only appended to:
+// <cache>.hashes maps the content hash of a query to the key of its result entry and
+// <cache>.lock serializes cachestore runs against each other and against cachelookup.
+
+typedef std::pair<uint64_t, unsigned int> CacheHash;
+
+class QueryHasher {
+public:
+    QueryHasher(const std::string &db, int threads) : caDbr(NULL) {
+        aaDbr = new DBReader<unsigned int>(db.c_str(), (db + ".index").c_str(), threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        aaDbr->open(DBReader<unsigned int>::NOSORT);
+        ssDbr = new DBReader<unsigned int>((db + "_ss").c_str(), (db + "_ss.index").c_str(), threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        ssDbr->open(DBReader<unsigned int>::NOSORT);
+        if (FileUtil::fileExists((db + "_ca.dbtype").c_str())) {
+            caDbr = new DBReader<unsigned int>((db + "_ca").c_str(), (db + "_ca.index").c_str(), threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+            caDbr->open(DBReader<unsigned int>::NOSORT);
+        }
+    }
+
+    ~QueryHasher() {
+        aaDbr->close();
+        delete aaDbr;
+        ssDbr->close();
+        delete ssDbr;
+        if (caDbr != NULL) {
+            caDbr->close();
+            delete caDbr;
+        }
+    }
+
+    DBReader<unsigned int> &getReader() {
+        return *aaDbr;
+    }
+
+    // hash over the amino acid, 3Di and decoded C-alpha data of a chain,
+    // the key and the header of the query do not change its results
+    uint64_t hash(unsigned int key, unsigned int thread_idx, Coordinate16 &coords) {
+        XXH64_state_t state;
+        XXH64_reset(&state, 0);
+        size_t aaId = aaDbr->getId(key);
+        size_t ssId = ssDbr->getId(key);
+        if (aaId == UINT_MAX || ssId == UINT_MAX) {
+            Debug(Debug::ERROR) << "Query " << key << " is missing amino acid or 3Di data\n";
+            EXIT(EXIT_FAILURE);
+        }
+        uint64_t length = aaDbr->getSeqLen(aaId);
+        XXH64_update(&state, &length, sizeof(uint64_t));
+        XXH64_update(&state, aaDbr->getData(aaId, thread_idx), length);
+        XXH64_update(&state, ssDbr->getData(ssId, thread_idx), ssDbr->getSeqLen(ssId));
+        if (caDbr != NULL) {
+            size_t caId = caDbr->getId(key);
+            if (caId != UINT_MAX) {
+                float *ca = coords.read(caDbr->getData(caId, thread_idx), length, caDbr->getEntryLen(caId));
+                XXH64_update(&state, ca, length * 3 * sizeof(float));
+            }
+        }
+        return XXH64_digest(&state);
+    }
+
+private:
+    DBReader<unsigned int> *aaDbr;
+    DBReader<unsigned int> *ssDbr;
+    DBReader<unsigned int> *caDbr;
+};
+
+static int lockCache(const std::string &cacheDb, int operation) {
+    std::string lockFile = cacheDb + ".lock";
+    int fd = open(lockFile.c_str(), O_RDWR | O_CREAT, 0666);
+    if (fd < 0) {
+        Debug(Debug::ERROR) << "Cannot open result cache lock " << lockFile << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (flock(fd, operation) != 0) {
+        Debug(Debug::ERROR) << "Cannot lock result cache " << cacheDb << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+static void unlockCache(int fd) {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+static void readHashes(const std::string &cacheDb, std::vector<CacheHash> &hashes) {
+    std::string hashFile = cacheDb + ".hashes";
+    if (FileUtil::fileExists(hashFile.c_str()) == false) {
+        return;
+    }
+    FILE *file = FileUtil::openFileOrDie(hashFile.c_str(), "r", true);
+    char line[64];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size_t length = strlen(line);
+        if (length == 0 || line[length - 1] != '\n') {
+            break;
+        }
+        char *rest;
+        uint64_t hash = strtoull(line, &rest, 16);
+        unsigned int key = Util::fast_atoi<unsigned int>(rest + 1);
+        hashes.emplace_back(hash, key);
+    }
+    fclose(file);
+    std::sort(hashes.begin(), hashes.end());
+}
+
+static const CacheHash *findHash(const std::vector<CacheHash> &hashes, uint64_t hash) {
+    std::vector<CacheHash>::const_iterator it = std::lower_bound(hashes.begin(), hashes.end(), CacheHash(hash, 0));
+    if (it == hashes.end() || it->first != hash) {
+        return NULL;
+    }
+    return &(*it);
+}
+
+// drops an incomplete last line that an interrupted cachestore left behind
+static void truncatePartialLine(const std::string &fileName) {
+    FILE *file = fopen(fileName.c_str(), "r+");
+    if (file == NULL) {
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    long end = size;
+    while (end > 0) {
+        fseek(file, end - 1, SEEK_SET);
+        if (fgetc(file) == '\n') {
+            break;
+        }
+        end--;
+    }
+    if (end != size && ftruncate(fileno(file), end) != 0) {
+        Debug(Debug::ERROR) << "Cannot truncate " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    fclose(file);
+}
+
+static FILE *openAppend(const std::string &fileName) {
+    FILE *file = fopen(fileName.c_str(), "a");
+    if (file == NULL) {
+        Debug(Debug::ERROR) << "Cannot open " << fileName << " for appending\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return file;
+}
+
+static void appendAndSync(FILE *file, const std::string &fileName, const std::string &buffer) {
+    if (fwrite(buffer.c_str(), sizeof(char), buffer.size(), file) != buffer.size()
+        || fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        Debug(Debug::ERROR) << "Cannot write to " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(file) != 0) {
+        Debug(Debug::ERROR) << "Cannot close " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+int cachelookup(int argc, const char **argv, const Command &command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    QueryHasher hasher(par.db1, par.threads);
+    DBReader<unsigned int> &queryDbr = hasher.getReader();
+
+    int lock = lockCache(par.db2, LOCK_SH);
+    std::vector<CacheHash> hashes;
+    readHashes(par.db2, hashes);
+    DBReader<unsigned int> *cacheDbr = NULL;
+    int dbtype = Parameters::DBTYPE_ALIGNMENT_RES;
+    if (hashes.empty() == false) {
+        cacheDbr = new DBReader<unsigned int>(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        cacheDbr->open(DBReader<unsigned int>::NOSORT);
+        dbtype = cacheDbr->getDbtype();
+    }
+
+    DBWriter writer(par.db3.c_str(), par.db3Index.c_str(), par.threads, par.compressed, dbtype);
+    writer.open();
+    std::vector<unsigned int> missing;
+    Debug::Progress progress(queryDbr.getSize());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        Coordinate16 coords;
+        std::vector<unsigned int> localMissing;
+#pragma omp for schedule(dynamic, 10)
+        for (size_t i = 0; i < queryDbr.getSize(); i++) {
+            progress.updateProgress();
+            unsigned int key = queryDbr.getDbKey(i);
+            const CacheHash *hit = findHash(hashes, hasher.hash(key, thread_idx, coords));
+            size_t cacheId = (hit != NULL) ? cacheDbr->getId(hit->second) : UINT_MAX;
+            if (cacheId == UINT_MAX) {
+                localMissing.push_back(key);
+                continue;
+            }
+            writer.writeData(cacheDbr->getData(cacheId, thread_idx), cacheDbr->getEntryLen(cacheId) - 1, key, thread_idx);
+        }
+#pragma omp critical
+        missing.insert(missing.end(), localMissing.begin(), localMissing.end());
+    }
+    writer.close();
+    if (cacheDbr != NULL) {
+        cacheDbr->close();
+        delete cacheDbr;
+    }
+    unlockCache(lock);
+
+    std::sort(missing.begin(), missing.end());
+    FILE *file = FileUtil::openAndDelete(par.db4.c_str(), "w");
+    char buffer[32];
+    for (size_t i = 0; i < missing.size(); i++) {
+        char *end = Itoa::u32toa_sse2(missing[i], buffer);
+        *(end - 1) = '\n';
+        size_t length = end - buffer;
+        if (fwrite(buffer, sizeof(char), length, file) != length) {
+            Debug(Debug::ERROR) << "Cannot write to " << par.db4 << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+    if (fclose(file) != 0) {
+        Debug(Debug::ERROR) << "Cannot close " << par.db4 << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    Debug(Debug::INFO) << (queryDbr.getSize() - missing.size()) << " of " << queryDbr.getSize() << " queries were found in the result cache\n";
+    return EXIT_SUCCESS;
+}
+
+int cachestore(int argc, const char **argv, const Command &command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    DBReader<unsigned int> resultDbr(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    resultDbr.open(DBReader<unsigned int>::NOSORT);
+
+    // hashes are computed before taking the lock, so that concurrent lookups are not blocked
+    std::vector<CacheHash> entries(resultDbr.getSize());
+    {
+        QueryHasher hasher(par.db1, par.threads);
+#pragma omp parallel
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+            Coordinate16 coords;
+#pragma omp for schedule(dynamic, 10)
+            for (size_t i = 0; i < resultDbr.getSize(); i++) {
+                entries[i] = CacheHash(hasher.hash(resultDbr.getDbKey(i), thread_idx, coords), static_cast<unsigned int>(i));
+            }
+        }
+    }
+    // identical queries in one search are stored once
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const CacheHash &a, const CacheHash &b) { return a.first == b.first; }), entries.end());
+
+    int lock = lockCache(par.db3, LOCK_EX);
+    std::string indexFile = par.db3Index;
+    std::string hashFile = par.db3 + ".hashes";
+    truncatePartialLine(indexFile);
+    truncatePartialLine(hashFile);
+
+    std::vector<CacheHash> hashes;
+    readHashes(par.db3, hashes);
+    unsigned int nextKey = 0;
+    if (FileUtil::fileExists(indexFile.c_str()) && FileUtil::getFileSize(indexFile) > 0) {
+        DBReader<unsigned int> cacheDbr(par.db3.c_str(), indexFile.c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+        cacheDbr.open(DBReader<unsigned int>::HARDNOSORT);
+        nextKey = cacheDbr.getLastKey() + 1;
+        cacheDbr.close();
+    }
+    if (FileUtil::fileExists((par.db3 + ".dbtype").c_str()) == false) {
+        DBWriter::writeDbtypeFile(par.db3.c_str(), resultDbr.getDbtype(), false);
+    }
+
+    // new results keep their order in the result DB
+    std::vector<CacheHash> stored;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (findHash(hashes, entries[i].first) == NULL) {
+            stored.push_back(entries[i]);
+        }
+    }
+    std::sort(stored.begin(), stored.end(),
+              [](const CacheHash &a, const CacheHash &b) { return a.second < b.second; });
+
+    FILE *dataFile = openAppend(par.db3);
+    fseek(dataFile, 0, SEEK_END);
+    size_t offset = ftell(dataFile);
+    std::string data;
+    std::string index;
+    std::string hashLines;
+    char buffer[64];
+    for (size_t i = 0; i < stored.size(); i++) {
+        size_t resultId = stored[i].second;
+        unsigned int cacheKey = nextKey++;
+        const char *entry = resultDbr.getData(resultId, 0);
+        size_t length = strlen(entry) + 1;
+        data.append(entry, length);
+        index.append(SSTR(cacheKey));
+        index.push_back('\t');
+        index.append(SSTR(offset));
+        index.push_back('\t');
+        index.append(SSTR(length));
+        index.push_back('\n');
+        offset += length;
+        snprintf(buffer, sizeof(buffer), "%016" PRIx64 "\t%u\n", stored[i].first, cacheKey);
+        hashLines.append(buffer);
+    }
+    // the data has to be on disk before the index points to it and the index before the hashes refer to it
+    appendAndSync(dataFile, par.db3, data);
+    appendAndSync(openAppend(indexFile), indexFile, index);
+    appendAndSync(openAppend(hashFile), hashFile, hashLines);
+    unlockCache(lock);
+
+    Debug(Debug::INFO) << "Stored " << stored.size() << " of " << resultDbr.getSize() << " results in the result cache\n";
+    resultDbr.close();
+    return EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 #include "TMaligner.h"
 #include "Coordinate16.h"
 #include "MultimerUtil.h"
+#include "tmalign/TMalign.h"
 #include "set"
 
 #ifdef OPENMP
@@ -61,6 +62,100 @@ struct SearchResult {
     }
 };
 
+// rotation/translation superposing db onto q (Horn's quaternion method on the summed cross-covariance)
+static void kabschFromStats(const SuperpositionStats &stats, float u[3][3], float t[3]) {
+    for (size_t a = 0; a < 3; a++) {
+        for (size_t b = 0; b < 3; b++) {
+            u[a][b] = (a == b) ? 1.0f : 0.0f;
+        }
+        t[a] = 0.0f;
+    }
+    if (stats.count < 1.0) {
+        return;
+    }
+    double qMean[3];
+    double dbMean[3];
+    for (size_t a = 0; a < 3; a++) {
+        qMean[a] = stats.qSum[a] / stats.count;
+        dbMean[a] = stats.dbSum[a] / stats.count;
+    }
+    double S[3][3];
+    for (size_t a = 0; a < 3; a++) {
+        for (size_t b = 0; b < 3; b++) {
+            S[a][b] = stats.cross[a][b] - stats.count * dbMean[a] * qMean[b];
+        }
+    }
+    double N[4][4] = {
+        {S[0][0] + S[1][1] + S[2][2], S[1][2] - S[2][1], S[2][0] - S[0][2], S[0][1] - S[1][0]},
+        {S[1][2] - S[2][1], S[0][0] - S[1][1] - S[2][2], S[0][1] + S[1][0], S[2][0] + S[0][2]},
+        {S[2][0] - S[0][2], S[0][1] + S[1][0], -S[0][0] + S[1][1] - S[2][2], S[1][2] + S[2][1]},
+        {S[0][1] - S[1][0], S[2][0] + S[0][2], S[1][2] + S[2][1], -S[0][0] - S[1][1] + S[2][2]}
+    };
+    // cyclic Jacobi eigen decomposition of the symmetric 4x4 matrix
+    double V[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+    for (int sweep = 0; sweep < 50; sweep++) {
+        double offDiag = 0.0;
+        for (int p = 0; p < 3; p++) {
+            for (int q = p + 1; q < 4; q++) {
+                offDiag += N[p][q] * N[p][q];
+            }
+        }
+        if (offDiag < 1e-18) {
+            break;
+        }
+        for (int p = 0; p < 3; p++) {
+            for (int q = p + 1; q < 4; q++) {
+                if (std::fabs(N[p][q]) < 1e-30) {
+                    continue;
+                }
+                double theta = (N[q][q] - N[p][p]) / (2.0 * N[p][q]);
+                double tn = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                double cs = 1.0 / std::sqrt(tn * tn + 1.0);
+                double sn = tn * cs;
+                for (int k = 0; k < 4; k++) {
+                    double nkp = N[k][p];
+                    double nkq = N[k][q];
+                    N[k][p] = cs * nkp - sn * nkq;
+                    N[k][q] = sn * nkp + cs * nkq;
+                }
+                for (int k = 0; k < 4; k++) {
+                    double npk = N[p][k];
+                    double nqk = N[q][k];
+                    N[p][k] = cs * npk - sn * nqk;
+                    N[q][k] = sn * npk + cs * nqk;
+                }
+                for (int k = 0; k < 4; k++) {
+                    double vkp = V[k][p];
+                    double vkq = V[k][q];
+                    V[k][p] = cs * vkp - sn * vkq;
+                    V[k][q] = sn * vkp + cs * vkq;
+                }
+            }
+        }
+    }
+    int best = 0;
+    for (int k = 1; k < 4; k++) {
+        if (N[k][k] > N[best][best]) {
+            best = k;
+        }
+    }
+    const double q0 = V[0][best];
+    const double q1 = V[1][best];
+    const double q2 = V[2][best];
+    const double q3 = V[3][best];
+    double R[3][3] = {
+        {q0 * q0 + q1 * q1 - q2 * q2 - q3 * q3, 2.0 * (q1 * q2 - q0 * q3), 2.0 * (q1 * q3 + q0 * q2)},
+        {2.0 * (q1 * q2 + q0 * q3), q0 * q0 - q1 * q1 + q2 * q2 - q3 * q3, 2.0 * (q2 * q3 - q0 * q1)},
+        {2.0 * (q1 * q3 - q0 * q2), 2.0 * (q2 * q3 + q0 * q1), q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3}
+    };
+    for (size_t a = 0; a < 3; a++) {
+        for (size_t b = 0; b < 3; b++) {
+            u[a][b] = R[a][b];
+        }
+        t[a] = qMean[a] - (R[a][0] * dbMean[0] + R[a][1] * dbMean[1] + R[a][2] * dbMean[2]);
+    }
+}
+
 // compute complex tm score
 // carrying final output lines
 struct Assignment {
@@ -83,9 +178,11 @@ struct Assignment {
     std::string assignmentInfo;
     std::vector<resultToWriteWithKey_t> resultToWriteLines;
     TMaligner::TMscoreResult tmResult;
+    SuperpositionStats stats;
 
     void appendChainToChainAln(ChainToChainAln &aln) {
         matches += aln.matches;
+        stats.add(aln.stats);
         qCaXVec.insert(qCaXVec.end(), aln.qChain.caVecX.begin(), aln.qChain.caVecX.end());
         qCaYVec.insert(qCaYVec.end(), aln.qChain.caVecY.begin(), aln.qChain.caVecY.end());
         qCaZVec.insert(qCaZVec.end(), aln.qChain.caVecZ.begin(), aln.qChain.caVecZ.end());
@@ -106,6 +203,41 @@ struct Assignment {
         resultToWriteLines.clear();
         uString.clear();
         tString.clear();
+        stats.reset();
+    }
+
+    // TM-score of the Kabsch superposition built from the summed per-chain statistics, no TM-score search
+    void getKabschTmScore() {
+        unsigned int normLen = std::min(qResidueLength, dbResidueLength);
+        float u[3][3];
+        float t[3];
+        kabschFromStats(stats, u, t);
+        float D0_MIN, Lnorm, d0, d0_search;
+        parameter_set4final(normLen, D0_MIN, Lnorm, d0, d0_search);
+        const double d0Sq = d0 * d0;
+        double tmSum = 0.0;
+        double squaredDist = 0.0;
+        for (size_t i = 0; i < matches; i++) {
+            double x = t[0] + u[0][0] * dbCaXVec[i] + u[0][1] * dbCaYVec[i] + u[0][2] * dbCaZVec[i];
+            double y = t[1] + u[1][0] * dbCaXVec[i] + u[1][1] * dbCaYVec[i] + u[1][2] * dbCaZVec[i];
+            double z = t[2] + u[2][0] * dbCaXVec[i] + u[2][1] * dbCaYVec[i] + u[2][2] * dbCaZVec[i];
+            double d = (x - qCaXVec[i]) * (x - qCaXVec[i]) + (y - qCaYVec[i]) * (y - qCaYVec[i]) + (z - qCaZVec[i]) * (z - qCaZVec[i]);
+            tmSum += 1.0 / (1.0 + d / d0Sq);
+            squaredDist += d;
+        }
+        double rmsd = matches > 0 ? std::sqrt(squaredDist / matches) : 0.0;
+        tmResult = TMaligner::TMscoreResult(u, t, tmSum / Lnorm, rmsd);
+        qTmScore = tmResult.tmscore * normLen / qResidueLength;
+        dbTmScore = tmResult.tmscore * normLen / dbResidueLength;
+    }
+
+    void clearCoordinates() {
+        qCaXVec.clear();
+        qCaYVec.clear();
+        qCaZVec.clear();
+        dbCaXVec.clear();
+        dbCaYVec.clear();
+        dbCaZVec.clear();
     }
 
     void getTmScore(TMaligner &tmAligner) {
@@ -177,6 +309,14 @@ bool compareNeighborWithDist(const NeighborsWithDist &first, const NeighborsWith
     return false;
 }
 
+bool compareNeighborWithDistAndIdx(const NeighborsWithDist &first, const NeighborsWithDist &second) {
+    if (first.dist < second.dist)
+        return true;
+    if (first.dist > second.dist)
+        return false;
+    return first.neighbor < second.neighbor;
+}
+
 class DBSCANCluster {
 public:
     DBSCANCluster(SearchResult &searchResult, std::set<cluster_t> &finalClusters, double minCov) : searchResult(searchResult), finalClusters(finalClusters) {
@@ -192,7 +332,7 @@ public:
     bool getAlnClusters() {
         // rbh filter
         filterAlnsByRBH();
-        fillDistMap();
+        fillDistances();
         // To skip DBSCAN clustering when alignments are few enough.
         if (searchResult.alnVec.size() <= idealClusterSize)
             return checkClusteringNecessity();
@@ -215,7 +355,11 @@ private:
     std::vector<NeighborsWithDist> neighborsWithDist;
     std::set<unsigned int> qFoundChainKeys;
     std::set<unsigned int> dbFoundChainKeys;
-    distMap_t distMap;
+    // pairwise distances (n x n) and, per alignment, all other alignments by increasing distance
+    // computed once and shared by every eps the clustering is retried with
+    std::vector<float> distMatrix;
+    std::vector<std::vector<NeighborsWithDist>> sortedNeighbors;
+    std::vector<unsigned char> inNeighbors;
     std::vector<cluster_t> currClusters;
     std::set<cluster_t> &finalClusters;
     std::map<unsigned int, float> qBestTmScore;
@@ -235,6 +379,10 @@ private:
             if (neighbors.size() < MIN_PTS)
                 continue;
 
+            for (auto neighbor : neighbors) {
+                inNeighbors[neighbor] = 1;
+            }
+
             centerAln.label = ++cLabel;
             size_t neighborIdx = 0;
             while (neighborIdx < neighbors.size()) {
@@ -249,10 +397,15 @@ private:
                     continue;
 
                 for (auto neighbor : neighborsOfCurrNeighbor) {
-                    if (std::find(neighbors.begin(), neighbors.end(), neighbor) == neighbors.end())
+                    if (inNeighbors[neighbor] == 0) {
+                        inNeighbors[neighbor] = 1;
                         neighbors.emplace_back(neighbor);
+                    }
                 }
             }
+            for (auto neighbor : neighbors) {
+                inNeighbors[neighbor] = 0;
+            }
             if (neighbors.size() > idealClusterSize || checkChainRedundancy())
                 getNearestNeighbors(centerAlnIdx);
 
@@ -287,33 +440,51 @@ private:
         return runDBSCAN();
     }
 
-    void fillDistMap() {
+    float getDist(size_t i, size_t j) const {
+        return distMatrix[i * searchResult.alnVec.size() + j];
+    }
+
+    void fillDistances() {
         float dist;
-        distMap.clear();
-        for (size_t i=0; i < searchResult.alnVec.size(); i++) {
+        const size_t alnNum = searchResult.alnVec.size();
+        distMatrix.assign(alnNum * alnNum, 0.0f);
+        for (size_t i=0; i < alnNum; i++) {
             ChainToChainAln &prevAln = searchResult.alnVec[i];
-            for (size_t j = i+1; j < searchResult.alnVec.size(); j++) {
+            for (size_t j = i+1; j < alnNum; j++) {
                 ChainToChainAln &currAln = searchResult.alnVec[j];
                 dist = prevAln.getDistance(currAln);
                 maxDist = std::max(maxDist, dist);
-                distMap.insert({{i,j}, dist});
+                distMatrix[i * alnNum + j] = dist;
+                distMatrix[j * alnNum + i] = dist;
+            }
+        }
+        sortedNeighbors.resize(alnNum);
+        for (size_t i = 0; i < alnNum; i++) {
+            std::vector<NeighborsWithDist> &sorted = sortedNeighbors[i];
+            sorted.clear();
+            sorted.reserve(alnNum - 1);
+            for (size_t j = 0; j < alnNum; j++) {
+                if (i == j)
+                    continue;
+                dist = getDist(i, j);
+                // NaN never fails the eps test, keep it in front
+                sorted.emplace_back(j, std::isnan(dist) ? -1.0f : dist);
             }
+            SORT_SERIAL(sorted.begin(), sorted.end(), compareNeighborWithDistAndIdx);
         }
+        inNeighbors.assign(alnNum, 0);
     }
 
+    // eps-neighborhood: center first, then neighbors by increasing index
     void getNeighbors(size_t centerIdx, std::vector<unsigned int> &neighborVec) {
         neighborVec.clear();
         neighborVec.emplace_back(centerIdx);
-        for (size_t neighborIdx = 0; neighborIdx < searchResult.alnVec.size(); neighborIdx++) {
-
-            if (neighborIdx == centerIdx)
-                continue;
-
-            if (distMap[{std::min(centerIdx, neighborIdx), std::max(centerIdx, neighborIdx)}] >= eps)
-                continue;
-
-            neighborVec.emplace_back(neighborIdx);
+        for (auto &neighbor : sortedNeighbors[centerIdx]) {
+            if (neighbor.dist >= eps)
+                break;
+            neighborVec.emplace_back(neighbor.neighbor);
         }
+        SORT_SERIAL(neighborVec.begin() + 1, neighborVec.end());
     }
 
     void initializeAlnLabels() {
@@ -366,7 +537,9 @@ private:
         dbBestTmScore.clear();
         qFoundChainKeys.clear();
         dbFoundChainKeys.clear();
-        distMap.clear();
+        distMatrix.clear();
+        sortedNeighbors.clear();
+        inNeighbors.clear();
 //        auto it = finalClusters.begin();
 //        while (it != finalClusters.end()) {
 //            if (it->size() < clusterSizeThr) {
@@ -425,7 +598,7 @@ private:
         for (auto neighborIdx: neighbors) {
             if (neighborIdx == centerIdx)
                 continue;
-            neighborsWithDist.emplace_back(neighborIdx, distMap[{std::min(centerIdx, neighborIdx), std::max(centerIdx, neighborIdx)}]);
+            neighborsWithDist.emplace_back(neighborIdx, getDist(centerIdx, neighborIdx));
         }
         SORT_SERIAL(neighborsWithDist.begin(), neighborsWithDist.end(), compareNeighborWithDist);
         neighbors.clear();
@@ -539,15 +712,27 @@ public:
             return;
         }
         assignment = Assignment(searchResult.qResidueLen, searchResult.dbResidueLen);
+        // rank assignments by their Kabsch superposition first,
+        // the full TM-score search only runs on the best ones
+        const size_t firstAssignment = assignments.size();
+        double bestKabschTmScore = 0.0;
         for (auto &cluster: finalClusters) {
             for (auto alnIdx: cluster) {
                 assignment.appendChainToChainAln(searchResult.alnVec[alnIdx]);
             }
-            assignment.getTmScore(*tmAligner);
-            assignment.updateResultToWriteLines();
+            assignment.getKabschTmScore();
+            bestKabschTmScore = std::max(bestKabschTmScore, assignment.qTmScore);
             assignments.emplace_back(assignment);
             assignment.reset();
         }
+        for (size_t i = firstAssignment; i < assignments.size(); i++) {
+            if (assignments[i].qTmScore >= bestKabschTmScore * ASSIGNMENT_REFINE_MARGIN) {
+                assignments[i].getTmScore(*tmAligner);
+            } else {
+                assignments[i].clearCoordinates();
+            }
+            assignments[i].updateResultToWriteLines();
+        }
         finalClusters.clear();
     }
 
@@ -625,7 +810,6 @@ int scoremultimer(int argc, const char **argv, const Command &command) {
     DBWriter resultWriter(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed, dbType);
     resultWriter.open();
 
-    const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
 
     std::string t3DiDbrName =  StructureUtil::getIndexWithSuffix(par.db2, "_ss");
     bool is3DiIdx = Parameters::isEqualDbtype(FileUtil::parseDbType(t3DiDbrName.c_str()), Parameters::DBTYPE_INDEX_DB);
@@ -633,7 +817,7 @@ int scoremultimer(int argc, const char **argv, const Command &command) {
             is3DiIdx ? t3DiDbrName : par.db2,
             par.threads,
             needSrc ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-            touch ? IndexReader::PRELOAD_INDEX : 0,
+            IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
             DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
             needSrc ? "_seq_ss" : "_ss"
     );
@@ -643,7 +827,7 @@ int scoremultimer(int argc, const char **argv, const Command &command) {
             needSrc
             ? IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB2)
             : IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-            touch ? IndexReader::PRELOAD_INDEX : 0,
+            IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
             DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
             needSrc ? "_seq_ca" : "_ca"
     );
@@ -658,14 +842,14 @@ int scoremultimer(int argc, const char **argv, const Command &command) {
         q3DiDbr = new IndexReader(
                 StructureUtil::getIndexWithSuffix(par.db1, "_ss"),
                 par.threads, IndexReader::SEQUENCES,
-                touch ? IndexReader::PRELOAD_INDEX : 0,
+                IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
                 DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA
         );
         qCaDbr = new IndexReader(
                 par.db1,
                 par.threads,
                 IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-                touch ? IndexReader::PRELOAD_INDEX : 0,
+                IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
                 DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                 "_ca"
         );
@@ -679,10 +863,8 @@ int scoremultimer(int argc, const char **argv, const Command &command) {
     chainKeyToComplexId_t dbChainKeyToComplexIdMap;
     complexIdToChainKeys_t dbComplexIdToChainKeysMap;
     complexIdToChainKeys_t qComplexIdToChainKeysMap;
-    std::string qLookupFile = par.db1 + ".lookup";
-    std::string dbLookupFile = par.db2 + ".lookup";
-    getKeyToIdMapIdToKeysMapIdVec(qLookupFile, qChainKeyToComplexIdMap, qComplexIdToChainKeysMap, qComplexIndices);
-    getKeyToIdMapIdToKeysMapIdVec(dbLookupFile, dbChainKeyToComplexIdMap, dbComplexIdToChainKeysMap, dbComplexIndices);
+    getKeyToIdMapIdToKeysMapIdVec(par.db1, qChainKeyToComplexIdMap, qComplexIdToChainKeysMap, qComplexIndices);
+    getKeyToIdMapIdToKeysMapIdVec(par.db2, dbChainKeyToComplexIdMap, dbComplexIdToChainKeysMap, dbComplexIndices);
     qChainKeyToComplexIdMap.clear();
     dbComplexIndices.clear();
     Debug::Progress progress(qComplexIndices.size());
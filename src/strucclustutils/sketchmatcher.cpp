@@ -0,0 +1,395 @@
+// include xxhash early to avoid incompatibilites with SIMDe
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "FileUtil.h"
+#include "LocalParameters.h"
+#include "QueryMatcher.h"
+#include "FastSort.h"
+
+#include <climits>
+#include <cstdint>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+// Candidate pairs for linclust-style clustering from one-permutation MinHash sketches of the
+// combined 3Di+AA k-mer set of each entry. Entries sharing all values of an LSH band form a
+// bucket; the longest entry of a bucket becomes its center and every other entry is emitted
+// as a hit of the center with the diagonal of the band's first shared k-mer.
+// Output is the same prefilter format kmermatcher writes for structurerescorediagonal.
+
+const uint32_t SKETCH_EMPTY = UINT32_MAX;
+// k, sketch size, entry length, followed by the XXH64 of the sketched aa and 3Di residues
+const size_t SKETCH_ENTRY_HEADER = 3 * sizeof(uint32_t) + sizeof(uint64_t);
+
+static inline uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+struct BandEntry {
+    uint64_t hash;
+    unsigned int id;
+    unsigned int length;
+    unsigned short pos;
+
+    static bool compareByHashLength(const BandEntry &first, const BandEntry &second) {
+        if (first.hash != second.hash) {
+            return first.hash < second.hash;
+        }
+        if (first.length != second.length) {
+            return first.length > second.length;
+        }
+        return first.id < second.id;
+    }
+};
+
+struct SketchPair {
+    unsigned int center;
+    unsigned int member;
+    short diagonal;
+
+    static bool compareByCenterMember(const SketchPair &first, const SketchPair &second) {
+        if (first.center != second.center) {
+            return first.center < second.center;
+        }
+        if (first.member != second.member) {
+            return first.member < second.member;
+        }
+        return first.diagonal < second.diagonal;
+    }
+};
+
+// one-permutation hashing with rotation densification, empty bins only remain if the entry is shorter than k
+static void computeSketch(const char *aa, const char *ss, size_t length, int kmerSize, int sketchSize,
+                          uint32_t *hashes, unsigned short *positions) {
+    std::fill(hashes, hashes + sketchSize, SKETCH_EMPTY);
+    std::fill(positions, positions + sketchSize, 0);
+    if (length < static_cast<size_t>(kmerSize)) {
+        return;
+    }
+    const uint64_t base = 0x100000001b3ULL;
+    uint64_t basePow = 1;
+    for (int i = 0; i < kmerSize; i++) {
+        basePow *= base;
+    }
+    uint64_t rolling = 0;
+    for (size_t i = 0; i < length; i++) {
+        const uint64_t symbol = (static_cast<uint64_t>(static_cast<unsigned char>(aa[i])) << 8) | static_cast<unsigned char>(ss[i]);
+        rolling = rolling * base + symbol;
+        if (i >= static_cast<size_t>(kmerSize)) {
+            const uint64_t out = (static_cast<uint64_t>(static_cast<unsigned char>(aa[i - kmerSize])) << 8) | static_cast<unsigned char>(ss[i - kmerSize]);
+            rolling -= out * basePow;
+        }
+        if (i + 1 < static_cast<size_t>(kmerSize)) {
+            continue;
+        }
+        const uint64_t h = mix64(rolling);
+        const size_t bin = ((h >> 32) * static_cast<uint64_t>(sketchSize)) >> 32;
+        // SKETCH_EMPTY is reserved
+        const uint32_t value = std::min(static_cast<uint32_t>(h), SKETCH_EMPTY - 1);
+        if (value < hashes[bin]) {
+            hashes[bin] = value;
+            positions[bin] = static_cast<unsigned short>(std::min(i + 1 - kmerSize, static_cast<size_t>(USHRT_MAX)));
+        }
+    }
+    for (int bin = 0; bin < sketchSize; bin++) {
+        if (hashes[bin] != SKETCH_EMPTY) {
+            continue;
+        }
+        for (int dist = 1; dist < sketchSize; dist++) {
+            const int from = (bin + dist) % sketchSize;
+            if (hashes[from] != SKETCH_EMPTY) {
+                uint32_t value = static_cast<uint32_t>(mix64(static_cast<uint64_t>(hashes[from]) + dist));
+                hashes[bin] = std::min(value, SKETCH_EMPTY - 1);
+                positions[bin] = positions[from];
+                break;
+            }
+        }
+    }
+}
+
+static uint64_t hashEntry(const char *aa, const char *ss, size_t length) {
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    XXH64_update(&state, aa, length);
+    XXH64_update(&state, ss, length);
+    return XXH64_digest(&state);
+}
+
+// returns true if the sidecar entry was written for the same k, sketch size, entry length and content
+static bool readSketch(const char *data, size_t entryLen, int kmerSize, int sketchSize, unsigned int length,
+                       uint64_t contentHash, uint32_t *hashes, unsigned short *positions) {
+    const size_t expected = SKETCH_ENTRY_HEADER + sketchSize * (sizeof(uint32_t) + sizeof(unsigned short));
+    if (entryLen != expected) {
+        return false;
+    }
+    uint32_t header[3];
+    memcpy(header, data, sizeof(header));
+    uint64_t storedHash;
+    memcpy(&storedHash, data + sizeof(header), sizeof(uint64_t));
+    if (header[0] != static_cast<uint32_t>(kmerSize) || header[1] != static_cast<uint32_t>(sketchSize) || header[2] != length
+        || storedHash != contentHash) {
+        return false;
+    }
+    data += SKETCH_ENTRY_HEADER;
+    memcpy(hashes, data, sketchSize * sizeof(uint32_t));
+    data += sketchSize * sizeof(uint32_t);
+    memcpy(positions, data, sketchSize * sizeof(unsigned short));
+    return true;
+}
+
+static void writeSketch(std::vector<char> &buffer, int kmerSize, int sketchSize, unsigned int length,
+                        uint64_t contentHash, const uint32_t *hashes, const unsigned short *positions) {
+    buffer.resize(SKETCH_ENTRY_HEADER + sketchSize * (sizeof(uint32_t) + sizeof(unsigned short)));
+    const uint32_t header[3] = {static_cast<uint32_t>(kmerSize), static_cast<uint32_t>(sketchSize), length};
+    char *p = buffer.data();
+    memcpy(p, header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, &contentHash, sizeof(uint64_t));
+    p += sizeof(uint64_t);
+    memcpy(p, hashes, sketchSize * sizeof(uint32_t));
+    p += sketchSize * sizeof(uint32_t);
+    memcpy(p, positions, sketchSize * sizeof(unsigned short));
+}
+
+int sketchmatcher(int argc, const char **argv, const Command &command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    if (par.sketchBands <= 0 || par.sketchSize % par.sketchBands != 0) {
+        Debug(Debug::ERROR) << "--sketch-size " << par.sketchSize << " must be a multiple of --sketch-bands " << par.sketchBands << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    const int sketchSize = par.sketchSize;
+    const int bands = par.sketchBands;
+    const int rows = sketchSize / bands;
+    const int kmerSize = par.sketchKmerSize;
+
+    DBReader<unsigned int> aaDbr(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    aaDbr.open(DBReader<unsigned int>::NOSORT);
+    std::string ssDb = par.db1 + "_ss";
+    DBReader<unsigned int> ssDbr(ssDb.c_str(), (ssDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    ssDbr.open(DBReader<unsigned int>::NOSORT);
+
+    // sketches of a previous run are reused for entries with unchanged key, length and content,
+    // the sidecar is then rewritten to hold exactly the entries of this run
+    DBReader<unsigned int> *sketchDbr = NULL;
+    if (par.sketchDb.empty() == false && FileUtil::fileExists((par.sketchDb + ".dbtype").c_str())) {
+        sketchDbr = new DBReader<unsigned int>(par.sketchDb.c_str(), (par.sketchDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        sketchDbr->open(DBReader<unsigned int>::NOSORT);
+    }
+    DBWriter *sketchWriter = NULL;
+    std::string sketchOut = par.sketchDb + "_tmp";
+    if (par.sketchDb.empty() == false) {
+        sketchWriter = new DBWriter(sketchOut.c_str(), (sketchOut + ".index").c_str(), par.threads, false, Parameters::DBTYPE_GENERIC_DB);
+        sketchWriter->open();
+    }
+
+    const size_t dbSize = aaDbr.getSize();
+    BandEntry *bandEntries = new BandEntry[dbSize * bands];
+    size_t recomputed = 0;
+    Debug(Debug::INFO) << "Sketching " << dbSize << " entries\n";
+    Debug::Progress progress(dbSize);
+#pragma omp parallel reduction(+:recomputed)
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<uint32_t> hashes(sketchSize);
+        std::vector<unsigned short> positions(sketchSize);
+        std::vector<char> buffer;
+#pragma omp for schedule(dynamic, 100)
+        for (size_t id = 0; id < dbSize; id++) {
+            progress.updateProgress();
+            const unsigned int key = aaDbr.getDbKey(id);
+            const unsigned int length = aaDbr.getSeqLen(id);
+            size_t ssId = ssDbr.getId(key);
+            if (ssId == UINT_MAX) {
+                Debug(Debug::ERROR) << "Entry " << key << " is missing in " << ssDb << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            const char *aa = aaDbr.getData(id, thread_idx);
+            const char *ss = ssDbr.getData(ssId, thread_idx);
+            const size_t sketchLength = std::min(static_cast<size_t>(length), ssDbr.getSeqLen(ssId));
+            const uint64_t contentHash = (sketchDbr != NULL || sketchWriter != NULL) ? hashEntry(aa, ss, sketchLength) : 0;
+            bool found = false;
+            if (sketchDbr != NULL) {
+                size_t sketchId = sketchDbr->getId(key);
+                if (sketchId != UINT_MAX) {
+                    found = readSketch(sketchDbr->getData(sketchId, thread_idx), sketchDbr->getEntryLen(sketchId) - 1,
+                                       kmerSize, sketchSize, length, contentHash, hashes.data(), positions.data());
+                }
+            }
+            if (found == false) {
+                computeSketch(aa, ss, sketchLength, kmerSize, sketchSize, hashes.data(), positions.data());
+                recomputed++;
+            }
+            if (sketchWriter != NULL) {
+                writeSketch(buffer, kmerSize, sketchSize, length, contentHash, hashes.data(), positions.data());
+                sketchWriter->writeData(buffer.data(), buffer.size(), key, thread_idx);
+            }
+
+            for (int band = 0; band < bands; band++) {
+                BandEntry &entry = bandEntries[id * bands + band];
+                entry.id = id;
+                entry.length = length;
+                entry.pos = positions[band * rows];
+                uint64_t h = mix64(band + 1);
+                bool empty = true;
+                for (int row = 0; row < rows; row++) {
+                    const uint32_t value = hashes[band * rows + row];
+                    empty &= value == SKETCH_EMPTY;
+                    h = mix64(h ^ value);
+                }
+                // too short for a single k-mer, never matches
+                entry.hash = empty ? UINT64_MAX : h;
+            }
+        }
+    }
+    if (sketchDbr != NULL) {
+        sketchDbr->close();
+        delete sketchDbr;
+    }
+    if (sketchWriter != NULL) {
+        sketchWriter->close(true);
+        delete sketchWriter;
+        DBReader<unsigned int>::removeDb(par.sketchDb);
+        DBReader<unsigned int>::moveDb(sketchOut, par.sketchDb);
+    }
+    Debug(Debug::INFO) << "Computed " << recomputed << " sketches, reused " << (dbSize - recomputed) << "\n";
+
+    const size_t totalBandEntries = dbSize * bands;
+    SORT_PARALLEL(bandEntries, bandEntries + totalBandEntries, BandEntry::compareByHashLength);
+
+    // every bucket is a star around its longest entry, the number of pairs stays linear in the number of entries
+    std::vector<SketchPair> pairs;
+#pragma omp parallel
+    {
+        std::vector<SketchPair> threadPairs;
+        unsigned int thread_idx = 0;
+        unsigned int threads = 1;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+        threads = static_cast<unsigned int>(omp_get_num_threads());
+#endif
+        // split on bucket boundaries
+        size_t start = (totalBandEntries * thread_idx) / threads;
+        size_t end = (totalBandEntries * (thread_idx + 1)) / threads;
+        while (start > 0 && start < totalBandEntries && bandEntries[start].hash == bandEntries[start - 1].hash) {
+            start++;
+        }
+        while (end > 0 && end < totalBandEntries && bandEntries[end].hash == bandEntries[end - 1].hash) {
+            end++;
+        }
+        for (size_t i = start; i < end;) {
+            size_t bucketEnd = i + 1;
+            while (bucketEnd < totalBandEntries && bandEntries[bucketEnd].hash == bandEntries[i].hash) {
+                bucketEnd++;
+            }
+            if (bandEntries[i].hash != UINT64_MAX) {
+                const BandEntry &center = bandEntries[i];
+                for (size_t j = i + 1; j < bucketEnd; j++) {
+                    SketchPair pair;
+                    pair.center = center.id;
+                    pair.member = bandEntries[j].id;
+                    pair.diagonal = static_cast<short>(static_cast<int>(center.pos) - static_cast<int>(bandEntries[j].pos));
+                    threadPairs.emplace_back(pair);
+                }
+            }
+            i = bucketEnd;
+        }
+#pragma omp critical
+        pairs.insert(pairs.end(), threadPairs.begin(), threadPairs.end());
+    }
+    delete[] bandEntries;
+    SORT_PARALLEL(pairs.begin(), pairs.end(), SketchPair::compareByCenterMember);
+    Debug(Debug::INFO) << "Found " << pairs.size() << " band matches\n";
+
+    std::vector<size_t> centerStarts;
+    for (size_t i = 0; i < pairs.size(); i++) {
+        if (i == 0 || pairs[i].center != pairs[i - 1].center) {
+            centerStarts.emplace_back(i);
+        }
+    }
+    centerStarts.emplace_back(pairs.size());
+
+    DBWriter dbw(par.db2.c_str(), par.db2Index.c_str(), par.threads, par.compressed, Parameters::DBTYPE_PREFILTER_RES);
+    dbw.open();
+    std::vector<char> isCenter(dbSize, false);
+    const size_t centerCount = centerStarts.size() - 1;
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        char buffer[100];
+        std::string result;
+        std::vector<hit_t> hits;
+#pragma omp for schedule(dynamic, 10)
+        for (size_t c = 0; c < centerCount; c++) {
+            const unsigned int centerId = pairs[centerStarts[c]].center;
+            const unsigned int centerKey = aaDbr.getDbKey(centerId);
+            hits.clear();
+            // number of bands shared with the center is the score
+            for (size_t i = centerStarts[c]; i < centerStarts[c + 1];) {
+                size_t next = i + 1;
+                while (next < centerStarts[c + 1] && pairs[next].member == pairs[i].member) {
+                    next++;
+                }
+                hit_t h;
+                h.seqId = aaDbr.getDbKey(pairs[i].member);
+                h.prefScore = static_cast<int>(next - i);
+                h.diagonal = static_cast<unsigned short>(pairs[i].diagonal);
+                hits.emplace_back(h);
+                i = next;
+            }
+            SORT_SERIAL(hits.begin(), hits.end(), hit_t::compareHitsByScoreAndId);
+
+            result.clear();
+            hit_t self;
+            self.seqId = centerKey;
+            self.prefScore = 0;
+            self.diagonal = 0;
+            size_t len = QueryMatcher::prefilterHitToBuffer(buffer, self);
+            result.append(buffer, len);
+            for (size_t i = 0; i < hits.size(); i++) {
+                len = QueryMatcher::prefilterHitToBuffer(buffer, hits[i]);
+                result.append(buffer, len);
+            }
+            dbw.writeData(result.c_str(), result.length(), centerKey, thread_idx);
+            isCenter[centerId] = true;
+        }
+
+        // entries without a match only hit themselves, clust needs every entry
+#pragma omp for schedule(static)
+        for (size_t id = 0; id < dbSize; id++) {
+            if (isCenter[id]) {
+                continue;
+            }
+            hit_t self;
+            self.seqId = aaDbr.getDbKey(id);
+            self.prefScore = 0;
+            self.diagonal = 0;
+            size_t len = QueryMatcher::prefilterHitToBuffer(buffer, self);
+            dbw.writeData(buffer, len, self.seqId, thread_idx);
+        }
+    }
+    dbw.close();
+
+    ssDbr.close();
+    aaDbr.close();
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,10 @@
 //
 // Created by Martin Steinegger on 11/14/20.
 //
+// include xxhash early to avoid incompatibilites with SIMDe
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
 #include "Command.h"
 #include "LocalParameters.h"
 #include "Debug.h"
@@ -14,6 +18,8 @@
 #include "microtar.h"
 #include "PatternCompiler.h"
 #include "Coordinate16.h"
+#include "AlignmentFeatures.h"
+#include "StructureLookup.h"
 #include "itoa.h"
 #ifdef HAVE_PROSTT5
 #include "prostt5.h"
@@ -89,42 +95,121 @@ std::string removeModel(const std::string& input) {
     std::string suffix = input.substr(secondUnderscoreIndex+1);
     return prefix + suffix;
 }
-size_t
-writeStructureEntry(SubstitutionMatrix & mat, GemmiWrapper & readStructure, StructureTo3Di & structureTo3Di,
-                    PulchraWrapper & pulchra, std::vector<char> & alphabet3di, std::vector<char> & alphabetAA,
-                    std::vector<int8_t> & camol, std::string & header, std::string & name,
+enum ChainStatus {
+    CHAIN_WRITTEN = 0,
+    CHAIN_TOO_SHORT,
+    CHAIN_NOT_PROTEIN
+};
+
+// per-thread scratch space for chains that are processed as separate tasks
+struct ChainWorkspace {
+    StructureTo3Di structureTo3Di;
+    PulchraWrapper pulchra;
+    std::vector<char> alphabet3di;
+    std::vector<char> alphabetAA;
+    std::vector<int8_t> camol;
+    std::string header;
+};
+
+// entries with at least this many chains are split into one task per chain
+static const size_t CHAIN_TASK_THRESHOLD = 8;
+
+// 3Di states of recently encoded chains, keyed by a hash of their residues and backbone coordinates.
+// Chains that occur several times in the input (same file given twice, identical models or entries)
+// are encoded once. A hit also has to match the length, residues and C-alpha coordinates of the chain,
+// so a hash collision is encoded again. The table is direct mapped to bound its memory.
+class StatesCache {
+public:
+    StatesCache() : slots(SLOTS) {}
+
+    bool find(uint64_t key, const char *residues, const Vec3 *ca, size_t chainLen, std::string &out) {
+        bool found = false;
+#pragma omp critical(states_cache)
+        {
+            const Slot &slot = slots[key & (SLOTS - 1)];
+            if (slot.key == key && slot.states.size() == chainLen
+                && memcmp(slot.residues.data(), residues, chainLen * sizeof(char)) == 0
+                && memcmp(slot.ca.data(), ca, chainLen * sizeof(Vec3)) == 0) {
+                out = slot.states;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    void insert(uint64_t key, const char *residues, const Vec3 *ca, const char *chainStates, size_t chainLen) {
+#pragma omp critical(states_cache)
+        {
+            Slot &slot = slots[key & (SLOTS - 1)];
+            slot.key = key;
+            slot.residues.assign(residues, chainLen * sizeof(char));
+            slot.ca.assign(reinterpret_cast<const char *>(ca), chainLen * sizeof(Vec3));
+            slot.states.assign(chainStates, chainLen);
+        }
+    }
+
+private:
+    struct Slot {
+        Slot() : key(0) {}
+        uint64_t key;
+        std::string residues;
+        std::string ca;
+        std::string states;
+    };
+    static const size_t SLOTS = 1 << 12;
+    std::vector<Slot> slots;
+};
+
+static StatesCache statesCache;
+
+static uint64_t hashChain(GemmiWrapper &readStructure, size_t chainStart, size_t chainLen) {
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    XXH64_update(&state, &readStructure.ami[chainStart], chainLen * sizeof(char));
+    XXH64_update(&state, &readStructure.ca[chainStart], chainLen * sizeof(Vec3));
+    XXH64_update(&state, &readStructure.n[chainStart], chainLen * sizeof(Vec3));
+    XXH64_update(&state, &readStructure.c[chainStart], chainLen * sizeof(Vec3));
+    XXH64_update(&state, &readStructure.cb[chainStart], chainLen * sizeof(Vec3));
+    return XXH64_digest(&state);
+}
+
+static int
+writeStructureChain(SubstitutionMatrix & mat, GemmiWrapper & readStructure, size_t ch, size_t dbKey,
+                    StructureTo3Di & structureTo3Di, PulchraWrapper & pulchra, std::vector<char> & alphabet3di,
+                    std::vector<char> & alphabetAA, std::vector<int8_t> & camol, std::string & header,
                     DBWriter & aadbw, DBWriter & hdbw, DBWriter & torsiondbw, DBWriter & cadbw, int chainNameMode,
-                    float maskBfactorThreshold, size_t & tooShort, size_t & notProtein, size_t & globalCnt, int thread_idx, int coordStoreMode,
+                    float maskBfactorThreshold, int thread_idx, int coordStoreMode,
                     std::string & filename,  size_t & fileidCnt,
                     std::map<std::string, std::pair<size_t, unsigned int>> & entrynameToFileId,
                     std::map<std::string, size_t> & filenameToFileId,
                     std::map<size_t, std::string> & fileIdToName,
                     DBWriter* mappingWriter) {
-    size_t id = __sync_fetch_and_add(&globalCnt, readStructure.chain.size());
-    size_t entriesAdded = 0;
-    for (size_t ch = 0; ch < readStructure.chain.size(); ch++) {
-        size_t dbKey = id + ch;
-        size_t chainStart = readStructure.chain[ch].first;
-        size_t chainEnd = readStructure.chain[ch].second;
-        size_t chainLen = chainEnd - chainStart;
-        if (chainLen <= 3) {
-            tooShort++;
-            continue;
-        }
+    size_t chainStart = readStructure.chain[ch].first;
+    size_t chainEnd = readStructure.chain[ch].second;
+    size_t chainLen = chainEnd - chainStart;
+    if (chainLen <= 3) {
+        return CHAIN_TOO_SHORT;
+    }
 
-        bool allX = true;
-        for (size_t pos = 0; pos < chainLen; pos++) {
-            const char aa = readStructure.ami[chainStart+pos];
-            if (aa != 'X' && aa != 'x') {
-                allX = false;
-                break;
-            }
-        }
-        if (allX) {
-            notProtein++;
-            continue;
+    bool allX = true;
+    for (size_t pos = 0; pos < chainLen; pos++) {
+        const char aa = readStructure.ami[chainStart+pos];
+        if (aa != 'X' && aa != 'x') {
+            allX = false;
+            break;
         }
+    }
+    if (allX) {
+        return CHAIN_NOT_PROTEIN;
+    }
 
+    // hashed before the backbone of a Ca only chain is rebuilt, the rebuild is deterministic
+    const uint64_t chainHash = hashChain(readStructure, chainStart, chainLen);
+    std::string cachedStates;
+    const char * states;
+    if (statesCache.find(chainHash, &readStructure.ami[chainStart], &readStructure.ca[chainStart], chainLen, cachedStates)) {
+        states = cachedStates.data();
+    } else {
         // Detect if structure is Ca only
         if (std::isnan(readStructure.n[chainStart + 0].x) &&
             std::isnan(readStructure.n[chainStart + 1].x) &&
@@ -142,99 +227,167 @@ writeStructureEntry(SubstitutionMatrix & mat, GemmiWrapper & readStructure, Stru
                                     chainLen);
         }
 
-        char * states = structureTo3Di.structure2states(&readStructure.ca[chainStart],
-                                                        &readStructure.n[chainStart],
-                                                        &readStructure.c[chainStart],
-                                                        &readStructure.cb[chainStart],
-                                                        chainLen);
-        for(size_t pos = 0; pos < chainLen; pos++){
-            if(readStructure.ca_bfactor[pos] < maskBfactorThreshold){
-                alphabet3di.push_back(tolower(mat.num2aa[static_cast<int>(states[pos])]));
-                alphabetAA.push_back(tolower(readStructure.ami[chainStart+pos]));
-            }else{
-                alphabet3di.push_back(mat.num2aa[static_cast<int>(states[pos])]);
-                alphabetAA.push_back(readStructure.ami[chainStart+pos]);
-            }
+        states = structureTo3Di.structure2states(&readStructure.ca[chainStart],
+                                                 &readStructure.n[chainStart],
+                                                 &readStructure.c[chainStart],
+                                                 &readStructure.cb[chainStart],
+                                                 chainLen);
+        statesCache.insert(chainHash, &readStructure.ami[chainStart], &readStructure.ca[chainStart], states, chainLen);
+    }
+    for(size_t pos = 0; pos < chainLen; pos++){
+        if(readStructure.ca_bfactor[pos] < maskBfactorThreshold){
+            alphabet3di.push_back(tolower(mat.num2aa[static_cast<int>(states[pos])]));
+            alphabetAA.push_back(tolower(readStructure.ami[chainStart+pos]));
+        }else{
+            alphabet3di.push_back(mat.num2aa[static_cast<int>(states[pos])]);
+            alphabetAA.push_back(readStructure.ami[chainStart+pos]);
         }
-        alphabet3di.push_back('\n');
-        alphabetAA.push_back('\n');
-        torsiondbw.writeData(alphabet3di.data(), alphabet3di.size(), dbKey, thread_idx);
-        aadbw.writeData(alphabetAA.data(), alphabetAA.size(), dbKey, thread_idx);
-        header.clear();
-        header.append(Util::remove_extension(readStructure.names[ch]));
-        if(readStructure.modelCount > 1){
-            header.append("_MODEL_");
-            header.append(std::to_string(readStructure.modelIndices[ch]));
-        }
-        if(chainNameMode == LocalParameters::CHAIN_MODE_ADD ||
-           (chainNameMode == LocalParameters::CHAIN_MODE_AUTO && readStructure.names.size() > 1)){
-            header.push_back('_');
-            header.append(readStructure.chainNames[ch]);
-        }
-        if(readStructure.title.size() > 0){
-            header.push_back(' ');
-            header.append(readStructure.title);
-        }
-        header.push_back('\n');
-        std::string entryName = Util::parseFastaHeader(header.c_str());
+    }
+    alphabet3di.push_back('\n');
+    alphabetAA.push_back('\n');
+    torsiondbw.writeData(alphabet3di.data(), alphabet3di.size(), dbKey, thread_idx);
+    aadbw.writeData(alphabetAA.data(), alphabetAA.size(), dbKey, thread_idx);
+    header.clear();
+    header.append(Util::remove_extension(readStructure.names[ch]));
+    if(readStructure.modelCount > 1){
+        header.append("_MODEL_");
+        header.append(std::to_string(readStructure.modelIndices[ch]));
+    }
+    if(chainNameMode == LocalParameters::CHAIN_MODE_ADD ||
+       (chainNameMode == LocalParameters::CHAIN_MODE_AUTO && readStructure.names.size() > 1)){
+        header.push_back('_');
+        header.append(readStructure.chainNames[ch]);
+    }
+    if(readStructure.title.size() > 0){
+        header.push_back(' ');
+        header.append(readStructure.title);
+    }
+    header.push_back('\n');
+    std::string entryName = Util::parseFastaHeader(header.c_str());
 #pragma omp critical
-        {
-            std::map<std::string, size_t>::iterator it = filenameToFileId.find(Util::remove_extension(filename));
-            size_t fileid;
-            if (it != filenameToFileId.end()) {
-                fileid = it->second;
-            } else {
-                fileid = fileidCnt;
-                filenameToFileId[Util::remove_extension(filename)] = fileid;
-                fileIdToName[fileid] = Util::remove_extension(filename);
-                fileidCnt++;
-            }
-            entrynameToFileId[entryName] = std::make_pair(fileid, readStructure.modelIndices[ch]);
-        }
-        hdbw.writeData(header.c_str(), header.size(), dbKey, thread_idx);
-        name.clear();
-
-        if (mappingWriter != NULL) {
-            std::string taxId = SSTR(readStructure.taxIds[ch]);
-            taxId.append(1, '\n');
-            mappingWriter->writeData(taxId.c_str(), taxId.size(), dbKey, thread_idx, false);
-        }
-
-        float* camolf32;
-        if (coordStoreMode == LocalParameters::COORD_STORE_MODE_CA_DIFF) {
-            camol.resize((chainLen - 1) * 3 * sizeof(int16_t) + 3 * sizeof(float) + 1 * sizeof(uint8_t));
-            int16_t* camolf16 = reinterpret_cast<int16_t*>(camol.data());
-            // check if any of the coordinates is too large to be stored as int16_t
-            if (Coordinate16::convertToDiff16(chainLen, (double*)(readStructure.ca.data() + chainStart) + 0, camolf16)
-             || Coordinate16::convertToDiff16(chainLen, (double*)(readStructure.ca.data() + chainStart) + 1, camolf16 + 1 * (chainLen + 1))
-             || Coordinate16::convertToDiff16(chainLen, (double*)(readStructure.ca.data() + chainStart) + 2, camolf16 + 2 * (chainLen + 1))) {
-                // store all coordinates as float instead
-                goto overflow;
-            }
-            cadbw.writeData((const char*)camol.data(), (chainLen - 1) * 3 * sizeof(uint16_t) + 3 * sizeof(float) + 1 * sizeof(uint8_t), dbKey, thread_idx);
-            goto cleanup;
+    {
+        std::map<std::string, size_t>::iterator it = filenameToFileId.find(Util::remove_extension(filename));
+        size_t fileid;
+        if (it != filenameToFileId.end()) {
+            fileid = it->second;
+        } else {
+            fileid = fileidCnt;
+            filenameToFileId[Util::remove_extension(filename)] = fileid;
+            fileIdToName[fileid] = Util::remove_extension(filename);
+            fileidCnt++;
         }
+        entrynameToFileId[entryName] = std::make_pair(fileid, readStructure.modelIndices[ch]);
+    }
+    hdbw.writeData(header.c_str(), header.size(), dbKey, thread_idx);
+
+    if (mappingWriter != NULL) {
+        std::string taxId = SSTR(readStructure.taxIds[ch]);
+        taxId.append(1, '\n');
+        mappingWriter->writeData(taxId.c_str(), taxId.size(), dbKey, thread_idx, false);
+    }
+
+    float* camolf32;
+    if (coordStoreMode == LocalParameters::COORD_STORE_MODE_CA_DIFF) {
+        camol.resize((chainLen - 1) * 3 * sizeof(int16_t) + 3 * sizeof(float) + 1 * sizeof(uint8_t));
+        int16_t* camolf16 = reinterpret_cast<int16_t*>(camol.data());
+        // check if any of the coordinates is too large to be stored as int16_t
+        if (Coordinate16::convertToDiff16(chainLen, (double*)(readStructure.ca.data() + chainStart) + 0, camolf16)
+         || Coordinate16::convertToDiff16(chainLen, (double*)(readStructure.ca.data() + chainStart) + 1, camolf16 + 1 * (chainLen + 1))
+         || Coordinate16::convertToDiff16(chainLen, (double*)(readStructure.ca.data() + chainStart) + 2, camolf16 + 2 * (chainLen + 1))) {
+            // store all coordinates as float instead
+            goto overflow;
+        }
+        cadbw.writeData((const char*)camol.data(), (chainLen - 1) * 3 * sizeof(uint16_t) + 3 * sizeof(float) + 1 * sizeof(uint8_t), dbKey, thread_idx);
+        goto cleanup;
+    }
 overflow:
-        camol.resize(chainLen * 3 * sizeof(float));
-        camolf32 = reinterpret_cast<float*>(camol.data());
-        for (size_t pos = 0; pos < chainLen; pos++) {
-            camolf32[(0 * chainLen) + pos] = (std::isnan(readStructure.ca[chainStart+pos].x))
-                        ? 0.0 : readStructure.ca[chainStart+pos].x;
+    camol.resize(chainLen * 3 * sizeof(float));
+    camolf32 = reinterpret_cast<float*>(camol.data());
+    for (size_t pos = 0; pos < chainLen; pos++) {
+        camolf32[(0 * chainLen) + pos] = (std::isnan(readStructure.ca[chainStart+pos].x))
+                    ? 0.0 : readStructure.ca[chainStart+pos].x;
+    }
+    for (size_t pos = 0; pos < chainLen; pos++) {
+        camolf32[(1 * chainLen) + pos] = (std::isnan(readStructure.ca[chainStart+pos].y))
+                    ? 0.0 : readStructure.ca[chainStart+pos].y;
+    }
+    for (size_t pos = 0; pos < chainLen; pos++) {
+        camolf32[(2 * chainLen) + pos] = (std::isnan(readStructure.ca[chainStart+pos].z))
+                    ? 0.0 : readStructure.ca[chainStart+pos].z;
+    }
+    cadbw.writeData((const char*)camol.data(), chainLen * 3 * sizeof(float), dbKey, thread_idx);
+cleanup:
+    alphabet3di.clear();
+    alphabetAA.clear();
+    camol.clear();
+    return CHAIN_WRITTEN;
+}
+
+size_t
+writeStructureEntry(SubstitutionMatrix & mat, GemmiWrapper & readStructure, StructureTo3Di & structureTo3Di,
+                    PulchraWrapper & pulchra, std::vector<char> & alphabet3di, std::vector<char> & alphabetAA,
+                    std::vector<int8_t> & camol, std::string & header, std::string & name,
+                    DBWriter & aadbw, DBWriter & hdbw, DBWriter & torsiondbw, DBWriter & cadbw, int chainNameMode,
+                    float maskBfactorThreshold, size_t & tooShort, size_t & notProtein, size_t & globalCnt, int thread_idx, int coordStoreMode,
+                    std::string & filename,  size_t & fileidCnt,
+                    std::map<std::string, std::pair<size_t, unsigned int>> & entrynameToFileId,
+                    std::map<std::string, size_t> & filenameToFileId,
+                    std::map<size_t, std::string> & fileIdToName,
+                    DBWriter* mappingWriter, std::vector<ChainWorkspace*> & chainWorkspaces) {
+    size_t id = __sync_fetch_and_add(&globalCnt, readStructure.chain.size());
+    size_t chainCount = readStructure.chain.size();
+    std::vector<int> status(chainCount, CHAIN_WRITTEN);
+    bool chainTasks = false;
+#ifdef OPENMP
+    chainTasks = chainCount >= CHAIN_TASK_THRESHOLD && omp_get_num_threads() > 1;
+#endif
+    if (chainTasks) {
+        // keys are reserved above, so chains of large entries (assemblies, NMR models)
+        // can be picked up by idle threads without changing the output
+        for (size_t ch = 0; ch < chainCount; ch++) {
+#pragma omp task default(shared) firstprivate(ch)
+            {
+                unsigned int taskThreadIdx = 0;
+#ifdef OPENMP
+                taskThreadIdx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+                if (chainWorkspaces[taskThreadIdx] == NULL) {
+                    chainWorkspaces[taskThreadIdx] = new ChainWorkspace();
+                }
+                ChainWorkspace& ws = *chainWorkspaces[taskThreadIdx];
+                status[ch] = writeStructureChain(
+                    mat, readStructure, ch, id + ch, ws.structureTo3Di, ws.pulchra,
+                    ws.alphabet3di, ws.alphabetAA, ws.camol, ws.header, aadbw, hdbw, torsiondbw, cadbw,
+                    chainNameMode, maskBfactorThreshold, taskThreadIdx, coordStoreMode,
+                    filename, fileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, mappingWriter
+                );
+            }
         }
-        for (size_t pos = 0; pos < chainLen; pos++) {
-            camolf32[(1 * chainLen) + pos] = (std::isnan(readStructure.ca[chainStart+pos].y))
-                        ? 0.0 : readStructure.ca[chainStart+pos].y;
+#pragma omp taskwait
+    } else {
+        for (size_t ch = 0; ch < chainCount; ch++) {
+            status[ch] = writeStructureChain(
+                mat, readStructure, ch, id + ch, structureTo3Di, pulchra,
+                alphabet3di, alphabetAA, camol, header, aadbw, hdbw, torsiondbw, cadbw,
+                chainNameMode, maskBfactorThreshold, thread_idx, coordStoreMode,
+                filename, fileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, mappingWriter
+            );
         }
-        for (size_t pos = 0; pos < chainLen; pos++) {
-            camolf32[(2 * chainLen) + pos] = (std::isnan(readStructure.ca[chainStart+pos].z))
-                        ? 0.0 : readStructure.ca[chainStart+pos].z;
+    }
+    name.clear();
+
+    size_t entriesAdded = 0;
+    for (size_t ch = 0; ch < chainCount; ch++) {
+        switch (status[ch]) {
+            case CHAIN_TOO_SHORT:
+                tooShort++;
+                break;
+            case CHAIN_NOT_PROTEIN:
+                notProtein++;
+                break;
+            default:
+                entriesAdded++;
         }
-        cadbw.writeData((const char*)camol.data(), chainLen * 3 * sizeof(float), dbKey, thread_idx);
-cleanup:
-        alphabet3di.clear();
-        alphabetAA.clear();
-        camol.clear();
-        entriesAdded++;
     }
     return entriesAdded;
 }
@@ -300,36 +453,77 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
             Debug(Debug::ERROR) << "Could not find ProstT5 model weights. Download with `foldseek databases ProstT5 prostt5_out tmp`\n";
             return EXIT_FAILURE;
         }
+        // identical sequences are predicted once, sorting by hash puts them next to each other
+        std::vector<std::pair<uint64_t, size_t>> seqHashes(reader.getSize());
+#pragma omp parallel
+        {
+            int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = omp_get_thread_num();
+#endif
+#pragma omp for schedule(static)
+            for (size_t i = 0; i < reader.getSize(); ++i) {
+                seqHashes[i] = std::make_pair(XXH64(reader.getData(i, thread_idx), reader.getSeqLen(i), 0), i);
+            }
+        }
+        SORT_PARALLEL(seqHashes.begin(), seqHashes.end());
+        std::vector<size_t> groupStart;
+        for (size_t i = 0; i < seqHashes.size(); ++i) {
+            if (i == 0 || seqHashes[i].first != seqHashes[i - 1].first) {
+                groupStart.push_back(i);
+            }
+        }
+        groupStart.push_back(seqHashes.size());
+
         ProstT5 *model = prostt5_load(modelWeights.c_str(), false, par.gpu == 0, false, quantized);
 #ifdef OPENMP
         size_t localThreads = par.gpu != 0 ? 1 : par.threads;
 #endif
-#pragma omp parallel num_threads(localThreads)
+        size_t predicted = 0;
+#pragma omp parallel num_threads(localThreads) reduction(+:predicted)
         {
             int thread_idx = 0;
 #ifdef OPENMP
             thread_idx = omp_get_thread_num();
 #endif
             const char newline = '\n';
+            // sequences of the current group and their predictions, a hash collision gets its own prediction
+            std::vector<std::pair<std::string, std::string>> groupResults;
 #pragma omp for schedule(dynamic, 1)
-            for (size_t i = 0; i < reader.getSize(); ++i) {
-                unsigned int key = reader.getDbKey(i);
-                char* seq = reader.getData(i, thread_idx);
-                size_t length = reader.getSeqLen(i);
-                const char *result = prostt5_predict_slice(model, seq, length);
-                if (result != NULL) {
+            for (size_t g = 0; g < groupStart.size() - 1; ++g) {
+                groupResults.clear();
+                for (size_t j = groupStart[g]; j < groupStart[g + 1]; ++j) {
+                    size_t id = seqHashes[j].second;
+                    char* seq = reader.getData(id, thread_idx);
+                    size_t length = reader.getSeqLen(id);
+                    const std::string *result = NULL;
+                    for (size_t k = 0; k < groupResults.size(); ++k) {
+                        const std::string &other = groupResults[k].first;
+                        if (other.size() == length && memcmp(other.data(), seq, length) == 0) {
+                            result = &groupResults[k].second;
+                            break;
+                        }
+                    }
+                    if (result == NULL) {
+                        const char *prediction = prostt5_predict_slice(model, seq, length);
+                        if (prediction == NULL) {
+                            Debug(Debug::ERROR) << "Prediction failed\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                        groupResults.emplace_back(std::string(seq, length), std::string(prediction, length));
+                        free((void*)prediction);
+                        result = &groupResults.back().second;
+                        predicted++;
+                    }
                     writer.writeStart(thread_idx);
-                    writer.writeAdd(result, length, thread_idx);
+                    writer.writeAdd(result->c_str(), length, thread_idx);
                     writer.writeAdd(&newline, 1, thread_idx);
-                    writer.writeEnd(key, thread_idx);
-                    free((void*)result);
-                } else {
-                    Debug(Debug::ERROR) << "Prediction failed\n";
-                    EXIT(EXIT_FAILURE);
+                    writer.writeEnd(reader.getDbKey(id), thread_idx);
+                    progress.updateProgress();
                 }
-                progress.updateProgress();
             }
         }
+        Debug(Debug::INFO) << "Predicted 3Di sequences for " << predicted << " unique of " << reader.getSize() << " sequences\n";
         writer.close(true);
         reader.close();
         prostt5_free(model);
@@ -346,6 +540,9 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
         DBReader<unsigned int>::removeDb(ssDb);
         DBReader<unsigned int>::moveDb(tempDb.first, ssDb);
 
+        if (par.writeFeatures) {
+            writeAlignmentFeatures(par, outputName, outputName + "_feat");
+        }
         return EXIT_SUCCESS;
     } else {
         par.printParameters(command.cmd, argc, argv, *command.params);
@@ -464,6 +661,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
 
     size_t globalCnt = 0;
     size_t globalFileidCnt = 0;
+    std::vector<ChainWorkspace*> chainWorkspaces(par.threads, NULL);
     size_t incorrectFiles = 0;
     size_t tooShort = 0;
     size_t notProtein = 0;
@@ -500,7 +698,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
         }
 #endif
 
-#pragma omp parallel default(none) shared(tar, par, torsiondbw, hdbw, cadbw, aadbw, mat, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, mappingWriter, std::cerr, std::cout, inputFormat) num_threads(localThreads) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
+#pragma omp parallel default(none) shared(tar, par, torsiondbw, hdbw, cadbw, aadbw, mat, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, mappingWriter, chainWorkspaces, std::cerr, std::cout, inputFormat) num_threads(localThreads) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
         {
             unsigned int thread_idx = 0;
 #ifdef OPENMP
@@ -638,7 +836,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
                         alphabet3di, alphabetAA, camol, header, name, aadbw, hdbw, torsiondbw, cadbw,
                         par.chainNameMode, par.maskBfactorThreshold, tooShort, notProtein, globalCnt, thread_idx, par.coordStoreMode,
                         name, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName,
-                        mappingWriter
+                        mappingWriter, chainWorkspaces
                     );
                 }
             } // end while
@@ -650,7 +848,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
 
 
     //===================== single_process ===================//__110710__//
-#pragma omp parallel default(none) shared(par, torsiondbw, hdbw, cadbw, aadbw, mat, looseFiles, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, mappingWriter, inputFormat) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
+#pragma omp parallel default(none) shared(par, torsiondbw, hdbw, cadbw, aadbw, mat, looseFiles, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, mappingWriter, chainWorkspaces, inputFormat) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
     {
         unsigned int thread_idx = 0;
 #ifdef OPENMP
@@ -681,7 +879,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
                 alphabet3di, alphabetAA, camol, header, name, aadbw, hdbw, torsiondbw, cadbw,
                 par.chainNameMode, par.maskBfactorThreshold, tooShort, notProtein, globalCnt, thread_idx, par.coordStoreMode,
                 looseFiles[i], globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName,
-                mappingWriter
+                mappingWriter, chainWorkspaces
             );
         }
     }
@@ -705,7 +903,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
             filter = parts[2][0];
         }
         progress.reset(SIZE_MAX);
-#pragma omp parallel default(none) shared(par, torsiondbw, hdbw, cadbw, aadbw, mat, gcsPaths, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, client, bucket_name, filter, mappingWriter) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel, inputFormat)
+#pragma omp parallel default(none) shared(par, torsiondbw, hdbw, cadbw, aadbw, mat, gcsPaths, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, client, bucket_name, filter, mappingWriter, chainWorkspaces) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel, inputFormat)
         {
             StructureTo3Di structureTo3Di;
             PulchraWrapper pulchra;
@@ -744,7 +942,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
                                     alphabet3di, alphabetAA, camol, header, name, aadbw, hdbw, torsiondbw, cadbw,
                                     par.chainNameMode, par.maskBfactorThreshold, tooShort, notProtein, globalCnt, thread_idx, par.coordStoreMode,
                                     obj_name, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName,
-                                    mappingWriter
+                                    mappingWriter, chainWorkspaces
                                 );
                             }
                         }
@@ -759,7 +957,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
         DBReader<unsigned int> reader(dbs[i].c_str(), (dbs[i]+".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_LOOKUP);
         reader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
         progress.reset(reader.getSize());
-#pragma omp parallel default(none) shared(par, torsiondbw, hdbw, cadbw, aadbw, mat, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, reader, mappingWriter, inputFormat) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
+#pragma omp parallel default(none) shared(par, torsiondbw, hdbw, cadbw, aadbw, mat, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, reader, mappingWriter, chainWorkspaces, inputFormat) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
         {
             StructureTo3Di structureTo3Di;
             PulchraWrapper pulchra;
@@ -776,7 +974,8 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
 #ifdef OPENMP
             thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-#pragma omp for schedule(static)
+            // entry sizes (and decompression cost for Foldcomp DBs) vary a lot
+#pragma omp for schedule(dynamic, 16)
             for (size_t i = 0; i < reader.getSize(); i++) {
                 progress.updateProgress();
 
@@ -795,7 +994,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
                         alphabet3di, alphabetAA, camol, header, name, aadbw, hdbw, torsiondbw, cadbw,
                         par.chainNameMode, par.maskBfactorThreshold, tooShort, notProtein, globalCnt, thread_idx, par.coordStoreMode,
                         dbname, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName,
-                        mappingWriter
+                        mappingWriter, chainWorkspaces
                     );
                 }
             }
@@ -803,6 +1002,10 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
         reader.close();
     }
 
+    for (size_t i = 0; i < chainWorkspaces.size(); i++) {
+        delete chainWorkspaces[i];
+    }
+
     torsiondbw.close(true);
     hdbw.close(true);
     cadbw.close(true);
@@ -1013,5 +1216,11 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
     
     Debug(Debug::INFO) << "Ignore " << (tooShort+incorrectFiles+notProtein) << " out of " << globalCnt << ".\n";
     Debug(Debug::INFO) << "Too short: " << tooShort << ", incorrect: " << incorrectFiles << ", not proteins: " << notProtein << ".\n";
+    if (FileUtil::fileExists((outputName + ".lookup").c_str())) {
+        StructureLookup::writeBinary(outputName);
+    }
+    if (par.writeFeatures) {
+        writeAlignmentFeatures(par, outputName, outputName + "_feat");
+    }
     return EXIT_SUCCESS;
 }
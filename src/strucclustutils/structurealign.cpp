@@ -1,6 +1,7 @@
 #include "DBReader.h"
 #include "IndexReader.h"
 #include "DBWriter.h"
+#include "QueryCheckpoint.h"
 #include "Debug.h"
 #include "Util.h"
 #include "LocalParameters.h"
@@ -12,6 +13,7 @@
 #include "TMaligner.h"
 #include "Coordinate16.h"
 #include "LDDT.h"
+#include "AlignmentFeatures.h"
 
 #ifdef OPENMP
 #include <omp.h>
@@ -150,7 +152,7 @@ int structurealign(int argc, const char **argv, const Command& command) {
     bool alignmentIsExtended = extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC;
     IndexReader tAADbr(par.db2, par.threads,
                              alignmentIsExtended ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-                             (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+                             IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
 
     std::string t3DiDbrName =  StructureUtil::getIndexWithSuffix(par.db2, "_ss");
     bool is3DiIdx = Parameters::isEqualDbtype(FileUtil::parseDbType(t3DiDbrName.c_str()),
@@ -158,7 +160,7 @@ int structurealign(int argc, const char **argv, const Command& command) {
 
     IndexReader t3DiDbr(is3DiIdx ? t3DiDbrName : par.db2, par.threads,
                               alignmentIsExtended ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-                              (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0,
+                              IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA),
                               DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                               alignmentIsExtended ? "_seq_ss" : "_ss");
 
@@ -170,8 +172,8 @@ int structurealign(int argc, const char **argv, const Command& command) {
         q3DiDbr = &t3DiDbr;
         qAADbr = &tAADbr;
     } else {
-        qAADbr = new IndexReader(par.db1, par.threads, IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
-        q3DiDbr = new IndexReader(StructureUtil::getIndexWithSuffix(par.db1, "_ss"), par.threads, IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+        qAADbr = new IndexReader(par.db1, par.threads, IndexReader::SRC_SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
+        q3DiDbr = new IndexReader(StructureUtil::getIndexWithSuffix(par.db1, "_ss"), par.threads, IndexReader::SRC_SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
     }
 
     bool db1CaExist = FileUtil::fileExists((par.db1 + "_ca.dbtype").c_str());
@@ -203,8 +205,9 @@ int structurealign(int argc, const char **argv, const Command& command) {
     if(alignmentIsExtended){
         dbtype = DBReader<unsigned int>::setExtendedDbtype(dbtype, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
     }
-    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed,  dbtype);
-    dbw.open();
+    QueryCheckpoint checkpoint(par.db4, par.db4Index, 0, resultReader.getSize(), static_cast<size_t>(par.checkpointInterval),
+                               par.checkpointInterval > 0 ? QueryCheckpoint::fingerprint(par, *command.params, {par.db1Index, par.db2Index, par.db3Index}) : 0);
+    DBWriter *dbw = NULL;
 
     bool needTMaligner = (par.tmScoreThr > 0);
     bool needLDDT = (par.lddtThr > 0);
@@ -231,7 +234,7 @@ int structurealign(int argc, const char **argv, const Command& command) {
                 par.db1,
                 par.threads,
                 IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-                touch ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0,
+                IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA),
                 DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                 "_ca");
         if (sameDB) {
@@ -242,13 +245,23 @@ int structurealign(int argc, const char **argv, const Command& command) {
                     par.threads,
                     alignmentIsExtended ? IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB2) :
                                            IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-                    touch ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0,
+                    IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA),
                     DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                     alignmentIsExtended ? "_seq_ca" : "_ca"
             );
         }
     }
 
+    DBReader<unsigned int> *tFeatDbr = NULL;
+    std::string tFeatDb = AlignmentFeatures::getFeatureDbName(par.db2);
+    if (alignmentIsExtended == false && AlignmentFeatures::isUsable(par, tFeatDb)) {
+        tFeatDbr = new DBReader<unsigned int>(tFeatDb.c_str(), (tFeatDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+        tFeatDbr->open(DBReader<unsigned int>::NOSORT);
+        if (touch) {
+            tFeatDbr->readMmapedDataInMemory();
+        }
+    }
+
     SubstitutionMatrix subMat3Di(par.scoringMatrixFile.values.aminoacid().c_str(), 2.1, par.scoreBias);
     std::string blosum;
     for (size_t i = 0; i < par.substitutionMatrices.size(); i++) {
@@ -310,145 +323,187 @@ int structurealign(int argc, const char **argv, const Command& command) {
 
         Coordinate16 qcoords;
         Coordinate16 tcoords;
+        std::vector<float> featCa;
 
         TMaligner::TMscoreResult tmres;
         LDDTCalculator::LDDTScoreResult lddtres;
         // write output file
 
+        for (size_t chunk = 0; chunk < checkpoint.getChunkCount(); chunk++) {
+            if (checkpoint.isDone(chunk)) {
+                continue;
+            }
+#pragma omp single
+            {
+                std::pair<std::string, std::string> chunkDb = checkpoint.getChunkDb(chunk);
+                dbw = new DBWriter(chunkDb.first.c_str(), chunkDb.second.c_str(), static_cast<unsigned int>(par.threads), par.compressed | Parameters::WRITER_DIRECT_MODE, dbtype);
+                dbw->open();
+            }
 #pragma omp for schedule(dynamic, 1)
-        for (size_t id = 0; id < resultReader.getSize(); id++) {
-            progress.updateProgress();
-            char *data = resultReader.getData(id, thread_idx);
-            size_t queryKey = resultReader.getDbKey(id);
-            if(*data != '\0') {
-                unsigned int queryId = q3DiDbr->sequenceReader->getId(queryKey);
-
-                char *querySeqAA = qAADbr->sequenceReader->getData(queryId, thread_idx);
-                char *querySeq3Di = q3DiDbr->sequenceReader->getData(queryId, thread_idx);
-                unsigned int querySeqLen = q3DiDbr->sequenceReader->getSeqLen(queryId);
-                qSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
-                qSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
-                if(needCalpha){
-                    size_t qId = qcadbr->sequenceReader->getId(queryKey);
-                    char *qcadata = qcadbr->sequenceReader->getData(qId, thread_idx);
-                    size_t qCaLength = qcadbr->sequenceReader->getEntryLen(qId);
-                    float* queryCaData = qcoords.read(qcadata, qSeq3Di.L, qCaLength);
-                    if(needTMaligner){
-                        tmaligner->initQuery(queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L], NULL, qSeq3Di.L);
-                    }
-                    if(needLDDT){
-                        lddtcalculator->initQuery(qSeq3Di.L, queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L]);
-                    }
-                }
-                std::pair<double, double> muLambda = evaluer.predictMuLambda(qSeq3Di.numSequence, qSeq3Di.L);
-                structureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
-                qSeq3Di.reverse();
-                qSeqAA.reverse();
-                reverseStructureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
-                int passedNum = 0;
-                int rejected = 0;
-                while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
-                    char dbKeyBuffer[255 + 1];
-                    Util::parseKey(data, dbKeyBuffer);
-                    data = Util::skipLine(data);
-                    const unsigned int dbKey = (unsigned int) strtoul(dbKeyBuffer, NULL, 10);
-                    unsigned int targetId = t3DiDbr.sequenceReader->getId(dbKey);
-                    const bool isIdentity = (queryId == targetId && (par.includeIdentity || sameDB))? true : false;
-
-                    char * targetSeq3Di = t3DiDbr.sequenceReader->getData(targetId, thread_idx);
-                    char * targetSeqAA = tAADbr.sequenceReader->getData(targetId, thread_idx);
-                    const int targetSeqLen = static_cast<int>(t3DiDbr.sequenceReader->getSeqLen(targetId));
-
-                    tSeq3Di.mapSequence(targetId, dbKey, targetSeq3Di, targetSeqLen);
-                    tSeqAA.mapSequence(targetId, dbKey, targetSeqAA, targetSeqLen);
-                    if(Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, targetSeqLen) == false){
-                        rejected++;
-                        continue;
-                    }
-                    Matcher::result_t res;
-                    if(alignStructure(structureSmithWaterman, reverseStructureSmithWaterman,
-                                      tSeqAA, tSeq3Di, querySeqLen, targetSeqLen,
-                                      evaluer, muLambda, res, backtrace, par) == -1){
-                        rejected++;
-                        continue;
+            for (size_t id = checkpoint.getChunkStart(chunk); id < checkpoint.getChunkEnd(chunk); id++) {
+                progress.updateProgress();
+                char *data = resultReader.getData(id, thread_idx);
+                size_t queryKey = resultReader.getDbKey(id);
+                if(*data != '\0') {
+                    unsigned int queryId = q3DiDbr->sequenceReader->getId(queryKey);
+
+                    char *querySeqAA = qAADbr->sequenceReader->getData(queryId, thread_idx);
+                    char *querySeq3Di = q3DiDbr->sequenceReader->getData(queryId, thread_idx);
+                    unsigned int querySeqLen = q3DiDbr->sequenceReader->getSeqLen(queryId);
+                    qSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
+                    qSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
+                    if(needCalpha){
+                        size_t qId = qcadbr->sequenceReader->getId(queryKey);
+                        char *qcadata = qcadbr->sequenceReader->getData(qId, thread_idx);
+                        size_t qCaLength = qcadbr->sequenceReader->getEntryLen(qId);
+                        float* queryCaData = qcoords.read(qcadata, qSeq3Di.L, qCaLength);
+                        if(needTMaligner){
+                            tmaligner->initQuery(queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L], NULL, qSeq3Di.L);
+                        }
+                        if(needLDDT){
+                            lddtcalculator->initQuery(qSeq3Di.L, queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L]);
+                        }
                     }
+                    std::pair<double, double> muLambda = evaluer.predictMuLambda(qSeq3Di.numSequence, qSeq3Di.L);
+                    structureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+                    qSeq3Di.reverse();
+                    qSeqAA.reverse();
+                    reverseStructureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+                    int passedNum = 0;
+                    int rejected = 0;
+                    while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
+                        char dbKeyBuffer[255 + 1];
+                        Util::parseKey(data, dbKeyBuffer);
+                        data = Util::skipLine(data);
+                        const unsigned int dbKey = (unsigned int) strtoul(dbKeyBuffer, NULL, 10);
+                        unsigned int targetId = t3DiDbr.sequenceReader->getId(dbKey);
+                        const bool isIdentity = (queryId == targetId && (par.includeIdentity || sameDB))? true : false;
+
+                        const int targetSeqLen = static_cast<int>(t3DiDbr.sequenceReader->getSeqLen(targetId));
+                        AlignmentFeatures::Entry feat;
+                        bool hasFeat = false;
+                        if (tFeatDbr != NULL) {
+                            size_t featId = tFeatDbr->getId(dbKey);
+                            // a partial or stale feature DB falls back to the target DBs
+                            hasFeat = featId != UINT_MAX
+                                      && AlignmentFeatures::parse(tFeatDbr->getData(featId, thread_idx), tFeatDbr->getEntryLen(featId), feat)
+                                      && static_cast<int>(feat.length) == targetSeqLen;
+                        }
+                        if (hasFeat) {
+                            if (feat.packed != NULL) {
+                                AlignmentFeatures::unpackResidues(feat.packed, feat.length,
+                                                                  tSeqAA.reserveNumSequence(targetId, dbKey, feat.length),
+                                                                  tSeq3Di.reserveNumSequence(targetId, dbKey, feat.length));
+                            } else {
+                                tSeq3Di.mapSequence(targetId, dbKey, std::make_pair(feat.ss, feat.length));
+                                tSeqAA.mapSequence(targetId, dbKey, std::make_pair(feat.aa, feat.length));
+                            }
+                        } else {
+                            char * targetSeq3Di = t3DiDbr.sequenceReader->getData(targetId, thread_idx);
+                            char * targetSeqAA = tAADbr.sequenceReader->getData(targetId, thread_idx);
+                            tSeq3Di.mapSequence(targetId, dbKey, targetSeq3Di, targetSeqLen);
+                            tSeqAA.mapSequence(targetId, dbKey, targetSeqAA, targetSeqLen);
+                        }
+                        if(Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, targetSeqLen) == false){
+                            rejected++;
+                            continue;
+                        }
+                        Matcher::result_t res;
+                        if(alignStructure(structureSmithWaterman, reverseStructureSmithWaterman,
+                                          tSeqAA, tSeq3Di, querySeqLen, targetSeqLen,
+                                          evaluer, muLambda, res, backtrace, par) == -1){
+                            rejected++;
+                            continue;
+                        }
 
-                    if (Alignment::checkCriteria(res, isIdentity, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
-                        if(needCalpha) {
-                            size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
-                            char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
-                            size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
-                            float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
-                            if(needTMaligner) {
-                                tmres = tmaligner->computeTMscore(targetCaData,
-                                                                  &targetCaData[res.dbLen],
-                                                                  &targetCaData[res.dbLen +
-                                                                                res.dbLen],
-                                                                  res.dbLen,
-                                                                  res.qStartPos,
-                                                                  res.dbStartPos,
-                                                                  res.backtrace,
-                                                                  std::min(static_cast<unsigned int>(res.backtrace.size()), std::min(res.dbLen, res.qLen)));
-                                if (tmres.tmscore < par.tmScoreThr) {
-                                    continue;
+                        if (Alignment::checkCriteria(res, isIdentity, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
+                            if(needCalpha) {
+                                float* targetCaData = hasFeat ? AlignmentFeatures::readCa(feat, tcoords, featCa) : NULL;
+                                if (targetCaData == NULL) {
+                                    size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
+                                    char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
+                                    size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
+                                    targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
+                                }
+                                if(needTMaligner) {
+                                    tmres = tmaligner->computeTMscore(targetCaData,
+                                                                      &targetCaData[res.dbLen],
+                                                                      &targetCaData[res.dbLen +
+                                                                                    res.dbLen],
+                                                                      res.dbLen,
+                                                                      res.qStartPos,
+                                                                      res.dbStartPos,
+                                                                      res.backtrace,
+                                                                      std::min(static_cast<unsigned int>(res.backtrace.size()), std::min(res.dbLen, res.qLen)));
+                                    if (tmres.tmscore < par.tmScoreThr) {
+                                        continue;
+                                    }
+                                }
+                                if(needLDDT){
+                                    lddtres = lddtcalculator->computeBoundedLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos,
+                                                                                      res.backtrace,
+                                                                                      targetCaData, &targetCaData[res.dbLen],
+                                                                                      &targetCaData[res.dbLen+res.dbLen],
+                                                                                      par.lddtThr);
+
+                                    if(lddtres.avgLddtScore < par.lddtThr){
+                                        continue;
+                                    }
+                                    res.dbcov = lddtres.avgLddtScore;
+                                }
+                                if(par.sortByStructureBits && needTMaligner && needLDDT){
+                                    res.score = res.score * sqrt(lddtres.avgLddtScore * tmres.tmscore);
                                 }
                             }
-                            if(needLDDT){
-                                lddtres = lddtcalculator->computeLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos,
-                                                                           res.backtrace,
-                                                                           targetCaData, &targetCaData[res.dbLen],
-                                                                           &targetCaData[res.dbLen+res.dbLen]);
 
-                                if(lddtres.avgLddtScore < par.lddtThr){
+
+                            alignmentResult.emplace_back(res);
+                            int altAli = par.altAlignment;
+                            bool moreAltAli = true;
+                            while(altAli && moreAltAli){
+                                Matcher::result_t altRes;
+                                if(computeAlternativeAlignment(structureSmithWaterman, reverseStructureSmithWaterman,
+                                                               tSeqAA, tSeq3Di, querySeqLen, targetSeqLen,
+                                                               evaluer, muLambda, res, altRes,
+                                                               backtrace, par) == -1) {
+                                    moreAltAli = false;
                                     continue;
                                 }
-                                res.dbcov = lddtres.avgLddtScore;
-                            }
-                            if(par.sortByStructureBits && needTMaligner && needLDDT){
-                                res.score = res.score * sqrt(lddtres.avgLddtScore * tmres.tmscore);
+                                alignmentResult.push_back(altRes);
+                                res = altRes;
+                                altAli--;
                             }
+                            passedNum++;
+                            rejected = 0;
+                        } else {
+                            rejected++;
                         }
+                    }
+                }
 
 
-                        alignmentResult.emplace_back(res);
-                        int altAli = par.altAlignment;
-                        bool moreAltAli = true;
-                        while(altAli && moreAltAli){
-                            Matcher::result_t altRes;
-                            if(computeAlternativeAlignment(structureSmithWaterman, reverseStructureSmithWaterman,
-                                                           tSeqAA, tSeq3Di, querySeqLen, targetSeqLen,
-                                                           evaluer, muLambda, res, altRes,
-                                                           backtrace, par) == -1) {
-                                moreAltAli = false;
-                                continue;
-                            }
-                            alignmentResult.push_back(altRes);
-                            res = altRes;
-                            altAli--;
-                        }
-                        passedNum++;
-                        rejected = 0;
+                if (alignmentResult.size() > 1) {
+                    if(par.sortByStructureBits) {
+                        SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), compareHitsByStructureBits);
                     } else {
-                        rejected++;
+                        SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), Matcher::compareHits);
                     }
                 }
-            }
-
-
-            if (alignmentResult.size() > 1) {
-                if(par.sortByStructureBits) {
-                    SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), compareHitsByStructureBits);
-                } else {
-                    SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), Matcher::compareHits);
+                for (size_t result = 0; result < alignmentResult.size(); result++) {
+                    size_t len = Matcher::resultToBuffer(buffer, alignmentResult[result], par.addBacktrace);
+                    resultBuffer.append(buffer, len);
                 }
+                dbw->writeData(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
+                resultBuffer.clear();
+                alignmentResult.clear();
             }
-            for (size_t result = 0; result < alignmentResult.size(); result++) {
-                size_t len = Matcher::resultToBuffer(buffer, alignmentResult[result], par.addBacktrace);
-                resultBuffer.append(buffer, len);
+#pragma omp single
+            {
+                dbw->close();
+                delete dbw;
+                dbw = NULL;
+                checkpoint.commit(chunk);
             }
-            dbw.writeData(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
-            resultBuffer.clear();
-            alignmentResult.clear();
         }
         if(needTMaligner){
             delete tmaligner;
@@ -461,7 +516,12 @@ int structurealign(int argc, const char **argv, const Command& command) {
     free(tinySubMatAA);
     free(tinySubMat3Di);
 
-    dbw.close();
+    if (tFeatDbr != NULL) {
+        tFeatDbr->close();
+        delete tFeatDbr;
+    }
+
+    checkpoint.finish();
     resultReader.close();
 
     if(needCalpha){
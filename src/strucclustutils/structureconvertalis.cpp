@@ -14,6 +14,7 @@
 #include "MappingReader.h"
 #include "Coordinate16.h"
 #include "MultimerUtil.h"
+#include "StructureLookup.h"
 
 #define ZSTD_STATIC_LINKING_ONLY
 
@@ -167,50 +168,10 @@ qca        Query ca
 tca        Target ca
  */
 
-std::map<unsigned int, unsigned int> structureReadKeyToSet(const std::string& file) {
-    std::map<unsigned int, unsigned int> mapping;
-    if (file.length() == 0) {
-        return mapping;
-    }
-
-    MemoryMapped lookup(file, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
-    char* data = (char *) lookup.getData();
-    const char* entry[255];
-    while (*data != '\0') {
-        const size_t columns = Util::getWordsOfLine(data, entry, 255);
-        if (columns < 3) {
-            Debug(Debug::WARNING) << "Not enough columns in lookup file " << file << "\n";
-            continue;
-        }
-        mapping.emplace(Util::fast_atoi<unsigned int>(entry[0]), Util::fast_atoi<unsigned int>(entry[2]));
-        data = Util::skipLine(data);
-    }
-    lookup.close();
-    return mapping;
-}
-
-
-std::map<unsigned int, std::string> structureReadSetToSource(const std::string& file) {
-    std::map<unsigned int, std::string> mapping;
-    if (file.length() == 0) {
-        return mapping;
-    }
-
-    MemoryMapped source(file, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
-    char* data = (char *) source.getData();
-    const char* entry[255];
-    while (*data != '\0') {
-        const size_t columns = Util::getWordsOfLine(data, entry, 255);
-        if (columns < 2) {
-            Debug(Debug::WARNING) << "Not enough columns in lookup file " << file << "\n";
-            continue;
-        }
-        data = Util::skipLine(data);
-        std::string source(entry[1], data - entry[1] - 1);
-        mapping.emplace(Util::fast_atoi<unsigned int>(entry[0]), source);
-    }
-    source.close();
-    return mapping;
+// keys missing from the lookup belong to set 0, like the text lookup parsing used to report
+static unsigned int lookupSet(const StructureLookup *lookup, unsigned int key) {
+    unsigned int set = lookup->keyToSet(key);
+    return (set == UINT_MAX) ? 0 : set;
 }
 
 int structureconvertalis(int argc, const char **argv, const Command &command) {
@@ -224,7 +185,6 @@ int structureconvertalis(int argc, const char **argv, const Command &command) {
         format = Parameters::FORMAT_ALIGNMENT_BLAST_TAB;
         addColumnHeaders = true;
     }
-    const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
 
     bool needSequenceDB = false;
     bool needBacktrace = false;
@@ -262,26 +222,15 @@ int structureconvertalis(int argc, const char **argv, const Command &command) {
 
     int dbaccessMode = needSequenceDB ? (DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA) : (DBReader<unsigned int>::USE_INDEX);
 
-    std::map<unsigned int, unsigned int> qKeyToSet;
-    std::map<unsigned int, unsigned int> tKeyToSet;
-    if (needLookup) {
-        std::string file1 = par.db1 + ".lookup";
-        std::string file2 = par.db2 + ".lookup";
-        qKeyToSet = structureReadKeyToSet(file1);
-        tKeyToSet = structureReadKeyToSet(file2);
+    StructureLookup *qLookup = NULL;
+    StructureLookup *tLookup = NULL;
+    if (needLookup || needSource) {
+        qLookup = new StructureLookup(par.db1, needSource);
+        tLookup = sameDB ? qLookup : new StructureLookup(par.db2, needSource);
     }
 
-    std::map<unsigned int, std::string> qSetToSource;
-    std::map<unsigned int, std::string> tSetToSource;
-    if (needSource) {
-        std::string file1 = par.db1 + ".source";
-        std::string file2 = par.db2 + ".source";
-        qSetToSource = structureReadSetToSource(file1);
-        tSetToSource = structureReadSetToSource(file2);
-    }
-
-    IndexReader qDbr(par.db1, par.threads,  IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0, dbaccessMode);
-    IndexReader qDbrHeader(par.db1, par.threads, IndexReader::SRC_HEADERS , (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+    IndexReader qDbr(par.db1, par.threads,  IndexReader::SRC_SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA), dbaccessMode);
+    IndexReader qDbrHeader(par.db1, par.threads, IndexReader::SRC_HEADERS , IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
     uint16_t extended = DBReader<unsigned int>::getExtendedDbtype(FileUtil::parseDbType(par.db3.c_str()));
     bool isExtendedAlignment = extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC;
 
@@ -293,10 +242,10 @@ int structureconvertalis(int argc, const char **argv, const Command &command) {
     } else {
         tDbr = new IndexReader(par.db2, par.threads,
                                isExtendedAlignment ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-                               (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0, dbaccessMode);
+                               IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA), dbaccessMode);
         tDbrHeader = new IndexReader(par.db2, par.threads,
                                      isExtendedAlignment ? IndexReader::SRC_HEADERS : IndexReader::HEADERS,
-                                     (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+                                     IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
     }
     IndexReader *qcadbr = NULL;
     IndexReader *tcadbr = NULL;
@@ -306,7 +255,7 @@ int structureconvertalis(int argc, const char **argv, const Command &command) {
                 par.db1,
                 par.threads,
                 IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-                touch ? IndexReader::PRELOAD_INDEX : 0,
+                IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
                 DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                 "_ca");
     }
@@ -320,7 +269,7 @@ int structureconvertalis(int argc, const char **argv, const Command &command) {
                     par.threads,
                     isExtendedAlignment ? IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB2) :
                                            IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-                    touch ? IndexReader::PRELOAD_INDEX : 0,
+                    IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
                     DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                     isExtendedAlignment ? "_seq_ca" : "_ca"
             );
@@ -813,16 +762,16 @@ R"html(<!DOCTYPE html>
                                         result.append(SSTR(res.dbcov));
                                         break;
                                     case Parameters::OUTFMT_QSET:
-                                        result.append(SSTR(qSetToSource[qKeyToSet[queryKey]]));
+                                        result.append(qLookup->setToSource(lookupSet(qLookup, queryKey)));
                                         break;
                                     case Parameters::OUTFMT_QSETID:
-                                        result.append(SSTR(qKeyToSet[queryKey]));
+                                        result.append(SSTR(lookupSet(qLookup, queryKey)));
                                         break;
                                     case Parameters::OUTFMT_TSET:
-                                        result.append(SSTR(tSetToSource[tKeyToSet[res.dbKey]]));
+                                        result.append(tLookup->setToSource(lookupSet(tLookup, res.dbKey)));
                                         break;
                                     case Parameters::OUTFMT_TSETID:
-                                        result.append(SSTR(tKeyToSet[res.dbKey]));
+                                        result.append(SSTR(lookupSet(tLookup, res.dbKey)));
                                         break;
                                     case Parameters::OUTFMT_TAXID:
                                         result.append(SSTR(taxon));
@@ -1155,6 +1104,12 @@ R"html(<!DOCTYPE html>
     if (mapping != NULL) {
         delete mapping;
     }
+    if (tLookup != qLookup) {
+        delete tLookup;
+    }
+    if (qLookup != NULL) {
+        delete qLookup;
+    }
     alnDbr.close();
     if (sameDB == false) {
         delete tDbr;
@@ -1,6 +1,7 @@
 #include "DBReader.h"
 #include "IndexReader.h"
 #include "DBWriter.h"
+#include "QueryCheckpoint.h"
 #include "Debug.h"
 #include "Util.h"
 #include "LocalParameters.h"
@@ -159,9 +160,8 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
     LocalParameters &par = LocalParameters::getLocalInstance();
     par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
 
-    const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
-    IndexReader qdbrAA(par.db1, par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
-    IndexReader qdbr3Di(StructureUtil::getIndexWithSuffix(par.db1, "_ss"), par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
+    IndexReader qdbrAA(par.db1, par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
+    IndexReader qdbr3Di(StructureUtil::getIndexWithSuffix(par.db1, "_ss"), par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
 
     IndexReader *t3DiDbr = NULL;
     IndexReader *tAADbr = NULL;
@@ -171,8 +171,8 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
         t3DiDbr = &qdbr3Di;
         tAADbr = &qdbrAA;
     } else {
-        tAADbr = new IndexReader(par.db2, par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
-        t3DiDbr = new IndexReader(StructureUtil::getIndexWithSuffix(par.db2, "_ss"), par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
+        tAADbr = new IndexReader(par.db2, par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
+        t3DiDbr = new IndexReader(StructureUtil::getIndexWithSuffix(par.db2, "_ss"), par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
     }
 
     bool needTMaligner = (par.tmScoreThr > 0);
@@ -186,7 +186,7 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
                 par.db1,
                 par.threads,
                 IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-                touch ? IndexReader::PRELOAD_INDEX : 0,
+                IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
                 DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                 "_ca");
         if (sameDB) {
@@ -196,7 +196,7 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
                     par.db2,
                     par.threads,
                     IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-                    touch ? IndexReader::PRELOAD_INDEX : 0,
+                    IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
                     DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                     "_ca"
             );
@@ -207,8 +207,9 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
     DBReader<unsigned int> resultReader(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     resultReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
 
-    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed,  Parameters::DBTYPE_ALIGNMENT_RES);
-    dbw.open();
+    QueryCheckpoint checkpoint(par.db4, par.db4Index, 0, resultReader.getSize(), static_cast<size_t>(par.checkpointInterval),
+                               par.checkpointInterval > 0 ? QueryCheckpoint::fingerprint(par, *command.params, {par.db1Index, par.db2Index, par.db3Index}) : 0);
+    DBWriter *dbw = NULL;
 
     SubstitutionMatrix subMat3Di(par.scoringMatrixFile.values.aminoacid().c_str(), 2.1, par.scoreBias);
     std::string blosum;
@@ -278,112 +279,130 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
 
         // write output file
 
+        for (size_t chunk = 0; chunk < checkpoint.getChunkCount(); chunk++) {
+            if (checkpoint.isDone(chunk)) {
+                continue;
+            }
+#pragma omp single
+            {
+                std::pair<std::string, std::string> chunkDb = checkpoint.getChunkDb(chunk);
+                dbw = new DBWriter(chunkDb.first.c_str(), chunkDb.second.c_str(), static_cast<unsigned int>(par.threads), par.compressed, Parameters::DBTYPE_ALIGNMENT_RES);
+                dbw->open();
+            }
 #pragma omp for schedule(dynamic, 1)
-        for (size_t id = 0; id < resultReader.getSize(); id++) {
-            progress.updateProgress();
-            char *data = resultReader.getData(id, thread_idx);
-            size_t queryKey = resultReader.getDbKey(id);
-            if(*data != '\0') {
-                unsigned int queryId = qdbr3Di.sequenceReader->getId(queryKey);
-
-                char *querySeqAA = qdbrAA.sequenceReader->getData(queryId, thread_idx);
-                char *querySeq3Di = qdbr3Di.sequenceReader->getData(queryId, thread_idx);
-
-                unsigned int querySeqLen = qdbr3Di.sequenceReader->getSeqLen(queryId);
-                qSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
-                qSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
-                if(needLDDT || needTMaligner){
-                    size_t qId = qcadbr->sequenceReader->getId(queryKey);
-                    char *qcadata = qcadbr->sequenceReader->getData(qId, thread_idx);
-                    size_t qCaLength = qcadbr->sequenceReader->getEntryLen(qId);
-                    float* queryCaData = qcoords.read(qcadata, qSeq3Di.L, qCaLength);
-                    if(needTMaligner){
-                        tmaligner->initQuery(queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L], NULL, qSeq3Di.L);
-                    }
-                    if(needLDDT){
-                        lddtcalculator->initQuery(qSeq3Di.L, queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L]);
-                    }
-                }
-                qRevSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
-                qRevSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
-                std::pair<double, double> muLambda = evaluer.predictMuLambda(qSeq3Di.numSequence, qSeq3Di.L);
-                structureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
-                qRevSeq3Di.reverse();
-                qRevSeqAA.reverse();
-                reverseStructureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
-                int passedNum = 0;
-                int rejected = 0;
-                while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
-                    hit_t prefHit = QueryMatcher::parsePrefilterHit(data);
-                    data = Util::skipLine(data);
-                    const unsigned int dbKey = prefHit.seqId;
-                    unsigned int targetId = t3DiDbr->sequenceReader->getId(dbKey);
-                    const bool isIdentity = (queryId == targetId && (par.includeIdentity || sameDB))? true : false;
-
-                    char * targetSeq3Di = t3DiDbr->sequenceReader->getData(targetId, thread_idx);
-                    char * targetSeqAA = tAADbr->sequenceReader->getData(targetId, thread_idx);
-                    const int targetSeqLen = static_cast<int>(t3DiDbr->sequenceReader->getSeqLen(targetId));
-
-                    tSeq3Di.mapSequence(targetId, dbKey, targetSeq3Di, targetSeqLen);
-                    tSeqAA.mapSequence(targetId, dbKey, targetSeqAA, targetSeqLen);
-                    if(Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, targetSeqLen) == false){
-                        rejected++;
-                        continue;
-                    }
-                    Matcher::result_t res = ungappedAlignStructure(qSeqAA, qSeq3Di, qRevSeqAA, qRevSeq3Di, tSeqAA, tSeq3Di, static_cast<short>(prefHit.diagonal), subMatAA, subMat3Di, evaluer, muLambda, backtrace, par);
-
-                    if(res.dbKey == UINT_MAX){
-                        rejected++;
-                        continue;
+            for (size_t id = checkpoint.getChunkStart(chunk); id < checkpoint.getChunkEnd(chunk); id++) {
+                progress.updateProgress();
+                char *data = resultReader.getData(id, thread_idx);
+                size_t queryKey = resultReader.getDbKey(id);
+                if(*data != '\0') {
+                    unsigned int queryId = qdbr3Di.sequenceReader->getId(queryKey);
+
+                    char *querySeqAA = qdbrAA.sequenceReader->getData(queryId, thread_idx);
+                    char *querySeq3Di = qdbr3Di.sequenceReader->getData(queryId, thread_idx);
+
+                    unsigned int querySeqLen = qdbr3Di.sequenceReader->getSeqLen(queryId);
+                    qSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
+                    qSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
+                    if(needLDDT || needTMaligner){
+                        size_t qId = qcadbr->sequenceReader->getId(queryKey);
+                        char *qcadata = qcadbr->sequenceReader->getData(qId, thread_idx);
+                        size_t qCaLength = qcadbr->sequenceReader->getEntryLen(qId);
+                        float* queryCaData = qcoords.read(qcadata, qSeq3Di.L, qCaLength);
+                        if(needTMaligner){
+                            tmaligner->initQuery(queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L], NULL, qSeq3Di.L);
+                        }
+                        if(needLDDT){
+                            lddtcalculator->initQuery(qSeq3Di.L, queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L]);
+                        }
                     }
-
-                    if(needTMaligner) {
-                        size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
-                        char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
-                        size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
-                        float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
-                        TMaligner::TMscoreResult tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
-                                                                                   res.qStartPos, res.dbStartPos, Matcher::uncompressAlignment(res.backtrace),
-                                                                                   std::min(static_cast<unsigned int>(res.backtrace.length()), std::min(res.dbLen, res.qLen)));
-                        if(tmres.tmscore < par.tmScoreThr){
+                    qRevSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
+                    qRevSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
+                    std::pair<double, double> muLambda = evaluer.predictMuLambda(qSeq3Di.numSequence, qSeq3Di.L);
+                    structureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+                    qRevSeq3Di.reverse();
+                    qRevSeqAA.reverse();
+                    reverseStructureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+                    int passedNum = 0;
+                    int rejected = 0;
+                    while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
+                        hit_t prefHit = QueryMatcher::parsePrefilterHit(data);
+                        data = Util::skipLine(data);
+                        const unsigned int dbKey = prefHit.seqId;
+                        unsigned int targetId = t3DiDbr->sequenceReader->getId(dbKey);
+                        const bool isIdentity = (queryId == targetId && (par.includeIdentity || sameDB))? true : false;
+
+                        char * targetSeq3Di = t3DiDbr->sequenceReader->getData(targetId, thread_idx);
+                        char * targetSeqAA = tAADbr->sequenceReader->getData(targetId, thread_idx);
+                        const int targetSeqLen = static_cast<int>(t3DiDbr->sequenceReader->getSeqLen(targetId));
+
+                        tSeq3Di.mapSequence(targetId, dbKey, targetSeq3Di, targetSeqLen);
+                        tSeqAA.mapSequence(targetId, dbKey, targetSeqAA, targetSeqLen);
+                        if(Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, targetSeqLen) == false){
+                            rejected++;
                             continue;
                         }
-                    }
-                    if(needLDDT){
-                        size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
-                        char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
-                        size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
-                        float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
-                        LDDTCalculator::LDDTScoreResult lddtres = lddtcalculator->computeLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos,
-                                                                   res.backtrace,
-                                                                   targetCaData, &targetCaData[res.dbLen],
-                                                                   &targetCaData[res.dbLen+res.dbLen]);
-                        if(lddtres.avgLddtScore < par.lddtThr){
+                        Matcher::result_t res = ungappedAlignStructure(qSeqAA, qSeq3Di, qRevSeqAA, qRevSeq3Di, tSeqAA, tSeq3Di, static_cast<short>(prefHit.diagonal), subMatAA, subMat3Di, evaluer, muLambda, backtrace, par);
+
+                        if(res.dbKey == UINT_MAX){
+                            rejected++;
                             continue;
                         }
-                    }
 
-                    if (Alignment::checkCriteria(res, isIdentity, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
-                        alignmentResult.emplace_back(res);
-                        passedNum++;
-                        rejected = 0;
-                    } else {
-                        rejected++;
+                        if(needTMaligner) {
+                            size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
+                            char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
+                            size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
+                            float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
+                            TMaligner::TMscoreResult tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
+                                                                                       res.qStartPos, res.dbStartPos, Matcher::uncompressAlignment(res.backtrace),
+                                                                                       std::min(static_cast<unsigned int>(res.backtrace.length()), std::min(res.dbLen, res.qLen)));
+                            if(tmres.tmscore < par.tmScoreThr){
+                                continue;
+                            }
+                        }
+                        if(needLDDT){
+                            size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
+                            char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
+                            size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
+                            float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
+                            LDDTCalculator::LDDTScoreResult lddtres = lddtcalculator->computeBoundedLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos,
+                                                                       res.backtrace,
+                                                                       targetCaData, &targetCaData[res.dbLen],
+                                                                       &targetCaData[res.dbLen+res.dbLen], par.lddtThr);
+                            if(lddtres.avgLddtScore < par.lddtThr){
+                                continue;
+                            }
+                        }
+
+                        if (Alignment::checkCriteria(res, isIdentity, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
+                            alignmentResult.emplace_back(res);
+                            passedNum++;
+                            rejected = 0;
+                        } else {
+                            rejected++;
+                        }
                     }
                 }
-            }
 
 
-            if (alignmentResult.size() > 1) {
-                SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), Matcher::compareHits);
+                if (alignmentResult.size() > 1) {
+                    SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), Matcher::compareHits);
+                }
+                for (size_t result = 0; result < alignmentResult.size(); result++) {
+                    size_t len = Matcher::resultToBuffer(buffer, alignmentResult[result], par.addBacktrace);
+                    resultBuffer.append(buffer, len);
+                }
+                dbw->writeData(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
+                resultBuffer.clear();
+                alignmentResult.clear();
             }
-            for (size_t result = 0; result < alignmentResult.size(); result++) {
-                size_t len = Matcher::resultToBuffer(buffer, alignmentResult[result], par.addBacktrace);
-                resultBuffer.append(buffer, len);
+#pragma omp single
+            {
+                dbw->close();
+                delete dbw;
+                dbw = NULL;
+                checkpoint.commit(chunk);
             }
-            dbw.writeData(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
-            resultBuffer.clear();
-            alignmentResult.clear();
         }
         if(needTMaligner){
             delete tmaligner;
@@ -396,7 +415,7 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
     free(tinySubMatAA);
     free(tinySubMat3Di);
 
-    dbw.close();
+    checkpoint.finish();
     resultReader.close();
     if (sameDB == false) {
         delete t3DiDbr;
@@ -10,6 +10,7 @@
 #include "StructureSmithWaterman.h"
 #include "TMaligner.h"
 #include "Coordinate16.h"
+#include "AlignmentFeatures.h"
 
 #ifdef OPENMP
 #include <omp.h>
@@ -37,12 +38,12 @@ int tmalign(int argc, const char **argv, const Command& command) {
     Debug(Debug::INFO) << "Query database: " << par.db1 << "\n";
     Debug(Debug::INFO) << "Target database: " << par.db2 << "\n";
     const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
-    IndexReader qdbr(par.db1, par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
+    IndexReader qdbr(par.db1, par.threads, IndexReader::SEQUENCES, IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX));
     IndexReader qcadbr(
             par.db1,
             par.threads,
             IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-            touch ? IndexReader::PRELOAD_INDEX : 0,
+            IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
             DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
             "_ca"
     );
@@ -59,18 +60,28 @@ int tmalign(int argc, const char **argv, const Command& command) {
     } else {
         tdbr = new IndexReader(par.db2, par.threads,
                         alignmentIsExtended ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-                        (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+                        IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA));
         tcadbr = new IndexReader(
                 par.db2,
                 par.threads,
                 alignmentIsExtended ?  IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB2) :
                 IndexReader::makeUserDatabaseType(LocalParameters::INDEX_DB_CA_KEY_DB1),
-                touch ? IndexReader::PRELOAD_INDEX : 0,
+                IndexReader::preloadFlags(par.preloadMode, IndexReader::PRELOAD_INDEX),
                 DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA,
                 alignmentIsExtended ? "_seq_ca" : "_ca"
         );
     }
 
+    DBReader<unsigned int> *tFeatDbr = NULL;
+    std::string tFeatDb = AlignmentFeatures::getFeatureDbName(par.db2);
+    if (alignmentIsExtended == false && AlignmentFeatures::isUsable(par, tFeatDb)) {
+        tFeatDbr = new DBReader<unsigned int>(tFeatDb.c_str(), (tFeatDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+        tFeatDbr->open(DBReader<unsigned int>::NOSORT);
+        if (touch) {
+            tFeatDbr->readMmapedDataInMemory();
+        }
+    }
+
     DBReader<unsigned int> resultReader(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     resultReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
 
@@ -78,7 +89,7 @@ int tmalign(int argc, const char **argv, const Command& command) {
     if(alignmentIsExtended){
 	dbtype = DBReader<unsigned int>::setExtendedDbtype(dbtype, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
     }
-    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed, dbtype);
+    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed | Parameters::WRITER_DIRECT_MODE, dbtype);
     dbw.open();
 
     Debug::Progress progress(resultReader.getSize());
@@ -96,6 +107,7 @@ int tmalign(int argc, const char **argv, const Command& command) {
         resultBuffer.reserve(1024*1024);
         Coordinate16 qcoords;
         Coordinate16 tcoords;
+        std::vector<float> featCa;
 
         char buffer[1024+32768];
 #pragma omp for schedule(dynamic, 1)
@@ -136,9 +148,22 @@ int tmalign(int argc, const char **argv, const Command& command) {
                         continue;
                     }
 
-                    char *tcadata = tcadbr->sequenceReader->getData(targetId, thread_idx);
-                    size_t tCaLength = tcadbr->sequenceReader->getEntryLen(targetId);
-                    float* tdata = tcoords.read(tcadata, targetLen, tCaLength);
+                    float* tdata = NULL;
+                    if (tFeatDbr != NULL) {
+                        size_t featId = tFeatDbr->getId(dbKey);
+                        AlignmentFeatures::Entry feat;
+                        // a partial or stale feature DB falls back to the C-alpha DB
+                        if (featId != UINT_MAX
+                            && AlignmentFeatures::parse(tFeatDbr->getData(featId, thread_idx), tFeatDbr->getEntryLen(featId), feat)
+                            && static_cast<int>(feat.length) == targetLen) {
+                            tdata = AlignmentFeatures::readCa(feat, tcoords, featCa);
+                        }
+                    }
+                    if (tdata == NULL) {
+                        char *tcadata = tcadbr->sequenceReader->getData(targetId, thread_idx);
+                        size_t tCaLength = tcadbr->sequenceReader->getEntryLen(targetId);
+                        tdata = tcoords.read(tcadata, targetLen, tCaLength);
+                    }
 
                     // align here
                     float TMscore;
@@ -190,6 +215,10 @@ int tmalign(int argc, const char **argv, const Command& command) {
 
     dbw.close();
     resultReader.close();
+    if (tFeatDbr != NULL) {
+        tFeatDbr->close();
+        delete tFeatDbr;
+    }
     if(sameDB == false){
         delete tdbr;
         delete tcadbr;
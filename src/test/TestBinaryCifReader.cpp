@@ -0,0 +1,248 @@
+// asserts are the test checks, keep them in release builds
+#undef NDEBUG
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BinaryCifReader.h"
+#include "GemmiWrapper.h"
+
+const char* binary_name = "test_binarycifreader";
+
+// minimal MessagePack writer to build BinaryCIF documents
+static std::string packHeader(uint8_t fixType, uint8_t type16, size_t count) {
+    std::string out;
+    if (count < 16) {
+        out.push_back((char) (fixType | count));
+    } else {
+        out.push_back((char) type16);
+        out.push_back((char) (count >> 8));
+        out.push_back((char) (count & 0xff));
+    }
+    return out;
+}
+
+static std::string packInt(int64_t value) {
+    std::string out(1, (char) 0xd3);
+    for (int i = 7; i >= 0; --i) {
+        out.push_back((char) ((uint64_t) value >> (8 * i)));
+    }
+    return out;
+}
+
+static std::string packDouble(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(double));
+    std::string out(1, (char) 0xcb);
+    for (int i = 7; i >= 0; --i) {
+        out.push_back((char) (bits >> (8 * i)));
+    }
+    return out;
+}
+
+static std::string packString(const std::string& value) {
+    std::string out(1, (char) 0xd9);
+    out.push_back((char) value.size());
+    return out + value;
+}
+
+static std::string packBinary(const std::string& value) {
+    std::string out(1, (char) 0xc5);
+    out.push_back((char) (value.size() >> 8));
+    out.push_back((char) (value.size() & 0xff));
+    return out + value;
+}
+
+static std::string packArray(const std::vector<std::string>& elements) {
+    std::string out = packHeader(0x90, 0xdc, elements.size());
+    for (size_t i = 0; i < elements.size(); ++i) {
+        out.append(elements[i]);
+    }
+    return out;
+}
+
+// keys and values alternate
+static std::string packMap(const std::vector<std::string>& elements) {
+    std::string out = packHeader(0x80, 0xde, elements.size() / 2);
+    for (size_t i = 0; i < elements.size(); ++i) {
+        out.append(elements[i]);
+    }
+    return out;
+}
+
+template <typename T>
+static std::string littleEndian(const std::vector<T>& values) {
+    return std::string((const char*) values.data(), values.size() * sizeof(T));
+}
+
+static std::string byteArray(int type) {
+    return packMap({packString("kind"), packString("ByteArray"), packString("type"), packInt(type)});
+}
+
+static std::string delta(int64_t origin) {
+    return packMap({packString("kind"), packString("Delta"), packString("origin"), packInt(origin),
+                    packString("srcType"), packInt(3)});
+}
+
+static std::string deltaDouble(double origin) {
+    return packMap({packString("kind"), packString("Delta"), packString("origin"), packDouble(origin),
+                    packString("srcType"), packInt(3)});
+}
+
+static std::string runLength(int64_t srcSize) {
+    return packMap({packString("kind"), packString("RunLength"), packString("srcType"), packInt(3),
+                    packString("srcSize"), packInt(srcSize)});
+}
+
+static std::string integerPacking(int byteCount, bool isUnsigned, int64_t srcSize) {
+    return packMap({packString("kind"), packString("IntegerPacking"), packString("byteCount"), packInt(byteCount),
+                    packString("isUnsigned"), std::string(1, (char) (isUnsigned ? 0xc3 : 0xc2)),
+                    packString("srcSize"), packInt(srcSize)});
+}
+
+static std::string fixedPoint(double factor) {
+    return packMap({packString("kind"), packString("FixedPoint"), packString("factor"), packDouble(factor),
+                    packString("srcType"), packInt(32)});
+}
+
+static std::string stringArray(const std::vector<std::string>& dataEncoding, const std::string& stringData,
+                               const std::vector<std::string>& offsetEncoding, const std::string& offsets) {
+    return packMap({packString("kind"), packString("StringArray"), packString("dataEncoding"), packArray(dataEncoding),
+                    packString("stringData"), packString(stringData), packString("offsetEncoding"),
+                    packArray(offsetEncoding), packString("offsets"), packBinary(offsets)});
+}
+
+static std::string encodedData(const std::vector<std::string>& encodings, const std::string& data) {
+    return packMap({packString("encoding"), packArray(encodings), packString("data"), packBinary(data)});
+}
+
+// one atom_site category with a single column named "c"
+static std::string document(int64_t rowCount, const std::string& data, const std::string& mask = std::string(1, (char) 0xc0)) {
+    std::string column = packMap({packString("name"), packString("c"), packString("data"), data,
+                                  packString("mask"), mask});
+    std::string category = packMap({packString("name"), packString("_atom_site"), packString("columns"),
+                                    packArray({column}), packString("rowCount"), packInt(rowCount)});
+    std::string block = packMap({packString("header"), packString("TEST"), packString("categories"),
+                                 packArray({category})});
+    return packMap({packString("version"), packString("0.3.0"), packString("dataBlocks"), packArray({block})});
+}
+
+static void readColumn(const std::string& buffer, BinaryCifReader::Column& column) {
+    BinaryCifReader reader;
+    reader.parse(buffer.data(), buffer.size());
+    reader.getColumn("atom_site", "c", column);
+    assert(column.isPresent());
+}
+
+static void expectFailure(const std::string& buffer, const char* description) {
+    BinaryCifReader reader;
+    BinaryCifReader::Column column;
+    try {
+        reader.parse(buffer.data(), buffer.size());
+        reader.getRowCount("atom_site");
+        reader.getColumn("atom_site", "c", column);
+    } catch (std::runtime_error& e) {
+        std::cout << description << ": " << e.what() << std::endl;
+        return;
+    }
+    std::cout << description << " was accepted" << std::endl;
+    assert(false);
+}
+
+static void testDecoding() {
+    BinaryCifReader::Column column;
+
+    // run lengths (value, count) expand to 1 1 1 2 2, then the differences are added to the origin
+    readColumn(document(5, encodedData({delta(10), runLength(5), byteArray(1)},
+                                       littleEndian(std::vector<int8_t>{1, 3, 2, 2}))), column);
+    const int expectedInts[] = {11, 12, 13, 15, 17};
+    for (size_t i = 0; i < 5; ++i) {
+        assert(column.getInt(i) == expectedInts[i]);
+    }
+
+    // values at the limits of the packed type continue into the next value
+    readColumn(document(3, encodedData({fixedPoint(10), integerPacking(1, false, 3), byteArray(1)},
+                                       littleEndian(std::vector<int8_t>{127, 3, -128, -5, 7}))), column);
+    const double expectedFloats[] = {13.0, -13.3, 0.7};
+    for (size_t i = 0; i < 3; ++i) {
+        assert(std::fabs(column.getFloat(i) - expectedFloats[i]) < 1e-6);
+    }
+
+    readColumn(document(2, encodedData({integerPacking(2, true, 2), byteArray(5)},
+                                       littleEndian(std::vector<uint16_t>{0xFFFF, 1, 2}))), column);
+    assert(column.getInt(0) == 0x10000 && column.getInt(1) == 2);
+
+    // offsets 0 2 3 split "CAN" into CA and N, index -1 is a masked value
+    std::string names = encodedData({stringArray({byteArray(1)}, "CAN", {delta(0), byteArray(1)},
+                                                 littleEndian(std::vector<int8_t>{0, 2, 1}))},
+                                    littleEndian(std::vector<int8_t>{1, 0, -1, 0}));
+    std::string mask = encodedData({runLength(4), byteArray(4)}, littleEndian(std::vector<uint8_t>{0, 2, 2, 1, 0, 1}));
+    readColumn(document(4, names, mask), column);
+    assert(column.getString(0) == "N" && column.getString(1) == "CA" && column.getString(3) == "CA");
+    assert(column.isNull(0) == false && column.isNull(2) && column.getString(2).empty());
+    assert(column.equals(1, 3) && column.equals(0, 1) == false);
+}
+
+static void testMalformed() {
+    const std::string int8Pairs = littleEndian(std::vector<int8_t>{1, 2});
+
+    expectFailure(document(2, encodedData({runLength(1000000000000LL), byteArray(1)}, int8Pairs)), "huge RunLength srcSize");
+    expectFailure(document(2, encodedData({runLength(-1), byteArray(1)}, int8Pairs)), "negative RunLength srcSize");
+    expectFailure(document(2, encodedData({integerPacking(1, false, 1LL << 40), byteArray(1)}, int8Pairs)), "huge IntegerPacking srcSize");
+    expectFailure(document(1, encodedData({integerPacking(1, false, 1), byteArray(1)}, int8Pairs)), "IntegerPacking beyond srcSize");
+    expectFailure(document(1LL << 40, encodedData({runLength(1LL << 40), byteArray(1)}, int8Pairs)), "row count larger than the input");
+    expectFailure(document(2, encodedData({delta(INT32_MAX), byteArray(1)}, int8Pairs)), "Delta overflow");
+    expectFailure(document(2, encodedData({delta(1LL << 40), byteArray(1)}, int8Pairs)), "Delta origin out of range");
+    expectFailure(document(2, encodedData({deltaDouble(NAN), byteArray(1)}, int8Pairs)), "NaN Delta origin");
+    expectFailure(document(2, encodedData({deltaDouble(1e300), byteArray(1)}, int8Pairs)), "huge Delta origin");
+    expectFailure(document(1, encodedData({integerPacking(1, false, 1), byteArray(3)},
+                                          littleEndian(std::vector<int32_t>{127, INT32_MAX}))), "IntegerPacking overflow");
+    expectFailure(document(3, encodedData({byteArray(1)}, int8Pairs)), "column shorter than the row count");
+
+    std::string truncated = document(2, encodedData({byteArray(1)}, int8Pairs));
+    truncated.resize(truncated.size() - 1);
+    expectFailure(truncated, "truncated document");
+}
+
+static bool sameCoordinates(const std::vector<Vec3>& a, const std::vector<Vec3>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        const double u[3] = {a[i].x, a[i].y, a[i].z};
+        const double v[3] = {b[i].x, b[i].y, b[i].z};
+        for (size_t k = 0; k < 3; ++k) {
+            if (std::isnan(u[k]) != std::isnan(v[k]) || std::fabs(u[k] - v[k]) > 1e-3) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// the same structure stored as mmCIF and BinaryCIF has to give the same chains and residues
+static void testFixture(const std::string& cifFile, const std::string& bcifFile) {
+    GemmiWrapper cif;
+    GemmiWrapper bcif;
+    assert(cif.load(cifFile));
+    assert(bcif.load(bcifFile));
+    assert(cif.chain == bcif.chain && cif.chainNames == bcif.chainNames && cif.modelIndices == bcif.modelIndices);
+    assert(cif.ami == bcif.ami && cif.ca.empty() == false);
+    assert(sameCoordinates(cif.ca, bcif.ca) && sameCoordinates(cif.n, bcif.n));
+    assert(sameCoordinates(cif.c, bcif.c) && sameCoordinates(cif.cb, bcif.cb));
+    for (size_t i = 0; i < cif.ca_bfactor.size(); ++i) {
+        assert(std::fabs(cif.ca_bfactor[i] - bcif.ca_bfactor[i]) < 1e-2);
+    }
+    std::cout << "Fixture: " << cif.chain.size() << " chains, " << cif.ca.size() << " residues match" << std::endl;
+}
+
+int main(int argc, const char** argv) {
+    testDecoding();
+    testMalformed();
+    testFixture(argc > 1 ? argv[1] : "binarycif.cif", argc > 2 ? argv[2] : "binarycif.bcif");
+    return EXIT_SUCCESS;
+}
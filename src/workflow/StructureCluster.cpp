@@ -127,6 +127,8 @@ int structurecluster(int argc, const char **argv, const Command& command) {
     //par.kmerSize = 10;
     //par.spacedKmer = 1;
     cmd.addVariable("KMERMATCHER_PAR", par.createParameterString(par.kmermatcher).c_str());
+    cmd.addVariable("SKETCH_PREFILTER", par.sketchPrefilter ? "TRUE" : NULL);
+    cmd.addVariable("SKETCHMATCHER_PAR", par.createParameterString(par.sketchmatcher).c_str());
 
     cmd.addVariable("CLUSTER_PAR", par.createParameterString(par.clust).c_str());
     cmd.addVariable("ALIGNMENT_PAR", alnParam.c_str());
@@ -171,6 +173,11 @@ int structurecluster(int argc, const char **argv, const Command& command) {
             cmd.addVariable(std::string("ALIGNMENT" + SSTR(step) + "_PAR").c_str(), alnParam.c_str());
             cmd.addVariable(std::string("CLUSTER" + SSTR(step) + "_PAR").c_str(), par.createParameterString(par.clust).c_str());
         }
+        // all steps share one prefilter index, built with the settings of the most sensitive step
+        int indexSubset = par.indexSubset;
+        par.indexSubset = Parameters::INDEX_SUBSET_NO_HEADERS;
+        cmd.addVariable("INDEXDB_PAR", par.createParameterString(par.indexdb).c_str());
+        par.indexSubset = indexSubset;
         cmd.addVariable("RUN_ITERATIVE", "1");
         cmd.addVariable("STEPS", SSTR(par.clusterSteps).c_str());
         cmd.addVariable("THREADSANDCOMPRESS", par.createParameterString(par.threadsandcompression).c_str());
@@ -184,8 +191,7 @@ int structurecluster(int argc, const char **argv, const Command& command) {
         par.covMode = swapedCovMode;
         cmd.addVariable("PREFILTER_REASSIGN_PAR", par.createParameterString(par.prefilter).c_str());
         par.covMode = tmpCovMode;
-        cmd.addVariable("ALIGNMENT_REASSIGN_PAR", par.createParameterString(par.structurealign).c_str());
-        cmd.addVariable("MERGEDBS_PAR", par.createParameterString(par.mergedbs).c_str());
+        cmd.addVariable("ALIGNMENT_REASSIGN_PAR", alnParam.c_str());
 
         std::string program = tmpDir + "/clustering.sh";
         FileUtil::writeFile(program, structurecluster_sh, structurecluster_sh_len);
@@ -1,4 +1,9 @@
+// include xxhash early to avoid incompatibilites with SIMDe
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
 #include <cassert>
+#include <cmath>
 #include "DBReader.h"
 #include "Util.h"
 #include "CommandCaller.h"
@@ -9,6 +14,13 @@
 #include "structuresearch.sh.h"
 #include "structureiterativesearch.sh.h"
 
+#include <cinttypes>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+extern const char* version;
+
 void setStructureSearchWorkflowDefaults(LocalParameters *p) {
     p->kmerSize = 0;
     p->maskMode = 0;
@@ -33,6 +45,226 @@ void setStructureSearchMustPassAlong(LocalParameters *p) {
     p->PARAM_REMOVE_TMP_FILES.wasSet = true;
 }
 
+static double wallTime() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+// ns per cell of a scalar ungapped diagonal scoring loop
+static double benchmarkComputeNs() {
+    const size_t qLen = 512;
+    const size_t tLen = 8192;
+    int8_t subMat[21 * 21];
+    std::vector<unsigned char> q(qLen);
+    std::vector<unsigned char> t(tLen + qLen);
+    unsigned int seed = 42;
+    for (size_t i = 0; i < 21 * 21; i++) {
+        subMat[i] = static_cast<int8_t>(rand_r(&seed) % 15) - 7;
+    }
+    for (size_t i = 0; i < qLen; i++) {
+        q[i] = rand_r(&seed) % 21;
+    }
+    for (size_t i = 0; i < t.size(); i++) {
+        t[i] = rand_r(&seed) % 21;
+    }
+    double start = wallTime();
+    int best = 0;
+    for (size_t d = 0; d < tLen; d++) {
+        int score = 0;
+        for (size_t i = 0; i < qLen; i++) {
+            score = std::max(0, score + subMat[q[i] * 21 + t[d + i]]);
+            best = std::max(best, score);
+        }
+    }
+    double elapsed = wallTime() - start;
+    // keep the loop from being optimized away
+    volatile int sink = best;
+    (void) sink;
+    return (elapsed * 1e9) / (qLen * tLen);
+}
+
+// ns per independent random 4-byte read from a table much larger than the caches
+static double benchmarkMemoryNs() {
+    const size_t tableSize = 16 * 1024 * 1024;
+    const size_t accesses = 2 * 1024 * 1024;
+    std::vector<unsigned int> table(tableSize);
+    for (size_t i = 0; i < tableSize; i++) {
+        table[i] = static_cast<unsigned int>(i);
+    }
+    double start = wallTime();
+    uint64_t state = 88172645463325252ULL;
+    unsigned int sum = 0;
+    for (size_t i = 0; i < accesses; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        sum += table[state & (tableSize - 1)];
+    }
+    double elapsed = wallTime() - start;
+    volatile unsigned int sink = sum;
+    (void) sink;
+    return (elapsed * 1e9) / accesses;
+}
+
+// The micro-benchmark results are stored per host in the user cache directory and only measured once
+static void calibrate(double &computeNs, double &memoryNs) {
+    std::string cacheDir;
+    const char *xdgCache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdgCache != NULL && xdgCache[0] != '\0') {
+        cacheDir = xdgCache;
+    } else if (home != NULL && home[0] != '\0') {
+        cacheDir = std::string(home) + "/.cache";
+    }
+    if (cacheDir.empty() == false) {
+        FileUtil::makeDir(cacheDir.c_str());
+        cacheDir += "/foldseek";
+        FileUtil::makeDir(cacheDir.c_str());
+    }
+    if (cacheDir.empty() || FileUtil::directoryExists(cacheDir.c_str()) == false) {
+        computeNs = benchmarkComputeNs();
+        memoryNs = benchmarkMemoryNs();
+        return;
+    }
+    char host[256];
+    if (gethostname(host, sizeof(host)) != 0) {
+        host[0] = '\0';
+    }
+    host[sizeof(host) - 1] = '\0';
+    std::string calibrationFile = cacheDir + "/autotune_" + host;
+    FILE *handle = fopen(calibrationFile.c_str(), "r");
+    if (handle != NULL) {
+        int read = fscanf(handle, "%lf\t%lf", &computeNs, &memoryNs);
+        fclose(handle);
+        if (read == 2 && computeNs > 0 && memoryNs > 0) {
+            return;
+        }
+    }
+    computeNs = benchmarkComputeNs();
+    memoryNs = benchmarkMemoryNs();
+    handle = fopen(calibrationFile.c_str(), "w");
+    if (handle == NULL) {
+        Debug(Debug::WARNING) << "Cannot write auto tune calibration " << calibrationFile << "\n";
+        return;
+    }
+    fprintf(handle, "%f\t%f\n", computeNs, memoryNs);
+    fclose(handle);
+}
+
+// Picks the cheaper of the k-mer and the ungapped prefilter. The choice changes the prefilter and
+// therefore the sensitivity of the search, not only its runtime.
+// Stage costs were fitted on a reference machine and are rescaled with the two micro-benchmarks.
+static int autoTunePrefilterMode(const LocalParameters &par, const std::string &query, const std::string &target, bool isIndex) {
+    const double REF_COMPUTE_NS = 0.6;
+    const double REF_MEMORY_NS = 6.0;
+    const double UNGAPPED_NS_PER_CELL = 0.08;
+    const double INDEX_BUILD_NS_PER_RESIDUE = 40.0;
+    const double INDEX_LOAD_NS_PER_RESIDUE = 1.5;
+    const double KMER_LOOKUP_NS = 25.0;
+    const double KMER_HIT_NS = 1.5;
+    const double KMER_SPACE = 85766121.0; // 21^6
+
+    DBReader<unsigned int> qdbr(query.c_str(), (query + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+    qdbr.open(DBReader<unsigned int>::NOSORT);
+    const double qResidues = std::max(static_cast<size_t>(1), qdbr.getAminoAcidDBSize());
+    const size_t qSize = qdbr.getSize();
+    qdbr.close();
+    DBReader<unsigned int> tdbr(target.c_str(), (target + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+    tdbr.open(DBReader<unsigned int>::NOSORT);
+    const double tResidues = std::max(static_cast<size_t>(1), tdbr.getAminoAcidDBSize());
+    const size_t tSize = tdbr.getSize();
+    tdbr.close();
+
+    double computeNs, memoryNs;
+    calibrate(computeNs, memoryNs);
+    const double computeFactor = computeNs / REF_COMPUTE_NS;
+    const double memoryFactor = memoryNs / REF_MEMORY_NS;
+    const double threads = std::max(1, par.threads);
+
+    const double ungappedCost = qResidues * tResidues * UNGAPPED_NS_PER_CELL * computeFactor / threads;
+    const double indexCost = isIndex ? tResidues * INDEX_LOAD_NS_PER_RESIDUE
+                                     : tResidues * INDEX_BUILD_NS_PER_RESIDUE * memoryFactor / threads;
+    const double similarKmers = exp(0.6 * par.sensitivity);
+    const double postingLength = tResidues / KMER_SPACE;
+    const double matchCost = qResidues * similarKmers * (KMER_LOOKUP_NS + postingLength * KMER_HIT_NS) * memoryFactor / threads;
+    const double kmerCost = indexCost + matchCost;
+
+    const int mode = (ungappedCost < kmerCost) ? LocalParameters::PREF_MODE_UNGAPPED : LocalParameters::PREF_MODE_KMER;
+    Debug(Debug::INFO) << "Auto tune: " << qSize << " queries (" << static_cast<size_t>(qResidues) << " residues), "
+                       << tSize << " targets (" << static_cast<size_t>(tResidues) << " residues)\n"
+                       << "Auto tune: estimated prefilter time k-mer " << (kmerCost * 1e-9) << "s"
+                       << (isIndex ? " (with index)" : "") << ", ungapped " << (ungappedCost * 1e-9) << "s\n"
+                       << "Auto tune: using " << (mode == LocalParameters::PREF_MODE_KMER ? "k-mer" : "ungapped") << " prefilter\n";
+    return mode;
+}
+
+static void hashFileContent(XXH64_state_t *state, const std::string &file) {
+    FILE *handle = fopen(file.c_str(), "r");
+    if (handle == NULL) {
+        return;
+    }
+    char buffer[64 * 1024];
+    size_t read;
+    while ((read = fread(buffer, sizeof(char), sizeof(buffer), handle)) > 0) {
+        XXH64_update(state, buffer, read);
+    }
+    fclose(handle);
+}
+
+// Cached results are only valid for one target DB and one set of result-changing parameters.
+// The target is identified by the content of its index and dbtype files and by the size and modification
+// time of its data files, which are too large to be hashed on every search. This covers the representative
+// (_seq) and cluster (_clu) DBs of a cluster search target.
+static std::string getResultCacheDb(LocalParameters &par, const std::string &target, const std::vector<MMseqsParameter*> &params) {
+    const MMseqsParameter *ignored[] = { &par.PARAM_THREADS, &par.PARAM_V, &par.PARAM_COMPRESSED, &par.PARAM_PRELOAD_MODE,
+                                         &par.PARAM_KMER_CACHE_SIZE, &par.PARAM_CHECKPOINT_INTERVAL, &par.PARAM_REMOVE_TMP_FILES,
+                                         &par.PARAM_RUNNER, &par.PARAM_REUSELATEST, &par.PARAM_RESULT_CACHE };
+    std::vector<MMseqsParameter*> resultParams = params;
+    for (size_t i = 0; i < ARRAY_SIZE(ignored); i++) {
+        resultParams = par.removeParameter(resultParams, *ignored[i]);
+    }
+    std::string parameters = par.createParameterString(resultParams);
+    parameters.append(version);
+
+    std::vector<std::string> dbs = { target, target + "_ss", target + "_h", target + "_ca",
+                                     target + "_seq", target + "_seq_ss", target + "_seq_h", target + "_seq_ca",
+                                     target + "_clu", target + "_aln" };
+    for (size_t level = 1; FileUtil::fileExists((target + "_clu_" + SSTR(level) + ".dbtype").c_str()); level++) {
+        dbs.push_back(target + "_clu_" + SSTR(level));
+    }
+
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    XXH64_update(&state, parameters.c_str(), parameters.size());
+    for (size_t i = 0; i < dbs.size(); i++) {
+        hashFileContent(&state, dbs[i] + ".dbtype");
+        hashFileContent(&state, dbs[i] + ".index");
+        std::vector<std::string> dataFiles = FileUtil::findDatafiles(dbs[i].c_str());
+        for (size_t j = 0; j < dataFiles.size(); j++) {
+            struct stat st;
+            if (stat(dataFiles[j].c_str(), &st) != 0) {
+                continue;
+            }
+            std::string fileStat = SSTR(st.st_size) + "_";
+#ifdef __APPLE__
+            fileStat.append(SSTR(st.st_mtimespec.tv_sec));
+#else
+            fileStat.append(SSTR(st.st_mtime));
+#endif
+            XXH64_update(&state, fileStat.c_str(), fileStat.size());
+        }
+    }
+
+    if (FileUtil::directoryExists(par.resultCache.c_str()) == false && FileUtil::makeDir(par.resultCache.c_str()) == false) {
+        Debug(Debug::ERROR) << "Cannot create result cache directory " << par.resultCache << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "search_%016" PRIx64, XXH64_digest(&state));
+    return par.resultCache + "/" + name;
+}
+
 int structuresearch(int argc, const char **argv, const Command &command) {
     LocalParameters &par = LocalParameters::getLocalInstance();
 
@@ -108,6 +340,9 @@ int structuresearch(int argc, const char **argv, const Command &command) {
     cmd.addVariable("UNGAPPEDPREFILTER_PAR", par.createParameterString(par.ungappedprefilter).c_str());
     par.evalThr = prevEvalueThr;
     par.compBiasCorrectionScale = 0.5;
+    if (par.autoTune && par.exhaustiveSearch == false && par.prefMode != LocalParameters::PREF_MODE_EXHAUSTIVE) {
+        par.prefMode = autoTunePrefilterMode(par, query, target, isIndex);
+    }
     switch(par.prefMode){
         case LocalParameters::PREF_MODE_KMER:
             cmd.addVariable("PREFMODE", "KMER");
@@ -141,6 +376,17 @@ int structuresearch(int argc, const char **argv, const Command &command) {
     cmd.addVariable("RUNNER", par.runner.c_str());
     cmd.addVariable("VERBOSITY", par.createParameterString(par.onlyverbosity).c_str());
 
+    if (par.resultCache.empty() == false && par.numIterations > 1) {
+        Debug(Debug::WARNING) << "--result-cache is not supported with --num-iterations, results are not cached\n";
+    } else if (par.resultCache.empty() == false) {
+        cmd.addVariable("RESULT_CACHE", getResultCacheDb(par, target, *command.params).c_str());
+        cmd.addVariable("CACHELOOKUP_PAR", par.createParameterString(par.threadsandcompression).c_str());
+        cmd.addVariable("CACHESTORE_PAR", par.createParameterString(par.onlythreads).c_str());
+        par.subDbMode = Parameters::SUBDB_MODE_SOFT;
+        cmd.addVariable("CREATESUBDB_PAR", par.createParameterString(par.createsubdb).c_str());
+        cmd.addVariable("MERGEDBS_PAR", par.createParameterString(par.mergedbs).c_str());
+    }
+
     if(par.numIterations > 1){
         double originalEval = par.evalThr;
         par.evalThr = (par.evalThr < par.evalProfile) ? par.evalThr  : par.evalProfile;
@@ -218,6 +464,24 @@ int structuresearch(int argc, const char **argv, const Command &command) {
             }
             cmd.addVariable("MERGERESULTBYSET_PAR", par.createParameterString(par.mergeresultsbyset).c_str());
             cmd.addVariable("EXPAND", "1");
+
+            // createclusearchdb with multiple clusterings writes one _clu_<level> DB per level, 1 being the finest
+            int levels = 0;
+            while (FileUtil::fileExists((par.db2 + "_clu_" + SSTR(levels + 1) + ".dbtype").c_str())) {
+                levels++;
+            }
+            if (levels > 1 && par.alignmentType == LocalParameters::ALIGNMENT_TYPE_TMALIGN) {
+                Debug(Debug::WARNING) << "Multi-level cluster search is not supported with --alignment-type 1, expanding all levels at once\n";
+            } else if (levels > 1) {
+                // nodes further above the leaves stand in for more members, keep weaker hits to them
+                const double evalThr = par.evalThr;
+                for (int level = 1; level <= levels; level++) {
+                    par.evalThr = evalThr * pow(par.clusterSearchEvalRelax, level);
+                    cmd.addVariable(std::string("ALIGNMENT_LEVEL" + SSTR(level) + "_PAR").c_str(), par.createParameterString(par.structurealign).c_str());
+                }
+                par.evalThr = evalThr;
+                cmd.addVariable("CLUSTER_LEVELS", SSTR(levels).c_str());
+            }
         }
         std::string program = tmpDir + "/structuresearch.sh";
         FileUtil::writeFile(program, structuresearch_sh, structuresearch_sh_len);